@@ -0,0 +1,932 @@
+//Loopback throughput / latency benchmark for cUDPReceiver, cTCPReceiver and cTCPServer.
+
+//Each run drives one class over 127.0.0.1 with a built in traffic generator and reports packets/s, Gbit/s, drop rate and
+//latency percentiles. Every packet is a fixed size record starting with a sequence number and the time it was sent
+//(CLOCK_MONOTONIC) so that the receiving side can compute latency from the data stream alone.
+
+//Sweeps (comma separated lists on the command line):
+//  --classes udp,tcp,server      Classes to benchmark
+//  --packet_sizes 64,1024,8192   Record size in bytes (minimum 16)
+//  --geometries 1024x9000        Receive ring geometry: number of elements x element size in bytes (receivers only)
+//  --clients 1,4                 Number of TCP clients connected to cTCPServer
+//  --callbacks 1,2               Number of data callback handlers registered with the receivers
+//Other options:
+//  --duration_ms 2000            Traffic generation time per run
+//  --rate 0                      Packets/s offered by the generator. 0 sends as fast as possible.
+//  --server_policy block         Slow client policy of cTCPServer: block, drop_newest, drop_oldest
+//  --port 60100                  First port. Each run uses a new port.
+//  --csv                         Print results as CSV (for regression tracking) rather than a table.
+
+//Only implemented for Linux.
+
+//System includes
+#include <iostream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <poll.h>
+#include <unistd.h>
+#include <time.h>
+#endif
+
+//Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/thread.hpp>
+#include <boost/bind.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/make_shared.hpp>
+#endif
+
+//Local includes
+#include "../UDPReceiver/UDPReceiver.h"
+#include "../TCPReceiver/TCPReceiver.h"
+#include "../TCPServer/TCPServer.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+#ifdef __linux__
+
+namespace
+{
+
+const uint32_t RECORD_HEADER_SIZE_B = 2 * sizeof(uint64_t);
+const uint32_t MAX_LATENCY_SAMPLES = 1 << 20;
+
+uint64_t getTime_ns()
+{
+    timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+    return (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec;
+}
+
+//Stamps a record with its sequence number and the current time
+void stampRecord(char *cpRecord, uint64_t u64Sequence)
+{
+    uint64_t u64Time_ns = getTime_ns();
+
+    memcpy(cpRecord, &u64Sequence, sizeof(u64Sequence));
+    memcpy(cpRecord + sizeof(u64Sequence), &u64Time_ns, sizeof(u64Time_ns));
+}
+
+//Paces a generator to a packet rate. A rate of 0 does not pace.
+class cPacer
+{
+public:
+    explicit cPacer(uint64_t u64Rate_pps) :
+        m_u64Rate_pps(u64Rate_pps),
+        m_u64Start_ns(getTime_ns())
+    {
+    }
+
+    void waitForPacket(uint64_t u64PacketNo)
+    {
+        if(!m_u64Rate_pps)
+            return;
+
+        uint64_t u64Due_ns = m_u64Start_ns + u64PacketNo * 1000000000ULL / m_u64Rate_pps;
+
+        while(true)
+        {
+            uint64_t u64Now_ns = getTime_ns();
+
+            if(u64Now_ns >= u64Due_ns)
+                return;
+
+            //Sleep when well ahead of schedule, otherwise spin for accuracy. Gaps of a second or more (rates below 1 pps) need
+            //the seconds split off as nanosleep() rejects tv_nsec >= 1e9.
+            if(u64Due_ns - u64Now_ns > 100000)
+            {
+                uint64_t u64Sleep_ns = u64Due_ns - u64Now_ns - 50000;
+
+                timespec sSleep;
+                sSleep.tv_sec = u64Sleep_ns / 1000000000ULL;
+                sSleep.tv_nsec = u64Sleep_ns % 1000000000ULL;
+                nanosleep(&sSleep, NULL);
+            }
+        }
+    }
+
+private:
+    uint64_t            m_u64Rate_pps;
+    uint64_t            m_u64Start_ns;
+};
+
+//Reassembles fixed size records from a byte stream (TCP) or from whole datagrams (UDP) and measures them.
+class cRecordStatistics
+{
+public:
+    explicit cRecordStatistics(uint32_t u32RecordSize_B) :
+        m_u32RecordSize_B(u32RecordSize_B),
+        m_u32RecordOffset_B(0),
+        m_u64NRecords(0),
+        m_u64NBytes(0),
+        m_u64HighestSequence(0)
+    {
+        m_vu64Latencies_ns.reserve(MAX_LATENCY_SAMPLES);
+    }
+
+    void addData(const char *cpData, uint32_t u32Size_B)
+    {
+        m_u64NBytes.fetch_add(u32Size_B, boost::memory_order_relaxed);
+
+        while(u32Size_B)
+        {
+            //Collect the header of the current record, it may be split over several reads
+            if(m_u32RecordOffset_B < RECORD_HEADER_SIZE_B)
+            {
+                uint32_t u32NHeaderBytes = min(RECORD_HEADER_SIZE_B - m_u32RecordOffset_B, u32Size_B);
+                memcpy(m_acHeader + m_u32RecordOffset_B, cpData, u32NHeaderBytes);
+
+                if(m_u32RecordOffset_B + u32NHeaderBytes == RECORD_HEADER_SIZE_B)
+                    recordHeaderComplete();
+            }
+
+            uint32_t u32NBytes = min(m_u32RecordSize_B - m_u32RecordOffset_B, u32Size_B);
+
+            cpData += u32NBytes;
+            u32Size_B -= u32NBytes;
+            m_u32RecordOffset_B += u32NBytes;
+
+            if(m_u32RecordOffset_B == m_u32RecordSize_B)
+                m_u32RecordOffset_B = 0;
+        }
+    }
+
+    uint64_t getNRecords()
+    {
+        return m_u64NRecords.load(boost::memory_order_relaxed);
+    }
+
+    uint64_t getNBytes()
+    {
+        return m_u64NBytes.load(boost::memory_order_relaxed);
+    }
+
+    uint64_t getHighestSequence()
+    {
+        return m_u64HighestSequence.load(boost::memory_order_relaxed);
+    }
+
+    //Only call once the data flow has stopped
+    const vector<uint64_t>& getLatencies_ns()
+    {
+        return m_vu64Latencies_ns;
+    }
+
+private:
+    uint32_t                    m_u32RecordSize_B;
+    uint32_t                    m_u32RecordOffset_B;
+    char                        m_acHeader[RECORD_HEADER_SIZE_B];
+
+    boost::atomic<uint64_t>     m_u64NRecords;
+    boost::atomic<uint64_t>     m_u64NBytes;
+    boost::atomic<uint64_t>     m_u64HighestSequence;
+    vector<uint64_t>            m_vu64Latencies_ns;
+
+    void recordHeaderComplete()
+    {
+        uint64_t u64Now_ns = getTime_ns();
+        uint64_t u64Sequence;
+        uint64_t u64SendTime_ns;
+
+        memcpy(&u64Sequence, m_acHeader, sizeof(u64Sequence));
+        memcpy(&u64SendTime_ns, m_acHeader + sizeof(u64Sequence), sizeof(u64SendTime_ns));
+
+        m_u64NRecords.fetch_add(1, boost::memory_order_relaxed);
+
+        if(u64Sequence > m_u64HighestSequence.load(boost::memory_order_relaxed))
+            m_u64HighestSequence.store(u64Sequence, boost::memory_order_relaxed);
+
+        if(m_vu64Latencies_ns.size() < MAX_LATENCY_SAMPLES && u64Now_ns >= u64SendTime_ns)
+            m_vu64Latencies_ns.push_back(u64Now_ns - u64SendTime_ns);
+    }
+};
+
+class cBenchmarkCallbackHandler : public cSocketReceiverBase::cDataCallbackInterface
+{
+public:
+    explicit cBenchmarkCallbackHandler(uint32_t u32RecordSize_B) :
+        m_oStatistics(u32RecordSize_B)
+    {
+    }
+
+    virtual void offloadData_callback(char* pData, uint32_t u32Size_B)
+    {
+        m_oStatistics.addData(pData, u32Size_B);
+    }
+
+    cRecordStatistics           m_oStatistics;
+};
+
+class cBenchmarkConfiguration
+{
+public:
+    cBenchmarkConfiguration() :
+        m_u32Duration_ms(2000),
+        m_u64Rate_pps(0),
+        m_eServerPolicy(cConnectionThread::SLOW_CLIENT_BLOCK),
+        m_u16Port(60100),
+        m_bCSV(false)
+    {
+        m_vstrClasses.push_back("udp");
+        m_vstrClasses.push_back("tcp");
+        m_vstrClasses.push_back("server");
+
+        m_vu32PacketSizes_B.push_back(64);
+        m_vu32PacketSizes_B.push_back(1024);
+        m_vu32PacketSizes_B.push_back(8192);
+
+        m_vu32GeometryNElements.push_back(1024);
+        m_vu32GeometryElementSizes_B.push_back(9000);
+
+        m_vu32NClients.push_back(1);
+        m_vu32NClients.push_back(4);
+
+        m_vu32NCallbacks.push_back(1);
+        m_vu32NCallbacks.push_back(2);
+    }
+
+    vector<string>                          m_vstrClasses;
+    vector<uint32_t>                        m_vu32PacketSizes_B;
+    vector<uint32_t>                        m_vu32GeometryNElements;
+    vector<uint32_t>                        m_vu32GeometryElementSizes_B;
+    vector<uint32_t>                        m_vu32NClients;
+    vector<uint32_t>                        m_vu32NCallbacks;
+    uint32_t                                m_u32Duration_ms;
+    uint64_t                                m_u64Rate_pps;
+    cConnectionThread::slowClientPolicy     m_eServerPolicy;
+    uint16_t                                m_u16Port;
+    bool                                    m_bCSV;
+};
+
+class cBenchmarkResult
+{
+public:
+    cBenchmarkResult() :
+        m_u32PacketSize_B(0),
+        m_u32NElements(0),
+        m_u32ElementSize_B(0),
+        m_u32NClients(0),
+        m_u32NCallbacks(0),
+        m_u64NPacketsSent(0),
+        m_u64NPacketsReceived(0),
+        m_u64NBytesReceived(0),
+        m_dElapsed_s(0.0)
+    {
+    }
+
+    string                                  m_strClass;
+    uint32_t                                m_u32PacketSize_B;
+    uint32_t                                m_u32NElements;
+    uint32_t                                m_u32ElementSize_B;
+    uint32_t                                m_u32NClients;
+    uint32_t                                m_u32NCallbacks;
+
+    uint64_t                                m_u64NPacketsSent; //Per consumer
+    uint64_t                                m_u64NPacketsReceived; //Worst consumer
+    uint64_t                                m_u64NBytesReceived; //Worst consumer
+    double                                  m_dElapsed_s;
+    vector<uint64_t>                        m_vu64Latencies_ns; //All consumers
+};
+
+//Generators
+
+void udpGeneratorThreadFunction(uint16_t u16Port, uint32_t u32PacketSize_B, uint32_t u32Duration_ms, uint64_t u64Rate_pps,
+                                boost::atomic<uint64_t> *pu64NPacketsSent)
+{
+    int iSocket = socket(AF_INET, SOCK_DGRAM, 0);
+
+    sockaddr_in sDestination;
+    memset(&sDestination, 0, sizeof(sDestination));
+    sDestination.sin_family = AF_INET;
+    sDestination.sin_port = htons(u16Port);
+    sDestination.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    vector<char> vcRecord(u32PacketSize_B, 0);
+    cPacer oPacer(u64Rate_pps);
+
+    uint64_t u64End_ns = getTime_ns() + (uint64_t)u32Duration_ms * 1000000ULL;
+    uint64_t u64Sequence = 0;
+
+    while(getTime_ns() < u64End_ns)
+    {
+        oPacer.waitForPacket(u64Sequence);
+        stampRecord(&vcRecord.front(), u64Sequence + 1);
+
+        if(sendto(iSocket, &vcRecord.front(), vcRecord.size(), 0, (sockaddr*)&sDestination, sizeof(sDestination)) == (ssize_t)vcRecord.size())
+        {
+            u64Sequence++;
+        }
+        else if(errno != ENOBUFS && errno != EAGAIN)
+        {
+            cout << "udpGeneratorThreadFunction(): sendto() failed: " << strerror(errno) << endl;
+            break;
+        }
+    }
+
+    pu64NPacketsSent->store(u64Sequence);
+
+    close(iSocket);
+}
+
+bool writeAll(int iSocket, const char *cpData, uint32_t u32Size_B)
+{
+    while(u32Size_B)
+    {
+        ssize_t i64NBytesWritten = send(iSocket, cpData, u32Size_B, MSG_NOSIGNAL);
+
+        if(i64NBytesWritten <= 0)
+            return false;
+
+        cpData += i64NBytesWritten;
+        u32Size_B -= i64NBytesWritten;
+    }
+
+    return true;
+}
+
+//Accepts one connection (from cTCPReceiver) and streams records to it
+void tcpGeneratorThreadFunction(int iListeningSocket, uint32_t u32PacketSize_B, uint32_t u32Duration_ms, uint64_t u64Rate_pps,
+                                boost::atomic<uint64_t> *pu64NPacketsSent)
+{
+    pollfd sPollFD = { iListeningSocket, POLLIN, 0 };
+
+    if(poll(&sPollFD, 1, 5000) <= 0)
+    {
+        cout << "tcpGeneratorThreadFunction(): cTCPReceiver did not connect." << endl;
+        return;
+    }
+
+    int iSocket = accept(iListeningSocket, NULL, NULL);
+
+    vector<char> vcRecord(u32PacketSize_B, 0);
+    cPacer oPacer(u64Rate_pps);
+
+    uint64_t u64End_ns = getTime_ns() + (uint64_t)u32Duration_ms * 1000000ULL;
+    uint64_t u64Sequence = 0;
+
+    while(getTime_ns() < u64End_ns)
+    {
+        oPacer.waitForPacket(u64Sequence);
+        stampRecord(&vcRecord.front(), u64Sequence + 1);
+
+        if(!writeAll(iSocket, &vcRecord.front(), vcRecord.size()))
+            break;
+
+        u64Sequence++;
+    }
+
+    pu64NPacketsSent->store(u64Sequence);
+
+    close(iSocket);
+}
+
+//Client of cTCPServer. Reads until the server closes the connection or the stop flag is set.
+void tcpClientThreadFunction(int iSocket, cRecordStatistics *pStatistics, boost::atomic<bool> *pbStopFlag)
+{
+    vector<char> vcReadBuffer(1 << 16);
+    pollfd sPollFD = { iSocket, POLLIN, 0 };
+
+    while(!pbStopFlag->load())
+    {
+        if(poll(&sPollFD, 1, 50) <= 0)
+            continue;
+
+        ssize_t i64NBytesRead = recv(iSocket, &vcReadBuffer.front(), vcReadBuffer.size(), 0);
+
+        if(i64NBytesRead <= 0)
+            break;
+
+        pStatistics->addData(&vcReadBuffer.front(), i64NBytesRead);
+    }
+}
+
+int openListeningSocket(uint16_t u16Port)
+{
+    int iSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+    int iReuse = 1;
+    setsockopt(iSocket, SOL_SOCKET, SO_REUSEADDR, &iReuse, sizeof(iReuse));
+
+    sockaddr_in sAddress;
+    memset(&sAddress, 0, sizeof(sAddress));
+    sAddress.sin_family = AF_INET;
+    sAddress.sin_port = htons(u16Port);
+    sAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    if(bind(iSocket, (sockaddr*)&sAddress, sizeof(sAddress)) < 0 || listen(iSocket, 1) < 0)
+    {
+        cout << "openListeningSocket(): Unable to listen on port " << u16Port << ": " << strerror(errno) << endl;
+        close(iSocket);
+        return -1;
+    }
+
+    return iSocket;
+}
+
+int connectToServer(uint16_t u16Port)
+{
+    sockaddr_in sAddress;
+    memset(&sAddress, 0, sizeof(sAddress));
+    sAddress.sin_family = AF_INET;
+    sAddress.sin_port = htons(u16Port);
+    sAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    //The server may still be binding
+    for(uint32_t u32Attempt = 0; u32Attempt < 50; u32Attempt++)
+    {
+        int iSocket = socket(AF_INET, SOCK_STREAM, 0);
+
+        if(connect(iSocket, (sockaddr*)&sAddress, sizeof(sAddress)) == 0)
+            return iSocket;
+
+        close(iSocket);
+        boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    }
+
+    return -1;
+}
+
+//Runs
+
+void collectReceiverResults(vector<boost::shared_ptr<cBenchmarkCallbackHandler> > &vpHandlers, cBenchmarkResult &oResult)
+{
+    oResult.m_u64NPacketsReceived = vpHandlers[0]->m_oStatistics.getNRecords();
+    oResult.m_u64NBytesReceived = vpHandlers[0]->m_oStatistics.getNBytes();
+
+    for(uint32_t ui = 0; ui < vpHandlers.size(); ui++)
+    {
+        if(vpHandlers[ui]->m_oStatistics.getNRecords() < oResult.m_u64NPacketsReceived)
+        {
+            oResult.m_u64NPacketsReceived = vpHandlers[ui]->m_oStatistics.getNRecords();
+            oResult.m_u64NBytesReceived = vpHandlers[ui]->m_oStatistics.getNBytes();
+        }
+
+        const vector<uint64_t> &vu64Latencies_ns = vpHandlers[ui]->m_oStatistics.getLatencies_ns();
+        oResult.m_vu64Latencies_ns.insert(oResult.m_vu64Latencies_ns.end(), vu64Latencies_ns.begin(), vu64Latencies_ns.end());
+    }
+}
+
+cBenchmarkResult runUDPReceiverBenchmark(const cBenchmarkConfiguration &oConfiguration, uint16_t u16Port, uint32_t u32PacketSize_B,
+                                         uint32_t u32NElements, uint32_t u32ElementSize_B, uint32_t u32NCallbacks)
+{
+    cBenchmarkResult oResult;
+    oResult.m_strClass = "udp";
+    oResult.m_u32PacketSize_B = u32PacketSize_B;
+    oResult.m_u32NElements = u32NElements;
+    oResult.m_u32ElementSize_B = max(u32ElementSize_B, u32PacketSize_B); //One datagram per element
+    oResult.m_u32NCallbacks = u32NCallbacks;
+
+    cUDPReceiver oReceiver("127.0.0.1", u16Port, string(""), 60001, oResult.m_u32NElements, oResult.m_u32ElementSize_B);
+    oReceiver.setPreserveDatagramBoundaries(true);
+
+    vector<boost::shared_ptr<cBenchmarkCallbackHandler> > vpHandlers;
+    for(uint32_t ui = 0; ui < u32NCallbacks; ui++)
+    {
+        vpHandlers.push_back(boost::make_shared<cBenchmarkCallbackHandler>(u32PacketSize_B));
+        oReceiver.registerDataCallbackHandler(vpHandlers.back());
+    }
+
+    oReceiver.startReceiving();
+    oReceiver.startCallbackOffloading();
+
+    //Give the receiving thread time to bind
+    boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+
+    boost::atomic<uint64_t> u64NPacketsSent(0);
+    uint64_t u64Start_ns = getTime_ns();
+
+    boost::thread oGeneratorThread(boost::bind(&udpGeneratorThreadFunction, u16Port, u32PacketSize_B, oConfiguration.m_u32Duration_ms,
+                                               oConfiguration.m_u64Rate_pps, &u64NPacketsSent));
+    oGeneratorThread.join();
+
+    //Let the receiver drain what is still in flight
+    boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+
+    oResult.m_dElapsed_s = (getTime_ns() - u64Start_ns) / 1e9;
+
+    oReceiver.stopCallbackOffloading();
+    oReceiver.stopReceiving();
+    oReceiver.shutdown();
+
+    oResult.m_u64NPacketsSent = u64NPacketsSent.load();
+    collectReceiverResults(vpHandlers, oResult);
+
+    return oResult;
+}
+
+cBenchmarkResult runTCPReceiverBenchmark(const cBenchmarkConfiguration &oConfiguration, uint16_t u16Port, uint32_t u32PacketSize_B,
+                                         uint32_t u32NElements, uint32_t u32ElementSize_B, uint32_t u32NCallbacks)
+{
+    cBenchmarkResult oResult;
+    oResult.m_strClass = "tcp";
+    oResult.m_u32PacketSize_B = u32PacketSize_B;
+    oResult.m_u32NElements = u32NElements;
+    oResult.m_u32ElementSize_B = u32ElementSize_B;
+    oResult.m_u32NCallbacks = u32NCallbacks;
+
+    int iListeningSocket = openListeningSocket(u16Port);
+    if(iListeningSocket < 0)
+        return oResult;
+
+    cTCPReceiver oReceiver("127.0.0.1", u16Port, u32NElements, u32ElementSize_B);
+
+    vector<boost::shared_ptr<cBenchmarkCallbackHandler> > vpHandlers;
+    for(uint32_t ui = 0; ui < u32NCallbacks; ui++)
+    {
+        vpHandlers.push_back(boost::make_shared<cBenchmarkCallbackHandler>(u32PacketSize_B));
+        oReceiver.registerDataCallbackHandler(vpHandlers.back());
+    }
+
+    boost::atomic<uint64_t> u64NPacketsSent(0);
+    uint64_t u64Start_ns = getTime_ns();
+
+    boost::thread oGeneratorThread(boost::bind(&tcpGeneratorThreadFunction, iListeningSocket, u32PacketSize_B, oConfiguration.m_u32Duration_ms,
+                                               oConfiguration.m_u64Rate_pps, &u64NPacketsSent));
+
+    oReceiver.startReceiving();
+    oReceiver.startCallbackOffloading();
+
+    oGeneratorThread.join();
+
+    //Elements are only handed on once full so the tail of the stream (less than one element) is not seen. Allow for it below.
+    boost::this_thread::sleep(boost::posix_time::milliseconds(200));
+
+    oResult.m_dElapsed_s = (getTime_ns() - u64Start_ns) / 1e9;
+
+    oReceiver.stopCallbackOffloading();
+    oReceiver.stopReceiving();
+    oReceiver.shutdown();
+
+    close(iListeningSocket);
+
+    oResult.m_u64NPacketsSent = u64NPacketsSent.load();
+    collectReceiverResults(vpHandlers, oResult);
+
+    uint64_t u64NPacketsPerElement = u32ElementSize_B / u32PacketSize_B + 1;
+    if(oResult.m_u64NPacketsSent > oResult.m_u64NPacketsReceived && oResult.m_u64NPacketsSent - oResult.m_u64NPacketsReceived <= u64NPacketsPerElement)
+        oResult.m_u64NPacketsSent = oResult.m_u64NPacketsReceived;
+
+    return oResult;
+}
+
+cBenchmarkResult runTCPServerBenchmark(const cBenchmarkConfiguration &oConfiguration, uint16_t u16Port, uint32_t u32PacketSize_B, uint32_t u32NClients)
+{
+    cBenchmarkResult oResult;
+    oResult.m_strClass = "server";
+    oResult.m_u32PacketSize_B = u32PacketSize_B;
+    oResult.m_u32NClients = u32NClients;
+
+    cTCPServer oServer("127.0.0.1", u16Port);
+    oServer.setSlowClientPolicy(oConfiguration.m_eServerPolicy);
+
+    vector<boost::shared_ptr<cRecordStatistics> > vpStatistics;
+    vector<int> viSockets;
+    boost::atomic<bool> bStopFlag(false);
+    boost::thread_group oClientThreads;
+
+    for(uint32_t ui = 0; ui < u32NClients; ui++)
+    {
+        int iSocket = connectToServer(u16Port);
+        if(iSocket < 0)
+        {
+            cout << "runTCPServerBenchmark(): Unable to connect to cTCPServer on port " << u16Port << endl;
+            break;
+        }
+
+        viSockets.push_back(iSocket);
+        vpStatistics.push_back(boost::make_shared<cRecordStatistics>(u32PacketSize_B));
+        oClientThreads.create_thread(boost::bind(&tcpClientThreadFunction, iSocket, vpStatistics.back().get(), &bStopFlag));
+    }
+
+    //Wait for the server to register all clients
+    for(uint32_t u32Attempt = 0; u32Attempt < 100 && oServer.getClientStatus().size() < viSockets.size(); u32Attempt++)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(20));
+
+    vector<char> vcRecord(u32PacketSize_B, 0);
+    cPacer oPacer(oConfiguration.m_u64Rate_pps);
+
+    uint64_t u64Start_ns = getTime_ns();
+    uint64_t u64End_ns = u64Start_ns + (uint64_t)oConfiguration.m_u32Duration_ms * 1000000ULL;
+    uint64_t u64Sequence = 0;
+
+    while(getTime_ns() < u64End_ns)
+    {
+        oPacer.waitForPacket(u64Sequence);
+        stampRecord(&vcRecord.front(), u64Sequence + 1);
+
+        oServer.writeData(&vcRecord.front(), vcRecord.size());
+        u64Sequence++;
+    }
+
+    //Let the clients drain their queues
+    boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+
+    oResult.m_dElapsed_s = (getTime_ns() - u64Start_ns) / 1e9;
+
+    bStopFlag.store(true);
+    oClientThreads.join_all();
+
+    oServer.shutdown();
+
+    for(uint32_t ui = 0; ui < viSockets.size(); ui++)
+        close(viSockets[ui]);
+
+    oResult.m_u64NPacketsSent = u64Sequence;
+
+    if(vpStatistics.size())
+    {
+        oResult.m_u64NPacketsReceived = vpStatistics[0]->getNRecords();
+        oResult.m_u64NBytesReceived = vpStatistics[0]->getNBytes();
+    }
+
+    for(uint32_t ui = 0; ui < vpStatistics.size(); ui++)
+    {
+        if(vpStatistics[ui]->getNRecords() < oResult.m_u64NPacketsReceived)
+        {
+            oResult.m_u64NPacketsReceived = vpStatistics[ui]->getNRecords();
+            oResult.m_u64NBytesReceived = vpStatistics[ui]->getNBytes();
+        }
+
+        const vector<uint64_t> &vu64Latencies_ns = vpStatistics[ui]->getLatencies_ns();
+        oResult.m_vu64Latencies_ns.insert(oResult.m_vu64Latencies_ns.end(), vu64Latencies_ns.begin(), vu64Latencies_ns.end());
+    }
+
+    return oResult;
+}
+
+//Reporting
+
+double getPercentile_us(vector<uint64_t> &vu64SortedLatencies_ns, double dPercentile)
+{
+    if(vu64SortedLatencies_ns.empty())
+        return 0.0;
+
+    uint64_t u64Index = (uint64_t)(dPercentile / 100.0 * (vu64SortedLatencies_ns.size() - 1) + 0.5);
+
+    return vu64SortedLatencies_ns[u64Index] / 1e3;
+}
+
+void printHeader(bool bCSV)
+{
+    if(bCSV)
+    {
+        cout << "class,packet_B,elements,element_B,clients,callbacks,sent,received,packets_per_s,gbit_per_s,drop_percent,p50_us,p99_us,p99.9_us,max_us" << endl;
+        return;
+    }
+
+    cout << left << setw(8) << "class" << right
+         << setw(10) << "packet_B" << setw(10) << "elements" << setw(11) << "element_B"
+         << setw(9) << "clients" << setw(11) << "callbacks"
+         << setw(12) << "packets/s" << setw(10) << "Gbit/s" << setw(9) << "drop_%"
+         << setw(10) << "p50_us" << setw(10) << "p99_us" << setw(11) << "p99.9_us" << setw(10) << "max_us" << endl;
+}
+
+void printResult(cBenchmarkResult &oResult, bool bCSV)
+{
+    sort(oResult.m_vu64Latencies_ns.begin(), oResult.m_vu64Latencies_ns.end());
+
+    double dPacketRate_pps = oResult.m_dElapsed_s > 0.0 ? oResult.m_u64NPacketsReceived / oResult.m_dElapsed_s : 0.0;
+    double dDataRate_Gbps = oResult.m_dElapsed_s > 0.0 ? oResult.m_u64NBytesReceived * 8.0 / oResult.m_dElapsed_s / 1e9 : 0.0;
+    double dDropRate_percent = 0.0;
+
+    if(oResult.m_u64NPacketsSent && oResult.m_u64NPacketsSent > oResult.m_u64NPacketsReceived)
+        dDropRate_percent = 100.0 * (oResult.m_u64NPacketsSent - oResult.m_u64NPacketsReceived) / oResult.m_u64NPacketsSent;
+
+    double dP50_us = getPercentile_us(oResult.m_vu64Latencies_ns, 50.0);
+    double dP99_us = getPercentile_us(oResult.m_vu64Latencies_ns, 99.0);
+    double dP999_us = getPercentile_us(oResult.m_vu64Latencies_ns, 99.9);
+    double dMax_us = oResult.m_vu64Latencies_ns.empty() ? 0.0 : oResult.m_vu64Latencies_ns.back() / 1e3;
+
+    if(bCSV)
+    {
+        cout << oResult.m_strClass << "," << oResult.m_u32PacketSize_B << "," << oResult.m_u32NElements << "," << oResult.m_u32ElementSize_B << ","
+             << oResult.m_u32NClients << "," << oResult.m_u32NCallbacks << "," << oResult.m_u64NPacketsSent << "," << oResult.m_u64NPacketsReceived << ","
+             << fixed << setprecision(0) << dPacketRate_pps << "," << setprecision(3) << dDataRate_Gbps << "," << dDropRate_percent << ","
+             << setprecision(1) << dP50_us << "," << dP99_us << "," << dP999_us << "," << dMax_us << endl;
+        return;
+    }
+
+    cout << left << setw(8) << oResult.m_strClass << right
+         << setw(10) << oResult.m_u32PacketSize_B << setw(10) << oResult.m_u32NElements << setw(11) << oResult.m_u32ElementSize_B
+         << setw(9) << oResult.m_u32NClients << setw(11) << oResult.m_u32NCallbacks
+         << fixed << setprecision(0) << setw(12) << dPacketRate_pps << setprecision(3) << setw(10) << dDataRate_Gbps << setw(9) << dDropRate_percent
+         << setprecision(1) << setw(10) << dP50_us << setw(10) << dP99_us << setw(11) << dP999_us << setw(10) << dMax_us << endl;
+}
+
+//Command line
+
+vector<string> splitList(const string &strList)
+{
+    vector<string> vstrItems;
+    stringstream oStream(strList);
+    string strItem;
+
+    while(getline(oStream, strItem, ','))
+    {
+        if(strItem.length())
+            vstrItems.push_back(strItem);
+    }
+
+    return vstrItems;
+}
+
+vector<uint32_t> parseNumberList(const string &strList)
+{
+    vector<string> vstrItems = splitList(strList);
+    vector<uint32_t> vu32Numbers;
+
+    for(uint32_t ui = 0; ui < vstrItems.size(); ui++)
+        vu32Numbers.push_back(strtoul(vstrItems[ui].c_str(), NULL, 10));
+
+    return vu32Numbers;
+}
+
+void printUsage(const char *cpProgramName)
+{
+    cout << "Usage: " << cpProgramName << " [--classes udp,tcp,server] [--packet_sizes 64,1024,8192] [--geometries 1024x9000]" << endl;
+    cout << "       [--clients 1,4] [--callbacks 1,2] [--duration_ms 2000] [--rate packets_per_s] [--port 60100]" << endl;
+    cout << "       [--server_policy block|drop_newest|drop_oldest] [--csv]" << endl;
+}
+
+bool parseArguments(int argc, char *argv[], cBenchmarkConfiguration &oConfiguration)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        string strArgument(argv[i]);
+
+        if(strArgument == "--csv")
+        {
+            oConfiguration.m_bCSV = true;
+            continue;
+        }
+
+        if(i + 1 >= argc)
+            return false;
+
+        string strValue(argv[++i]);
+
+        if(strArgument == "--classes")
+        {
+            oConfiguration.m_vstrClasses = splitList(strValue);
+        }
+        else if(strArgument == "--packet_sizes")
+        {
+            oConfiguration.m_vu32PacketSizes_B = parseNumberList(strValue);
+        }
+        else if(strArgument == "--geometries")
+        {
+            vector<string> vstrGeometries = splitList(strValue);
+
+            oConfiguration.m_vu32GeometryNElements.clear();
+            oConfiguration.m_vu32GeometryElementSizes_B.clear();
+
+            for(uint32_t ui = 0; ui < vstrGeometries.size(); ui++)
+            {
+                size_t iSeparator = vstrGeometries[ui].find('x');
+                if(iSeparator == string::npos)
+                    return false;
+
+                oConfiguration.m_vu32GeometryNElements.push_back(strtoul(vstrGeometries[ui].substr(0, iSeparator).c_str(), NULL, 10));
+                oConfiguration.m_vu32GeometryElementSizes_B.push_back(strtoul(vstrGeometries[ui].substr(iSeparator + 1).c_str(), NULL, 10));
+            }
+        }
+        else if(strArgument == "--clients")
+        {
+            oConfiguration.m_vu32NClients = parseNumberList(strValue);
+        }
+        else if(strArgument == "--callbacks")
+        {
+            oConfiguration.m_vu32NCallbacks = parseNumberList(strValue);
+        }
+        else if(strArgument == "--duration_ms")
+        {
+            oConfiguration.m_u32Duration_ms = strtoul(strValue.c_str(), NULL, 10);
+        }
+        else if(strArgument == "--rate")
+        {
+            oConfiguration.m_u64Rate_pps = strtoull(strValue.c_str(), NULL, 10);
+        }
+        else if(strArgument == "--port")
+        {
+            oConfiguration.m_u16Port = strtoul(strValue.c_str(), NULL, 10);
+        }
+        else if(strArgument == "--server_policy")
+        {
+            if(strValue == "block")
+                oConfiguration.m_eServerPolicy = cConnectionThread::SLOW_CLIENT_BLOCK;
+            else if(strValue == "drop_newest")
+                oConfiguration.m_eServerPolicy = cConnectionThread::SLOW_CLIENT_DROP_NEWEST;
+            else if(strValue == "drop_oldest")
+                oConfiguration.m_eServerPolicy = cConnectionThread::SLOW_CLIENT_DROP_OLDEST;
+            else
+                return false;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    for(uint32_t ui = 0; ui < oConfiguration.m_vu32PacketSizes_B.size(); ui++)
+    {
+        if(oConfiguration.m_vu32PacketSizes_B[ui] < RECORD_HEADER_SIZE_B)
+        {
+            cout << "Packet sizes must be at least " << RECORD_HEADER_SIZE_B << " bytes." << endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} //namespace
+
+int main(int argc, char *argv[])
+{
+    cBenchmarkConfiguration oConfiguration;
+
+    if(!parseArguments(argc, argv, oConfiguration))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    //Keep connection chatter out of the results
+    cLogger::getInstance().setMinimumSeverity(cLogger::SEVERITY_WARNING);
+
+    uint16_t u16Port = oConfiguration.m_u16Port;
+
+    printHeader(oConfiguration.m_bCSV);
+
+    for(uint32_t u32ClassNo = 0; u32ClassNo < oConfiguration.m_vstrClasses.size(); u32ClassNo++)
+    {
+        const string &strClass = oConfiguration.m_vstrClasses[u32ClassNo];
+
+        for(uint32_t u32SizeNo = 0; u32SizeNo < oConfiguration.m_vu32PacketSizes_B.size(); u32SizeNo++)
+        {
+            uint32_t u32PacketSize_B = oConfiguration.m_vu32PacketSizes_B[u32SizeNo];
+
+            if(strClass == "server")
+            {
+                for(uint32_t u32ClientsNo = 0; u32ClientsNo < oConfiguration.m_vu32NClients.size(); u32ClientsNo++)
+                {
+                    cBenchmarkResult oResult = runTCPServerBenchmark(oConfiguration, u16Port++, u32PacketSize_B, oConfiguration.m_vu32NClients[u32ClientsNo]);
+                    printResult(oResult, oConfiguration.m_bCSV);
+                }
+
+                continue;
+            }
+
+            if(strClass != "udp" && strClass != "tcp")
+            {
+                cout << "Unknown class " << strClass << ". Skipping." << endl;
+                break;
+            }
+
+            for(uint32_t u32GeometryNo = 0; u32GeometryNo < oConfiguration.m_vu32GeometryNElements.size(); u32GeometryNo++)
+            {
+                for(uint32_t u32CallbacksNo = 0; u32CallbacksNo < oConfiguration.m_vu32NCallbacks.size(); u32CallbacksNo++)
+                {
+                    cBenchmarkResult oResult;
+
+                    if(strClass == "udp")
+                        oResult = runUDPReceiverBenchmark(oConfiguration, u16Port++, u32PacketSize_B, oConfiguration.m_vu32GeometryNElements[u32GeometryNo],
+                                                          oConfiguration.m_vu32GeometryElementSizes_B[u32GeometryNo], oConfiguration.m_vu32NCallbacks[u32CallbacksNo]);
+                    else
+                        oResult = runTCPReceiverBenchmark(oConfiguration, u16Port++, u32PacketSize_B, oConfiguration.m_vu32GeometryNElements[u32GeometryNo],
+                                                          oConfiguration.m_vu32GeometryElementSizes_B[u32GeometryNo], oConfiguration.m_vu32NCallbacks[u32CallbacksNo]);
+
+                    printResult(oResult, oConfiguration.m_bCSV);
+                }
+            }
+        }
+    }
+
+    return 0;
+}
+
+#else
+
+int main()
+{
+    cout << "The socket streamers benchmark is only implemented for Linux." << endl;
+
+    return 1;
+}
+
+#endif
@@ -0,0 +1,123 @@
+//System includes
+#ifdef __linux__
+#include <sys/eventfd.h>
+#include <unistd.h>
+#endif
+
+//Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread_time.hpp>
+#endif
+
+//Local includes
+#include "EventNotifier.h"
+
+using namespace std;
+
+cEventNotifier::cEventNotifier(bool bUseFileDescriptor) :
+    m_u32NWaiters(0),
+    m_u64Epoch(0),
+    m_iFileDescriptor(-1)
+{
+#ifdef __linux__
+    if(bUseFileDescriptor)
+        m_iFileDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+#endif
+}
+
+cEventNotifier::~cEventNotifier()
+{
+#ifdef __linux__
+    if(m_iFileDescriptor >= 0)
+        close(m_iFileDescriptor);
+#endif
+}
+
+uint64_t cEventNotifier::prepareWait()
+{
+    m_u32NWaiters.fetch_add(1);
+
+    //Order the registration before the caller's subsequent check of its condition (pairs with the fence in notify())
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+    return m_u64Epoch.load();
+}
+
+bool cEventNotifier::wait(uint64_t u64Epoch, uint32_t u32Timeout_ms)
+{
+    bool bNotified = true;
+
+    {
+        boost::system_time oDeadline = boost::get_system_time() + boost::posix_time::milliseconds(u32Timeout_ms);
+
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        while(m_u64Epoch.load() == u64Epoch)
+        {
+            if(!u32Timeout_ms)
+            {
+                m_oCondition.wait(oLock);
+            }
+            else if(!m_oCondition.timed_wait(oLock, oDeadline))
+            {
+                bNotified = (m_u64Epoch.load() != u64Epoch);
+                break;
+            }
+        }
+    }
+
+    m_u32NWaiters.fetch_sub(1);
+
+    return bNotified;
+}
+
+void cEventNotifier::cancelWait()
+{
+    m_u32NWaiters.fetch_sub(1);
+}
+
+void cEventNotifier::notify()
+{
+    //Order the caller's preceding state change before the check for waiters (pairs with the fence in prepareWait())
+    boost::atomic_thread_fence(boost::memory_order_seq_cst);
+
+    if(!m_u32NWaiters.load(boost::memory_order_relaxed))
+        return;
+
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+        m_u64Epoch.fetch_add(1);
+    }
+
+    m_oCondition.notify_all();
+
+#ifdef __linux__
+    if(m_iFileDescriptor >= 0)
+    {
+        uint64_t u64Increment = 1;
+        if(write(m_iFileDescriptor, &u64Increment, sizeof(u64Increment)) < 0)
+        {
+            //Counter saturated, the descriptor is readable anyway.
+        }
+    }
+#endif
+}
+
+int cEventNotifier::getFileDescriptor()
+{
+    return m_iFileDescriptor;
+}
+
+void cEventNotifier::clearFileDescriptor()
+{
+#ifdef __linux__
+    if(m_iFileDescriptor < 0)
+        return;
+
+    uint64_t u64Count;
+    while(read(m_iFileDescriptor, &u64Count, sizeof(u64Count)) > 0)
+    {
+    }
+#endif
+}
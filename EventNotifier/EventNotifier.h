@@ -0,0 +1,63 @@
+#ifndef EVENT_NOTIFIER_H
+#define EVENT_NOTIFIER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#endif
+
+//Local includes
+
+//Wakeup primitive (an "event count") used to block threads until some condition changes instead of polling with timeouts.
+//A waiter registers with prepareWait(), re-checks its condition and then calls wait() with the returned epoch. Any call to
+//notify() after prepareWait() makes wait() return immediately so no wakeups are lost. notify() costs a fence and a load
+//when nobody is waiting so it can be called on hot paths.
+
+//Optionally an eventfd is signalled on notify() so that a thread can also wait on it with poll() alongside sockets.
+//Such a thread must still call prepareWait() before checking its condition, clearFileDescriptor() once woken and cancelWait()
+//when done.
+
+class cEventNotifier
+{
+public:
+    explicit cEventNotifier(bool bUseFileDescriptor = false);
+    ~cEventNotifier();
+
+    uint64_t                                            prepareWait();
+    bool                                                wait(uint64_t u64Epoch, uint32_t u32Timeout_ms = 0); //Returns false on timeout
+    void                                                cancelWait();
+
+    void                                                notify();
+
+    int                                                 getFileDescriptor(); //-1 if not available
+    void                                                clearFileDescriptor();
+
+private:
+    boost::atomic<uint32_t>                             m_u32NWaiters;
+    boost::atomic<uint64_t>                             m_u64Epoch;
+
+    boost::mutex                                        m_oMutex;
+    boost::condition_variable                           m_oCondition;
+
+    int                                                 m_iFileDescriptor;
+};
+
+#endif // EVENT_NOTIFIER_H
@@ -0,0 +1,464 @@
+//System includes
+#include <cstring>
+#include <algorithm>
+
+#ifdef __linux__
+#include <time.h>
+#endif
+
+//Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/interprocess/exceptions.hpp>
+#endif
+
+//Local includes
+#include "FileReplayReceiver.h"
+#include "../StreamRecorder/StreamRecorder.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+namespace
+{
+    //Packets per buffer wait when replaying as fast as possible
+    const uint32_t MAX_BATCH_SIZE = 64;
+
+    //Waits shorter than this are spun rather than slept
+    const uint64_t SPIN_THRESHOLD_NS = 200000;
+}
+
+cFileReplayReceiver::cRecordReader::cRecordReader(const char *cpFile, uint64_t u64FileSize_B) :
+    m_cpFile(cpFile),
+    m_u64FileSize_B(u64FileSize_B),
+    m_u32BlockSize_B(0),
+    m_u32RecordHeaderSize_B(cStreamRecorder::RECORD_HEADER_SIZE_B),
+    m_u64BlockOffset_B(0),
+    m_u32BlockBytesUsed_B(0),
+    m_u32RecordOffset_B(0),
+    m_bValid(false)
+{
+    //File header: char[8] magic, uint32 version, uint32 block size, ...
+    if(m_u64FileSize_B < 16 || memcmp(m_cpFile, "AVNREC01", 8))
+        return;
+
+    uint32_t u32Version;
+    memcpy(&u32Version, m_cpFile + 8, sizeof(u32Version));
+    memcpy(&m_u32BlockSize_B, m_cpFile + 12, sizeof(m_u32BlockSize_B));
+
+    if(m_u32BlockSize_B <= cStreamRecorder::BLOCK_HEADER_SIZE_B)
+        return;
+
+    if(u32Version == 1)
+        m_u32RecordHeaderSize_B = cStreamRecorder::RECORD_HEADER_SIZE_V1_B;
+    else if(u32Version != cStreamRecorder::FILE_FORMAT_VERSION)
+        return;
+
+    //The first data block follows the header block. Start with an empty "current" block.
+    m_u64BlockOffset_B = 0;
+    m_bValid = true;
+}
+
+bool cFileReplayReceiver::cRecordReader::isValid()
+{
+    return m_bValid;
+}
+
+bool cFileReplayReceiver::cRecordReader::loadBlock()
+{
+    while(true)
+    {
+        m_u64BlockOffset_B += m_u32BlockSize_B;
+
+        if(m_u64BlockOffset_B + m_u32BlockSize_B > m_u64FileSize_B)
+            return false;
+
+        const char *cpBlock = m_cpFile + m_u64BlockOffset_B;
+
+        memcpy(&m_u32BlockBytesUsed_B, cpBlock + 4, sizeof(m_u32BlockBytesUsed_B));
+
+        //Skip damaged blocks
+        if(memcmp(cpBlock, "AVNB", 4) || m_u32BlockBytesUsed_B > m_u32BlockSize_B)
+            continue;
+
+        m_u32RecordOffset_B = cStreamRecorder::BLOCK_HEADER_SIZE_B;
+
+        return true;
+    }
+}
+
+bool cFileReplayReceiver::cRecordReader::getNextRecord(cRecord &oRecord)
+{
+    if(!m_bValid)
+        return false;
+
+    while(m_u32RecordOffset_B + m_u32RecordHeaderSize_B > m_u32BlockBytesUsed_B)
+    {
+        if(!loadBlock())
+            return false;
+    }
+
+    const char *cpRecord = m_cpFile + m_u64BlockOffset_B + m_u32RecordOffset_B;
+
+    memcpy(&oRecord.m_u32Size_B, cpRecord, sizeof(oRecord.m_u32Size_B));
+    memcpy(&oRecord.m_u64Timestamp_ns, cpRecord + 8, sizeof(oRecord.m_u64Timestamp_ns));
+    oRecord.m_cpData = cpRecord + m_u32RecordHeaderSize_B;
+
+    oRecord.m_oMetadata.clear();
+    oRecord.m_oMetadata.m_u32PayloadSize_B = oRecord.m_u32Size_B;
+    oRecord.m_oMetadata.m_i64ReceiveTime_ns = oRecord.m_u64Timestamp_ns;
+
+    if(m_u32RecordHeaderSize_B >= cStreamRecorder::RECORD_HEADER_SIZE_B)
+    {
+        memcpy(oRecord.m_oMetadata.m_au8SourceAddress, cpRecord + 16, sizeof(oRecord.m_oMetadata.m_au8SourceAddress));
+        memcpy(&oRecord.m_oMetadata.m_u16SourcePort, cpRecord + 32, sizeof(oRecord.m_oMetadata.m_u16SourcePort));
+        oRecord.m_oMetadata.m_u8AddressFamily = cpRecord[34];
+        oRecord.m_oMetadata.m_bKernelTimestamp = cpRecord[35] & 1;
+        memcpy(&oRecord.m_oMetadata.m_u32PayloadSize_B, cpRecord + 36, sizeof(oRecord.m_oMetadata.m_u32PayloadSize_B));
+    }
+
+    uint32_t u32RecordSize_B = (m_u32RecordHeaderSize_B + oRecord.m_u32Size_B + 7) & ~7U;
+
+    //A record running past the end of its block means the block is damaged. Move on to the next one.
+    if(oRecord.m_u32Size_B > m_u32BlockBytesUsed_B || m_u32RecordOffset_B + u32RecordSize_B > m_u32BlockBytesUsed_B)
+    {
+        m_u32RecordOffset_B = m_u32BlockBytesUsed_B;
+        return getNextRecord(oRecord);
+    }
+
+    m_u32RecordOffset_B += u32RecordSize_B;
+
+    return true;
+}
+
+cFileReplayReceiver::cFileReplayReceiver(const string &strFilename) :
+    cSocketReceiverBase(strFilename, 0),
+    m_vstrFilenames(1, strFilename),
+    m_vu32LargestPacketSizes_B(m_vstrFilenames.size(), 0),
+    m_vu64ScannedFileSizes_B(m_vstrFilenames.size(), 0),
+    m_ePacingMode(PACING_ORIGINAL_TIMESTAMPS),
+    m_dRate(1.0),
+    m_u32NLoops(1),
+    m_bReplayFinished(false),
+    m_u64NPacketsReplayed(0),
+    m_u64ReplayStart_ns(0),
+    m_u64FirstTimestamp_ns(0),
+    m_u64LastTimestamp_ns(0),
+    m_u64NPacketsPaced(0)
+{
+    sizeBufferForFiles();
+}
+
+cFileReplayReceiver::cFileReplayReceiver(const vector<string> &vstrFilenames) :
+    cSocketReceiverBase(vstrFilenames.size() ? vstrFilenames.front() : string(""), 0),
+    m_vstrFilenames(vstrFilenames),
+    m_vu32LargestPacketSizes_B(m_vstrFilenames.size(), 0),
+    m_vu64ScannedFileSizes_B(m_vstrFilenames.size(), 0),
+    m_ePacingMode(PACING_ORIGINAL_TIMESTAMPS),
+    m_dRate(1.0),
+    m_u32NLoops(1),
+    m_bReplayFinished(false),
+    m_u64NPacketsReplayed(0),
+    m_u64ReplayStart_ns(0),
+    m_u64FirstTimestamp_ns(0),
+    m_u64LastTimestamp_ns(0),
+    m_u64NPacketsPaced(0)
+{
+    sizeBufferForFiles();
+}
+
+cFileReplayReceiver::~cFileReplayReceiver()
+{
+    //Base destructor calls shutdown.
+}
+
+void cFileReplayReceiver::setPacing(pacingMode ePacingMode, double dRate)
+{
+    if(ePacingMode != PACING_AS_FAST_AS_POSSIBLE && dRate <= 0.0)
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cFileReplayReceiver::setPacing(): Warning: Rate must be positive. Ignoring.";
+        return;
+    }
+
+    m_ePacingMode = ePacingMode;
+    m_dRate = dRate;
+}
+
+cFileReplayReceiver::pacingMode cFileReplayReceiver::getPacingMode()
+{
+    return m_ePacingMode;
+}
+
+void cFileReplayReceiver::setNLoops(uint32_t u32NLoops)
+{
+    m_u32NLoops = u32NLoops;
+}
+
+bool cFileReplayReceiver::isReplayFinished()
+{
+    return m_bReplayFinished.load();
+}
+
+uint64_t cFileReplayReceiver::getNPacketsReplayed()
+{
+    return m_u64NPacketsReplayed.load(boost::memory_order_relaxed);
+}
+
+uint64_t cFileReplayReceiver::getMonotonicTime_ns()
+{
+#ifdef __linux__
+    timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+    return (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec;
+#else
+    static const boost::posix_time::ptime oEpoch(boost::gregorian::date(1970, 1, 1));
+
+    return (boost::posix_time::microsec_clock::universal_time() - oEpoch).total_microseconds() * 1000ULL;
+#endif
+}
+
+bool cFileReplayReceiver::waitUntil(uint64_t u64Time_ns)
+{
+    while(true)
+    {
+        if(isReceivingStopRequested())
+            return false;
+
+        uint64_t u64Now_ns = getMonotonicTime_ns();
+
+        if(u64Now_ns >= u64Time_ns)
+            return true;
+
+        if(u64Time_ns - u64Now_ns < SPIN_THRESHOLD_NS)
+            continue;
+
+        //Sleep on the run state notifier so that stopReceiving() ends long gaps immediately. Wake up early and spin the rest.
+        uint64_t u64Epoch = m_oRunStateNotifier.prepareWait();
+
+        if(isReceivingStopRequested())
+        {
+            m_oRunStateNotifier.cancelWait();
+            return false;
+        }
+
+        uint32_t u32Timeout_ms = (u64Time_ns - u64Now_ns - SPIN_THRESHOLD_NS / 2) / 1000000;
+
+        if(u32Timeout_ms)
+        {
+            m_oRunStateNotifier.wait(u64Epoch, u32Timeout_ms);
+        }
+        else
+        {
+            m_oRunStateNotifier.cancelWait();
+            boost::this_thread::yield();
+        }
+    }
+}
+
+bool cFileReplayReceiver::pace(const cRecord &oRecord)
+{
+    uint64_t u64Due_ns;
+
+    switch(m_ePacingMode)
+    {
+    case PACING_ORIGINAL_TIMESTAMPS:
+        if(!m_u64NPacketsPaced)
+            m_u64FirstTimestamp_ns = oRecord.m_u64Timestamp_ns;
+
+        //Timestamps going backwards (e.g. the next loop) restart the schedule
+        if(oRecord.m_u64Timestamp_ns < m_u64LastTimestamp_ns)
+        {
+            m_u64FirstTimestamp_ns = oRecord.m_u64Timestamp_ns;
+            m_u64ReplayStart_ns = getMonotonicTime_ns();
+        }
+
+        m_u64LastTimestamp_ns = oRecord.m_u64Timestamp_ns;
+
+        u64Due_ns = m_u64ReplayStart_ns + (uint64_t)((oRecord.m_u64Timestamp_ns - m_u64FirstTimestamp_ns) / m_dRate);
+        break;
+
+    case PACING_FIXED_RATE:
+        u64Due_ns = m_u64ReplayStart_ns + (uint64_t)(m_u64NPacketsPaced * 1e9 / m_dRate);
+        break;
+
+    default:
+        return !isReceivingStopRequested();
+    }
+
+    m_u64NPacketsPaced++;
+
+    return waitUntil(u64Due_ns);
+}
+
+bool cFileReplayReceiver::mapFile(const string &strFilename, boost::interprocess::mapped_region &oMappedRegion)
+{
+    try
+    {
+        //The region stays valid after the mapping object is destroyed
+        boost::interprocess::file_mapping oFileMapping(strFilename.c_str(), boost::interprocess::read_only);
+        boost::interprocess::mapped_region oNewMappedRegion(oFileMapping, boost::interprocess::read_only);
+
+        oMappedRegion.swap(oNewMappedRegion);
+    }
+    catch(boost::interprocess::interprocess_exception &oError)
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cFileReplayReceiver::mapFile(): Error: Unable to map " << strFilename << ": " << oError.what();
+        return false;
+    }
+
+    return true;
+}
+
+uint32_t cFileReplayReceiver::getLargestPacketSize_B(const boost::interprocess::mapped_region &oMappedRegion)
+{
+    cRecordReader oReader((const char*)oMappedRegion.get_address(), oMappedRegion.get_size());
+    cRecord oRecord;
+    uint32_t u32LargestPacket_B = 0;
+
+    while(oReader.getNextRecord(oRecord))
+    {
+        if(oRecord.m_u32Size_B > u32LargestPacket_B)
+            u32LargestPacket_B = oRecord.m_u32Size_B;
+    }
+
+    return u32LargestPacket_B;
+}
+
+uint32_t cFileReplayReceiver::getLargestPacketSize_B(uint32_t u32FileNo, const boost::interprocess::mapped_region &oMappedRegion)
+{
+    //Capture files are only appended to (e.g. while still being recorded) or replaced, so a change in size triggers a rescan
+    if(m_vu64ScannedFileSizes_B[u32FileNo] != oMappedRegion.get_size())
+    {
+        m_vu32LargestPacketSizes_B[u32FileNo] = getLargestPacketSize_B(oMappedRegion);
+        m_vu64ScannedFileSizes_B[u32FileNo] = oMappedRegion.get_size();
+    }
+
+    return m_vu32LargestPacketSizes_B[u32FileNo];
+}
+
+void cFileReplayReceiver::sizeBufferForFiles()
+{
+    //Resizing is only safe while no thread uses the buffer, i.e. before receiving and offloading are started
+    uint32_t u32LargestPacket_B = 0;
+
+    for(uint32_t u32FileNo = 0; u32FileNo < m_vstrFilenames.size(); u32FileNo++)
+    {
+        boost::interprocess::mapped_region oMappedRegion;
+
+        if(mapFile(m_vstrFilenames[u32FileNo], oMappedRegion))
+            u32LargestPacket_B = max(u32LargestPacket_B, getLargestPacketSize_B(u32FileNo, oMappedRegion));
+    }
+
+    if(u32LargestPacket_B > m_oBuffer.getElementSize_B())
+        m_oBuffer.resize(m_oBuffer.getNElements(), u32LargestPacket_B);
+}
+
+bool cFileReplayReceiver::replayFile(uint32_t u32FileNo)
+{
+    const string &strFilename = m_vstrFilenames[u32FileNo];
+    boost::interprocess::mapped_region oMappedRegion;
+
+    if(!mapFile(strFilename, oMappedRegion))
+        return true; //Carry on with the next file
+
+    cRecordReader oReader((const char*)oMappedRegion.get_address(), oMappedRegion.get_size());
+
+    if(!oReader.isValid())
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cFileReplayReceiver::replayFile(): Error: " << strFilename << " is not a capture file.";
+        return true;
+    }
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cFileReplayReceiver::replayFile(): Replaying " << strFilename;
+
+    //Normally sized by the constructor. The file may have changed since.
+    uint32_t u32LargestPacket_B = getLargestPacketSize_B(u32FileNo, oMappedRegion);
+
+    if(u32LargestPacket_B > m_oBuffer.getElementSize_B())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cFileReplayReceiver::replayFile(): Warning: Input buffer element size is too small for packets in "
+                                           << strFilename << ". Growing elements to " << u32LargestPacket_B << " bytes";
+
+        //Queued packets are kept (see cPacketRingBuffer::requestResize())
+        m_oBuffer.requestResize(m_oBuffer.getNElements(), u32LargestPacket_B);
+    }
+
+    uint32_t u32MaxBatchSize = (m_ePacingMode == PACING_AS_FAST_AS_POSSIBLE) ? MAX_BATCH_SIZE : 1;
+
+    cRecord oRecord;
+    bool bRecordPending = oReader.getNextRecord(oRecord);
+
+    while(bRecordPending)
+    {
+        if(!pace(oRecord))
+            return false;
+
+        //Get (or wait for) free elements. The wait is interrupted as soon as receiving is stopped or shutdown is requested.
+        int32_t i32FirstIndex = -1;
+        uint32_t u32NElements = waitForFreeElements(i32FirstIndex, u32MaxBatchSize);
+
+        if(!u32NElements)
+            return false;
+
+        uint32_t u32NElementsFilled = 0;
+        uint64_t u64NBytes = 0;
+
+        while(u32NElementsFilled < u32NElements && bRecordPending)
+        {
+            uint32_t u32Index = (i32FirstIndex + u32NElementsFilled) % m_oBuffer.getNElements();
+            cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(u32Index);
+
+            memcpy(pElement->getDataPointer(), oRecord.m_cpData, oRecord.m_u32Size_B);
+            pElement->setDataAdded(oRecord.m_u32Size_B);
+            pElement->metadata() = oRecord.m_oMetadata; //As recorded
+
+            u32NElementsFilled++;
+            u64NBytes += oRecord.m_u32Size_B;
+
+            bRecordPending = oReader.getNextRecord(oRecord);
+        }
+
+        if(u32NElementsFilled)
+        {
+            elementsReceived(u32NElementsFilled);
+            addReceivedData(u32NElementsFilled, u64NBytes);
+            m_u64NPacketsReplayed.fetch_add(u32NElementsFilled, boost::memory_order_relaxed);
+        }
+    }
+
+    return true;
+}
+
+void cFileReplayReceiver::socketReceivingThreadFunction()
+{
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Entered cFileReplayReceiver::socketReceivingThreadFunction()";
+
+    m_bReplayFinished.store(false);
+    m_u64NPacketsReplayed.store(0);
+    m_u64NPacketsPaced = 0;
+    m_u64LastTimestamp_ns = 0;
+    m_u64ReplayStart_ns = getMonotonicTime_ns();
+
+    bool bStopped = false;
+
+    for(uint32_t u32LoopNo = 0; !bStopped && (!m_u32NLoops || u32LoopNo < m_u32NLoops); u32LoopNo++)
+    {
+        for(uint32_t u32FileNo = 0; u32FileNo < m_vstrFilenames.size(); u32FileNo++)
+        {
+            if(!replayFile(u32FileNo))
+            {
+                bStopped = true;
+                break;
+            }
+        }
+
+        //Nothing could be replayed. Do not spin when looping forever.
+        if(!bStopped && !m_u64NPacketsReplayed.load())
+            break;
+    }
+
+    m_bReplayFinished.store(!bStopped);
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cFileReplayReceiver::socketReceivingThreadFunction(): Exiting receiving thread. Replayed " << getNPacketsReplayed() << " packets.";
+}
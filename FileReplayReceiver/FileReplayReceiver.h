@@ -0,0 +1,116 @@
+#ifndef FILE_REPLAY_RECEIVER_H
+#define FILE_REPLAY_RECEIVER_H
+
+//System includes
+#include <string>
+#include <vector>
+
+//Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+
+//Local includes
+#include "../SocketReceiverBase.h"
+
+//Replays capture files written by cStreamRecorder through the same buffer and callback machinery as the socket receivers,
+//one packet per buffer element as with cUDPReceiver in datagram mode. Files are memory mapped and replayed in the order given,
+//optionally several times over. The buffer elements are sized for the largest packet in the files on construction. Files of
+//either format version are read, only version 2 records carry the source address and port.
+
+//Pacing:
+//PACING_ORIGINAL_TIMESTAMPS reproduces the recorded inter packet gaps, scaled by a speed factor (2.0 replays twice as fast).
+//PACING_FIXED_RATE replays at a fixed number of packets per second.
+//PACING_AS_FAST_AS_POSSIBLE only waits for free buffer elements and fills them in batches.
+
+class cFileReplayReceiver : public cSocketReceiverBase
+{
+public:
+    enum pacingMode
+    {
+        PACING_ORIGINAL_TIMESTAMPS = 0,
+        PACING_FIXED_RATE,
+        PACING_AS_FAST_AS_POSSIBLE
+    };
+
+    explicit cFileReplayReceiver(const std::string &strFilename);
+    explicit cFileReplayReceiver(const std::vector<std::string> &vstrFilenames); //E.g. the rolled files of one recording
+    virtual ~cFileReplayReceiver();
+
+    //Takes effect on the next call to startReceiving()
+    void                                                    setPacing(pacingMode ePacingMode, double dRate = 1.0); //Speed factor or packets per second
+    pacingMode                                              getPacingMode();
+    void                                                    setNLoops(uint32_t u32NLoops); //0 loops forever. Default 1.
+
+    bool                                                    isReplayFinished();
+    uint64_t                                                getNPacketsReplayed();
+
+protected:
+    std::vector<std::string>                                m_vstrFilenames;
+
+    //Largest packet in each file and the file size it was found at. A file is only scanned again if its size changed.
+    std::vector<uint32_t>                                   m_vu32LargestPacketSizes_B;
+    std::vector<uint64_t>                                   m_vu64ScannedFileSizes_B;
+
+    pacingMode                                              m_ePacingMode;
+    double                                                  m_dRate;
+    uint32_t                                                m_u32NLoops;
+
+    boost::atomic<bool>                                     m_bReplayFinished;
+    boost::atomic<uint64_t>                                 m_u64NPacketsReplayed;
+
+    //Pacing state (receiving thread)
+    uint64_t                                                m_u64ReplayStart_ns;
+    uint64_t                                                m_u64FirstTimestamp_ns;
+    uint64_t                                                m_u64LastTimestamp_ns;
+    uint64_t                                                m_u64NPacketsPaced;
+
+    //A packet in a mapped file
+    class cRecord
+    {
+    public:
+        const char*                                         m_cpData;
+        uint32_t                                            m_u32Size_B;
+        uint64_t                                            m_u64Timestamp_ns;
+        cPacketRingBuffer::cMetadata                        m_oMetadata; //Source address and port from version 2 files only
+    };
+
+    //Walks the records of one mapped capture file
+    class cRecordReader
+    {
+    public:
+        cRecordReader(const char *cpFile, uint64_t u64FileSize_B);
+
+        bool                                                isValid();
+        bool                                                getNextRecord(cRecord &oRecord);
+
+    private:
+        const char*                                         m_cpFile;
+        uint64_t                                            m_u64FileSize_B;
+        uint32_t                                            m_u32BlockSize_B;
+        uint32_t                                            m_u32RecordHeaderSize_B; //Depends on the file format version
+        uint64_t                                            m_u64BlockOffset_B;
+        uint32_t                                            m_u32BlockBytesUsed_B;
+        uint32_t                                            m_u32RecordOffset_B;
+        bool                                                m_bValid;
+
+        bool                                                loadBlock();
+    };
+
+    static uint64_t                                         getMonotonicTime_ns();
+    bool                                                    waitUntil(uint64_t u64Time_ns); //Returns false if receiving is stopped
+    bool                                                    pace(const cRecord &oRecord);
+
+    static bool                                             mapFile(const std::string &strFilename, boost::interprocess::mapped_region &oMappedRegion);
+    static uint32_t                                         getLargestPacketSize_B(const boost::interprocess::mapped_region &oMappedRegion);
+    uint32_t                                                getLargestPacketSize_B(uint32_t u32FileNo, const boost::interprocess::mapped_region &oMappedRegion); //Cached
+    void                                                    sizeBufferForFiles();
+
+    bool                                                    replayFile(uint32_t u32FileNo);
+
+    virtual void                                            socketReceivingThreadFunction();
+};
+
+#endif // FILE_REPLAY_RECEIVER_H
@@ -0,0 +1,265 @@
+//System includes
+#include <iostream>
+#include <cstring>
+
+//Local includes
+#include "Logger.h"
+
+using namespace std;
+
+cLogger::cEntry::cEntry() :
+    m_u64Sequence(0),
+    m_eSeverity(SEVERITY_INFO),
+    m_u32Length_B(0)
+{
+}
+
+cLogger::cRateLimitSlot::cRateLimitSlot() :
+    m_u64IntervalStart_ms(0),
+    m_u32NMessagesInInterval(0),
+    m_u32NMessagesSuppressed(0)
+{
+}
+
+cLogger& cLogger::getInstance()
+{
+    //Function local so that it is constructed on first use, also from other static initialisers.
+    static cLogger oLogger;
+
+    return oLogger;
+}
+
+cLogger::cLogger() :
+    m_u64EnqueuePosition(0),
+    m_u64DequeuePosition(0),
+    m_oClockReference(boost::posix_time::microsec_clock::universal_time()),
+    m_i32MinimumSeverity(SEVERITY_INFO),
+    m_u32RateLimitMaxNMessages(20),
+    m_u32RateLimitInterval_ms(1000),
+    m_u64NMessagesDropped(0),
+    m_u64NMessagesDroppedReported(0),
+    m_bShutdownFlag(false)
+{
+    for(uint32_t u32EntryNo = 0; u32EntryNo < QUEUE_LENGTH; u32EntryNo++)
+        m_aoEntries[u32EntryNo].m_u64Sequence.store(u32EntryNo, boost::memory_order_relaxed);
+
+    m_pWritingThread.reset(new boost::thread(&cLogger::writingThreadFunction, this));
+}
+
+cLogger::~cLogger()
+{
+    //The writing thread empties the queue before it returns
+    m_bShutdownFlag.store(true);
+    m_oMessageQueuedNotifier.notify();
+
+    m_pWritingThread->join();
+}
+
+void cLogger::setMinimumSeverity(severity eSeverity)
+{
+    m_i32MinimumSeverity.store(eSeverity, boost::memory_order_relaxed);
+}
+
+cLogger::severity cLogger::getMinimumSeverity()
+{
+    return (severity)m_i32MinimumSeverity.load(boost::memory_order_relaxed);
+}
+
+void cLogger::setRateLimit(uint32_t u32MaxNMessages, uint32_t u32Interval_ms)
+{
+    if(!u32Interval_ms)
+        u32Interval_ms = 1;
+
+    m_u32RateLimitMaxNMessages.store(u32MaxNMessages, boost::memory_order_relaxed);
+    m_u32RateLimitInterval_ms.store(u32Interval_ms, boost::memory_order_relaxed);
+}
+
+cLogger::cRateLimitSlot& cLogger::getRateLimitSlot(const char *cpFile, uint32_t u32Line)
+{
+    //__FILE__ is a string literal so its address identifies the file well enough
+    uint64_t u64Hash = (uint64_t)(size_t)cpFile * 31 + u32Line;
+    u64Hash ^= u64Hash >> 17;
+    u64Hash *= 0x9E3779B97F4A7C15ULL;
+    u64Hash ^= u64Hash >> 29;
+
+    return m_aoRateLimitSlots[u64Hash % N_RATE_LIMIT_SLOTS];
+}
+
+bool cLogger::shouldLog(severity eSeverity, const char *cpFile, uint32_t u32Line)
+{
+    if(eSeverity < m_i32MinimumSeverity.load(boost::memory_order_relaxed))
+        return false;
+
+    uint32_t u32MaxNMessages = m_u32RateLimitMaxNMessages.load(boost::memory_order_relaxed);
+
+    if(!u32MaxNMessages)
+        return true;
+
+    cRateLimitSlot &oSlot = getRateLimitSlot(cpFile, u32Line);
+
+    uint64_t u64Now_ms = (boost::posix_time::microsec_clock::universal_time() - m_oClockReference).total_milliseconds();
+    uint64_t u64IntervalStart_ms = oSlot.m_u64IntervalStart_ms.load(boost::memory_order_relaxed);
+
+    //Only the thread that wins the exchange starts the new interval and reports the previous one
+    if(u64Now_ms - u64IntervalStart_ms >= m_u32RateLimitInterval_ms.load(boost::memory_order_relaxed)
+            && oSlot.m_u64IntervalStart_ms.compare_exchange_strong(u64IntervalStart_ms, u64Now_ms, boost::memory_order_relaxed))
+    {
+        oSlot.m_u32NMessagesInInterval.store(0, boost::memory_order_relaxed);
+
+        uint32_t u32NMessagesSuppressed = oSlot.m_u32NMessagesSuppressed.exchange(0, boost::memory_order_relaxed);
+
+        if(u32NMessagesSuppressed)
+        {
+            ostringstream oMessage;
+            oMessage << "cLogger: Suppressed " << u32NMessagesSuppressed << " message(s) from " << cpFile << ":" << u32Line << ".";
+            submit(SEVERITY_WARNING, oMessage.str());
+        }
+    }
+
+    if(oSlot.m_u32NMessagesInInterval.fetch_add(1, boost::memory_order_relaxed) < u32MaxNMessages)
+        return true;
+
+    oSlot.m_u32NMessagesSuppressed.fetch_add(1, boost::memory_order_relaxed);
+
+    return false;
+}
+
+void cLogger::submit(severity eSeverity, const std::string &strMessage)
+{
+    uint64_t u64Position = m_u64EnqueuePosition.load(boost::memory_order_relaxed);
+    cEntry *pEntry;
+
+    //Claim an entry. Its sequence equals the position when it is free for this lap of the ring.
+    while(true)
+    {
+        pEntry = &m_aoEntries[u64Position % QUEUE_LENGTH];
+
+        int64_t i64Difference = (int64_t)(pEntry->m_u64Sequence.load(boost::memory_order_acquire) - u64Position);
+
+        if(i64Difference == 0)
+        {
+            if(m_u64EnqueuePosition.compare_exchange_weak(u64Position, u64Position + 1, boost::memory_order_relaxed))
+                break;
+        }
+        else if(i64Difference < 0)
+        {
+            //Queue is full. Drop rather than block the calling thread.
+            m_u64NMessagesDropped.fetch_add(1, boost::memory_order_relaxed);
+            return;
+        }
+        else
+        {
+            u64Position = m_u64EnqueuePosition.load(boost::memory_order_relaxed);
+        }
+    }
+
+    uint32_t u32Length_B = strMessage.size();
+    if(u32Length_B > MAX_MESSAGE_LENGTH_B)
+        u32Length_B = MAX_MESSAGE_LENGTH_B;
+
+    memcpy(pEntry->m_acMessage, strMessage.data(), u32Length_B);
+    pEntry->m_u32Length_B = u32Length_B;
+    pEntry->m_eSeverity = eSeverity;
+    pEntry->m_oTimestamp = boost::posix_time::microsec_clock::universal_time();
+
+    //Publish to the writer
+    pEntry->m_u64Sequence.store(u64Position + 1, boost::memory_order_release);
+
+    m_oMessageQueuedNotifier.notify();
+}
+
+uint64_t cLogger::getNMessagesDropped()
+{
+    return m_u64NMessagesDropped.load(boost::memory_order_relaxed);
+}
+
+const char* cLogger::getSeverityName(severity eSeverity)
+{
+    switch(eSeverity)
+    {
+    case SEVERITY_DEBUG:
+        return "DEBUG";
+    case SEVERITY_INFO:
+        return "INFO";
+    case SEVERITY_WARNING:
+        return "WARNING";
+    case SEVERITY_ERROR:
+        return "ERROR";
+    default:
+        return "UNKNOWN";
+    }
+}
+
+bool cLogger::writeNextMessage(std::ostream &oStream)
+{
+    cEntry &oEntry = m_aoEntries[m_u64DequeuePosition % QUEUE_LENGTH];
+
+    if(oEntry.m_u64Sequence.load(boost::memory_order_acquire) != m_u64DequeuePosition + 1)
+        return false;
+
+    oStream << boost::posix_time::to_simple_string(oEntry.m_oTimestamp) << " " << getSeverityName(oEntry.m_eSeverity) << " ";
+    oStream.write(oEntry.m_acMessage, oEntry.m_u32Length_B);
+    oStream << "\n";
+
+    //Hand the entry back to the producers for the next lap
+    oEntry.m_u64Sequence.store(m_u64DequeuePosition + QUEUE_LENGTH, boost::memory_order_release);
+    m_u64DequeuePosition++;
+
+    return true;
+}
+
+void cLogger::writingThreadFunction()
+{
+    while(true)
+    {
+        bool bWroteMessages = false;
+
+        while(writeNextMessage(cout))
+            bWroteMessages = true;
+
+        uint64_t u64NMessagesDropped = m_u64NMessagesDropped.load(boost::memory_order_relaxed);
+        if(u64NMessagesDropped != m_u64NMessagesDroppedReported)
+        {
+            cout << boost::posix_time::to_simple_string(boost::posix_time::microsec_clock::universal_time()) << " " << getSeverityName(SEVERITY_WARNING)
+                 << " cLogger: Log queue full, dropped " << u64NMessagesDropped - m_u64NMessagesDroppedReported << " message(s).\n";
+            m_u64NMessagesDroppedReported = u64NMessagesDropped;
+            bWroteMessages = true;
+        }
+
+        //One flush per batch of messages
+        if(bWroteMessages)
+            cout.flush();
+
+        uint64_t u64Epoch = m_oMessageQueuedNotifier.prepareWait();
+
+        //Check for messages queued since the last check before blocking
+        if(m_aoEntries[m_u64DequeuePosition % QUEUE_LENGTH].m_u64Sequence.load(boost::memory_order_acquire) == m_u64DequeuePosition + 1)
+        {
+            m_oMessageQueuedNotifier.cancelWait();
+            continue;
+        }
+
+        if(m_bShutdownFlag.load())
+        {
+            m_oMessageQueuedNotifier.cancelWait();
+            break;
+        }
+
+        m_oMessageQueuedNotifier.wait(u64Epoch);
+    }
+}
+
+cLogMessage::cLogMessage(cLogger::severity eSeverity) :
+    m_eSeverity(eSeverity)
+{
+}
+
+cLogMessage::~cLogMessage()
+{
+    cLogger::getInstance().submit(m_eSeverity, m_oStream.str());
+}
+
+std::ostream& cLogMessage::getStream()
+{
+    return m_oStream;
+}
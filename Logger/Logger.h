@@ -0,0 +1,153 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <string>
+#include <sstream>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#endif
+
+//Local includes
+#include "../EventNotifier/EventNotifier.h"
+
+//Asynchronous logging for the socket streamers. Messages are formatted by the calling thread, copied into a bounded lock free
+//queue and written to stdout by a background thread so that receiving, offloading and sending threads never block on the
+//console. If the queue is full the message is dropped and counted; the writer reports the count later.
+
+//Each call site is rate limited to a configurable number of messages per interval. Messages beyond that are not even
+//formatted. The number suppressed is reported once the next interval starts. Call sites are hashed into a fixed table so
+//distinct sites can occasionally share a limit.
+
+//Usage:
+//  AVN_LOG(cLogger::SEVERITY_WARNING) << "cClass::function(): Something happened: " << u32Value;
+//No endl is needed: the message ends with the statement.
+
+class cLogger
+{
+public:
+    enum severity
+    {
+        SEVERITY_DEBUG = 0,
+        SEVERITY_INFO,
+        SEVERITY_WARNING,
+        SEVERITY_ERROR
+    };
+
+    static cLogger&                                         getInstance();
+
+    ~cLogger();
+
+    void                                                    setMinimumSeverity(severity eSeverity);
+    severity                                                getMinimumSeverity();
+
+    //At most u32MaxNMessages per call site every u32Interval_ms. 0 messages disables rate limiting.
+    void                                                    setRateLimit(uint32_t u32MaxNMessages, uint32_t u32Interval_ms = 1000);
+
+    //Checks severity and the call site's rate limit. Used by AVN_LOG before the message is formatted.
+    bool                                                    shouldLog(severity eSeverity, const char *cpFile, uint32_t u32Line);
+
+    //Queues a formatted message. Never blocks.
+    void                                                    submit(severity eSeverity, const std::string &strMessage);
+
+    uint64_t                                                getNMessagesDropped(); //Queue full
+
+    static const char*                                      getSeverityName(severity eSeverity);
+
+private:
+    static const uint32_t                                   QUEUE_LENGTH = 1024;
+    static const uint32_t                                   MAX_MESSAGE_LENGTH_B = 512;
+    static const uint32_t                                   N_RATE_LIMIT_SLOTS = 256;
+    static const uint32_t                                   CACHE_LINE_SIZE_B = 64;
+
+    //Queue entry. The sequence number tells producers and the consumer whose turn it is (bounded MPSC queue).
+    class cEntry
+    {
+    public:
+        cEntry();
+
+        boost::atomic<uint64_t>                             m_u64Sequence;
+        severity                                            m_eSeverity;
+        boost::posix_time::ptime                            m_oTimestamp;
+        uint32_t                                            m_u32Length_B;
+        char                                                m_acMessage[MAX_MESSAGE_LENGTH_B];
+    };
+
+    class cRateLimitSlot
+    {
+    public:
+        cRateLimitSlot();
+
+        boost::atomic<uint64_t>                             m_u64IntervalStart_ms;
+        boost::atomic<uint32_t>                             m_u32NMessagesInInterval;
+        boost::atomic<uint32_t>                             m_u32NMessagesSuppressed;
+    };
+
+    cLogger();
+
+    cEntry                                                  m_aoEntries[QUEUE_LENGTH];
+    char                                                    m_acPadding0[CACHE_LINE_SIZE_B];
+    boost::atomic<uint64_t>                                 m_u64EnqueuePosition;
+    char                                                    m_acPadding1[CACHE_LINE_SIZE_B];
+    uint64_t                                                m_u64DequeuePosition; //Writer thread only
+
+    cRateLimitSlot                                          m_aoRateLimitSlots[N_RATE_LIMIT_SLOTS];
+    boost::posix_time::ptime                                m_oClockReference;
+
+    boost::atomic<int32_t>                                  m_i32MinimumSeverity;
+    boost::atomic<uint32_t>                                 m_u32RateLimitMaxNMessages;
+    boost::atomic<uint32_t>                                 m_u32RateLimitInterval_ms;
+
+    boost::atomic<uint64_t>                                 m_u64NMessagesDropped;
+    uint64_t                                                m_u64NMessagesDroppedReported; //Writer thread only
+
+    boost::atomic<bool>                                     m_bShutdownFlag;
+    cEventNotifier                                          m_oMessageQueuedNotifier;
+    boost::scoped_ptr<boost::thread>                        m_pWritingThread;
+
+    cRateLimitSlot&                                         getRateLimitSlot(const char *cpFile, uint32_t u32Line);
+
+    bool                                                    writeNextMessage(std::ostream &oStream);
+    void                                                    writingThreadFunction();
+};
+
+//Formats one message and submits it to the logger when it goes out of scope.
+class cLogMessage
+{
+public:
+    explicit cLogMessage(cLogger::severity eSeverity);
+    ~cLogMessage();
+
+    std::ostream&                                           getStream();
+
+private:
+    cLogger::severity                                       m_eSeverity;
+    std::ostringstream                                      m_oStream;
+};
+
+//A single pass loop rather than an if so that the macro can be used in an unbraced if / else without ambiguity.
+#define AVN_LOG(eSeverity) \
+    for(bool bAVNLogEnabled = cLogger::getInstance().shouldLog(eSeverity, __FILE__, __LINE__); bAVNLogEnabled; bAVNLogEnabled = false) \
+        cLogMessage(eSeverity).getStream()
+
+#endif // LOGGER_H
@@ -0,0 +1,134 @@
+//System includes
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+//Library includes
+
+//Local includes
+#include "MemorySlab.h"
+#include "../ThreadPlacement/ThreadPlacement.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+cMemorySlab::cMemorySlab(size_t szSize_B, bool bLock, bool bUseHugePages, int32_t i32NUMANode) :
+    m_cpMemory(NULL),
+    m_szSize_B(0),
+    m_szMappedSize_B(0),
+    m_bUsingHugePages(false),
+    m_bLocked(false)
+{
+    if(!szSize_B)
+        szSize_B = 1;
+
+#ifdef __linux__
+    //Explicit huge pages first. This fails unless huge pages have been reserved.
+#ifdef MAP_HUGETLB
+    if(bUseHugePages)
+    {
+        size_t szMappedSize_B = (szSize_B + HUGE_PAGE_SIZE_B - 1) / HUGE_PAGE_SIZE_B * HUGE_PAGE_SIZE_B;
+
+        void *pMemory = mmap(NULL, szMappedSize_B, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if(pMemory != MAP_FAILED)
+        {
+            m_cpMemory = (char*)pMemory;
+            m_szMappedSize_B = szMappedSize_B;
+            m_bUsingHugePages = true;
+        }
+    }
+#endif
+
+    if(!m_cpMemory)
+    {
+        size_t szPageSize_B = sysconf(_SC_PAGESIZE);
+        size_t szMappedSize_B = (szSize_B + szPageSize_B - 1) / szPageSize_B * szPageSize_B;
+
+        void *pMemory = mmap(NULL, szMappedSize_B, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+        if(pMemory != MAP_FAILED)
+        {
+            m_cpMemory = (char*)pMemory;
+            m_szMappedSize_B = szMappedSize_B;
+
+#ifdef MADV_HUGEPAGE
+            //Ask for transparent huge pages instead. Only a hint.
+            if(bUseHugePages)
+                madvise(pMemory, szMappedSize_B, MADV_HUGEPAGE);
+#endif
+        }
+        else
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cMemorySlab::cMemorySlab(): Warning: Unable to map " << szMappedSize_B << " bytes: " << strerror(errno) << ". Using heap memory.";
+        }
+    }
+
+    if(m_cpMemory)
+    {
+        m_szSize_B = m_szMappedSize_B;
+
+        //Place the pages before they are first touched (by mlock() or the first write)
+        if(i32NUMANode >= 0)
+            cThreadPlacement::bindMemoryToNUMANode(m_cpMemory, m_szMappedSize_B, i32NUMANode);
+
+        if(bLock)
+        {
+            if(mlock(m_cpMemory, m_szMappedSize_B))
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cMemorySlab::cMemorySlab(): Warning: Unable to lock " << m_szMappedSize_B << " bytes in RAM: " << strerror(errno)
+                                                   << ". Check RLIMIT_MEMLOCK. Continuing unlocked.";
+            else
+                m_bLocked = true;
+        }
+
+        return;
+    }
+#endif
+
+    //Heap fallback. Over allocate so the start can be aligned.
+    m_vcHeapMemory.resize(szSize_B + ALIGNMENT_B);
+
+    size_t szOffset = (ALIGNMENT_B - ((size_t)&m_vcHeapMemory.front() % ALIGNMENT_B)) % ALIGNMENT_B;
+
+    m_cpMemory = &m_vcHeapMemory.front() + szOffset;
+    m_szSize_B = szSize_B;
+
+    //Heap memory shares its pages with other allocations so it is left where it is first touched
+    if(i32NUMANode >= 0)
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cMemorySlab::cMemorySlab(): Warning: Heap memory is not bound to NUMA node " << i32NUMANode << ".";
+}
+
+cMemorySlab::~cMemorySlab()
+{
+#ifdef __linux__
+    if(m_szMappedSize_B)
+    {
+        //munmap() also drops the lock
+        munmap(m_cpMemory, m_szMappedSize_B);
+    }
+#endif
+}
+
+char* cMemorySlab::getPointer()
+{
+    return m_cpMemory;
+}
+
+size_t cMemorySlab::getSize_B() const
+{
+    return m_szSize_B;
+}
+
+bool cMemorySlab::isUsingHugePages() const
+{
+    return m_bUsingHugePages;
+}
+
+bool cMemorySlab::isLocked() const
+{
+    return m_bLocked;
+}
@@ -0,0 +1,65 @@
+#ifndef MEMORY_SLAB_H
+#define MEMORY_SLAB_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <vector>
+#include <cstddef>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/noncopyable.hpp>
+#endif
+
+//Local includes
+
+//One contiguous block of memory for a whole buffer rather than many small heap allocations.
+
+//On Linux the slab is mapped anonymously. It is backed by explicit 2 MiB huge pages if the system has them reserved
+//(vm.nr_hugepages), otherwise by normal pages with transparent huge pages requested. It can be bound to a NUMA node before
+//any page is touched and locked into RAM with mlock() so that bursts do not page fault. Locking needs a sufficient
+//RLIMIT_MEMLOCK (or CAP_IPC_LOCK); if it fails the slab is used unlocked and a warning is logged.
+
+//Elsewhere the slab is a plain heap allocation aligned to ALIGNMENT_B.
+
+class cMemorySlab : private boost::noncopyable
+{
+public:
+    static const uint32_t                                   ALIGNMENT_B = 64; //Cache line
+    static const size_t                                     HUGE_PAGE_SIZE_B = 2 * 1024 * 1024;
+
+    cMemorySlab(size_t szSize_B, bool bLock = true, bool bUseHugePages = true, int32_t i32NUMANode = -1);
+    ~cMemorySlab();
+
+    char*                                                   getPointer();
+    size_t                                                  getSize_B() const; //Usable size, may be larger than requested
+
+    bool                                                    isUsingHugePages() const;
+    bool                                                    isLocked() const;
+
+private:
+    char*                                                   m_cpMemory;
+    size_t                                                  m_szSize_B;
+    size_t                                                  m_szMappedSize_B; //0 if not mapped
+
+    bool                                                    m_bUsingHugePages;
+    bool                                                    m_bLocked;
+
+    std::vector<char>                                       m_vcHeapMemory; //Fallback when mapping is not available
+};
+
+#endif // MEMORY_SLAB_H
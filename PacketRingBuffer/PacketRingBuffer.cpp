@@ -0,0 +1,1013 @@
+//System includes
+#include <cstring>
+#include <sstream>
+
+#ifdef __linux__
+#include <time.h>
+#endif
+
+//Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/thread_time.hpp>
+#endif
+
+//Local includes
+#include "PacketRingBuffer.h"
+#include "../ThreadPlacement/ThreadPlacement.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+namespace
+{
+    //Number of times the lock free backend polls the buffer (spinning, then yielding) before blocking on the notifier
+    const uint32_t SPIN_ATTEMPTS = 256;
+    const uint32_t YIELD_ATTEMPTS = 512;
+
+    //Polls between checks of the clock and abort condition when spinning for a set time
+    const uint32_t SPIN_CHECK_INTERVAL = 64;
+
+    inline void cpuRelax()
+    {
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+        __builtin_ia32_pause();
+#endif
+    }
+
+    uint64_t getMonotonicTime_ns()
+    {
+#ifdef __linux__
+        timespec sTime;
+        clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+        return (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec;
+#else
+        static const boost::posix_time::ptime oEpoch(boost::gregorian::date(1970, 1, 1));
+
+        return (boost::posix_time::microsec_clock::universal_time() - oEpoch).total_microseconds() * 1000ULL;
+#endif
+    }
+}
+
+cPacketRingBuffer::cMetadata::cMetadata()
+{
+    clear();
+}
+
+void cPacketRingBuffer::cMetadata::clear()
+{
+    memset(m_au8SourceAddress, 0, sizeof(m_au8SourceAddress));
+    m_u8AddressFamily = 0;
+    m_bKernelTimestamp = false;
+    m_u16SourcePort = 0;
+    m_u32PayloadSize_B = 0;
+    m_i64ReceiveTime_ns = 0;
+}
+
+string cPacketRingBuffer::cMetadata::getSourceAddressString() const
+{
+    stringstream oSS;
+
+    if(m_u8AddressFamily == 4)
+    {
+        oSS << (uint32_t)m_au8SourceAddress[0] << "." << (uint32_t)m_au8SourceAddress[1] << "." << (uint32_t)m_au8SourceAddress[2] << "." << (uint32_t)m_au8SourceAddress[3];
+    }
+    else if(m_u8AddressFamily == 6)
+    {
+        //Uncompressed form
+        oSS << hex;
+
+        for(uint32_t ui = 0; ui < 16; ui += 2)
+        {
+            if(ui)
+                oSS << ":";
+
+            oSS << ((uint32_t)m_au8SourceAddress[ui] << 8 | m_au8SourceAddress[ui + 1]);
+        }
+    }
+
+    return oSS.str();
+}
+
+cPacketRingBuffer::cElement::cElement() :
+    m_cpAssignedData(NULL),
+    m_u32AssignedSize_B(0),
+    m_u32DataSize_B(0)
+{
+}
+
+void cPacketRingBuffer::cElement::allocate(uint32_t u32Size_B)
+{
+    m_cpAssignedData = NULL;
+    m_u32AssignedSize_B = 0;
+
+    m_vcData.resize(u32Size_B);
+    m_u32DataSize_B = 0;
+}
+
+void cPacketRingBuffer::cElement::assign(char *cpMemory, uint32_t u32Size_B)
+{
+    //Release any heap memory held
+    std::vector<char>().swap(m_vcData);
+
+    m_cpAssignedData = cpMemory;
+    m_u32AssignedSize_B = u32Size_B;
+    m_u32DataSize_B = 0;
+}
+
+char* cPacketRingBuffer::cElement::getDataPointer()
+{
+    if(m_cpAssignedData)
+        return m_cpAssignedData;
+
+    return &m_vcData.front();
+}
+
+uint32_t cPacketRingBuffer::cElement::allocationSize() const
+{
+    if(m_cpAssignedData)
+        return m_u32AssignedSize_B;
+
+    return (uint32_t)m_vcData.size();
+}
+
+uint32_t cPacketRingBuffer::cElement::dataSize() const
+{
+    return m_u32DataSize_B;
+}
+
+void cPacketRingBuffer::cElement::setDataAdded(uint32_t u32Size_B)
+{
+    m_u32DataSize_B += u32Size_B;
+}
+
+void cPacketRingBuffer::cElement::clearData()
+{
+    m_u32DataSize_B = 0;
+}
+
+cPacketRingBuffer::cMetadata& cPacketRingBuffer::cElement::metadata()
+{
+    return m_oMetadata;
+}
+
+cPacketRingBuffer::cReadCursor::cReadCursor() :
+    m_bActive(false),
+    m_u64Position(0),
+    m_u64ReadersWritePosition(0)
+{
+}
+
+cPacketRingBuffer::cPacketRingBuffer(uint32_t u32NElements, uint32_t u32ElementSize_B, backend eBackend) :
+    m_ppElementTable(NULL),
+    m_u32NElements(0),
+    m_u64Geometry(0),
+    m_u32ElementSize_B(0),
+    m_i32NUMANode(-1),
+    m_eAllocationMode(ALLOCATION_HEAP),
+    m_u32SlabStride_B(0),
+    m_bStorageRetired(false),
+    m_bResizePending(false),
+    m_u32PendingNElements(0),
+    m_u32PendingElementSize_B(0),
+    m_eBackend(eBackend),
+    m_u32SpinTime_us(0),
+    m_u64WritePosition(0),
+    m_u64WritersReadPosition(0),
+    m_u32NReadCursorSlotsUsed(1)
+{
+    m_aoReadCursors[PRIMARY_READ_CURSOR].m_bActive.store(true);
+
+    resize(u32NElements, u32ElementSize_B);
+}
+
+void cPacketRingBuffer::resize(uint32_t u32NElements, uint32_t u32ElementSize_B)
+{
+    //Note: Resizing discards all data in the buffer
+
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        reallocateElements(u32NElements, u32ElementSize_B);
+
+        m_u64Geometry.store((uint64_t)m_u32NElements.load() << 32);
+        m_bResizePending.store(false);
+    }
+
+    clear();
+}
+
+void cPacketRingBuffer::requestResize(uint32_t u32NElements, uint32_t u32ElementSize_B)
+{
+    if(!u32NElements)
+        u32NElements = 1;
+
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    //Merge with a request still pending, e.g. growing the elements for a large packet must not undo a change of the count
+    if(m_bResizePending.load())
+    {
+        if(u32NElements == m_u32NElements.load())
+            u32NElements = m_u32PendingNElements;
+
+        if(u32ElementSize_B == m_u32ElementSize_B.load())
+            u32ElementSize_B = m_u32PendingElementSize_B;
+    }
+
+    //Larger elements can be handed out straight away: free elements belong to the writer so it grows them as it gets them
+    //(see prepareElementsForWriting()). Elements still holding data keep their size until they are free again.
+    if(!m_bResizePending.load() && u32NElements == m_u32NElements.load() && u32ElementSize_B >= m_u32ElementSize_B.load())
+    {
+        m_u32ElementSize_B.store(u32ElementSize_B);
+
+        //Heap allocated elements are simply grown one by one. A slab is replaced in one piece.
+        if(m_eAllocationMode != ALLOCATION_LOCKED_SLAB)
+            return;
+    }
+
+    m_u32PendingNElements = u32NElements;
+    m_u32PendingElementSize_B = u32ElementSize_B;
+    m_bResizePending.store(true, boost::memory_order_release);
+}
+
+bool cPacketRingBuffer::isResizePending()
+{
+    return m_bResizePending.load(boost::memory_order_acquire);
+}
+
+bool cPacketRingBuffer::prepareElementsForWriting(uint32_t u32FirstIndex, uint32_t u32NElements)
+{
+    //Called on the writer's side only with elements that no reader can hold. Returns false if the buffer was resized in which
+    //case the indices are no longer valid.
+
+    if(m_bResizePending.load(boost::memory_order_acquire))
+    {
+        //Only take the lock if the queued elements do not wrap around the end of the ring (see applyPendingResize())
+        uint64_t u64ReadPosition = getOldestReadPosition();
+        uint32_t u32NQueued = (uint32_t)(m_u64WritePosition.load(boost::memory_order_relaxed) - u64ReadPosition);
+
+        if(!u32NQueued || getIndex(u64ReadPosition) + u32NQueued <= m_u32NElements.load(boost::memory_order_relaxed))
+        {
+            boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+            if(m_bResizePending.load() && applyPendingResize())
+                return false;
+        }
+    }
+
+    //Once nobody can hold on to them any more free the tables and slabs left over from resizing with data queued
+    if(m_bStorageRetired.load(boost::memory_order_relaxed) && !getLevel())
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        //Check again: with the locking backend readers update their positions under the mutex
+        if(!getLevel())
+            releaseRetiredStorage();
+    }
+
+    uint32_t u32ElementSize_B = m_u32ElementSize_B.load(boost::memory_order_relaxed);
+    uint32_t u32NBufferElements = m_u32NElements.load(boost::memory_order_relaxed);
+
+    for(uint32_t ui = 0; ui < u32NElements; ui++)
+    {
+        prepareElement((u32FirstIndex + ui) % u32NBufferElements, u32ElementSize_B);
+    }
+
+    return true;
+}
+
+void cPacketRingBuffer::prepareElement(uint32_t u32Index, uint32_t u32ElementSize_B, bool bReplaceMemory)
+{
+    cElement &oElement = *getElementPointer(u32Index);
+
+    //Slab elements live at their index in the current slab. Elements that were queued while it replaced another slab are
+    //moved to it here. Elements grown beyond the slab's stride are heap allocated until the slab is replaced.
+    if(m_pSlab.get() && u32ElementSize_B <= m_u32SlabStride_B)
+    {
+        char *cpSlot = m_pSlab->getPointer() + (size_t)m_u32SlabStride_B * u32Index;
+
+        if(bReplaceMemory || oElement.getDataPointer() != cpSlot || oElement.allocationSize() < u32ElementSize_B)
+            oElement.assign(cpSlot, u32ElementSize_B);
+
+        return;
+    }
+
+    if(!bReplaceMemory && oElement.allocationSize() >= u32ElementSize_B)
+        return;
+
+    oElement.allocate(u32ElementSize_B);
+}
+
+bool cPacketRingBuffer::applyPendingResize()
+{
+    //Called by the writer with m_oMutex held. Returns true if the geometry was changed.
+
+    //Clear what the readers have finished with. The oldest read position is the start of the queued elements from now on.
+    updateWritersReadPosition();
+
+    uint64_t u64ReadPosition = m_u64WritersReadPosition;
+    uint32_t u32NQueued = (uint32_t)(m_u64WritePosition.load() - u64ReadPosition);
+    uint32_t u32OldNElements = m_u32NElements.load();
+    uint32_t u32NElements = m_u32PendingNElements;
+    uint32_t u32FirstQueuedIndex = u32NQueued ? getIndex(u64ReadPosition) : 0;
+
+    //Queued elements keep their indices (and element objects) so that readers can carry on with the indices they have. That
+    //only works if they do not wrap around the end of the ring in either size. Otherwise try again on the next write; the
+    //readers move the queued elements on in the mean time.
+    if(u32FirstQueuedIndex + u32NQueued > u32OldNElements || u32FirstQueuedIndex + u32NQueued > u32NElements)
+        return false;
+
+    reallocateElements(u32NElements, m_u32PendingElementSize_B, u32FirstQueuedIndex, u32NQueued);
+
+    //Offset the positions so that the oldest queued position still maps to its index
+    uint32_t u32Offset = (uint32_t)((u32FirstQueuedIndex + u32NElements - u64ReadPosition % u32NElements) % u32NElements);
+
+    m_u64Geometry.store(((uint64_t)u32NElements << 32) | u32Offset, boost::memory_order_release);
+    m_bResizePending.store(false);
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cPacketRingBuffer::applyPendingResize(): Resized buffer from " << u32OldNElements << " to "
+                                    << m_u32NElements.load() << " elements of " << m_u32ElementSize_B.load() << " bytes with " << u32NQueued << " elements queued.";
+
+    return true;
+}
+
+void cPacketRingBuffer::releaseRetiredStorage()
+{
+    //Called by the writer with m_oMutex held while the buffer is empty, i.e. no reader holds an element
+
+    //Free elements may still use memory of a retired slab
+    for(uint32_t u32Slab = 0; u32Slab < m_vpRetiredSlabs.size(); u32Slab++)
+    {
+        const char *cpSlab = m_vpRetiredSlabs[u32Slab]->getPointer();
+
+        for(uint32_t ui = 0; ui < m_vpElements.size(); ui++)
+        {
+            const char *cpData = m_vpElements[ui]->getDataPointer();
+
+            if(cpData < cpSlab || cpData >= cpSlab + m_vpRetiredSlabs[u32Slab]->getSize_B())
+                continue;
+
+            prepareElement(ui, m_u32ElementSize_B.load(), true);
+        }
+    }
+
+    m_vvpRetiredElementTables.clear();
+    m_vpRetiredSlabs.clear();
+
+    m_bStorageRetired.store(false);
+}
+
+void cPacketRingBuffer::reallocateElements(uint32_t u32NElements, uint32_t u32ElementSize_B, uint32_t u32FirstKeptIndex, uint32_t u32NKept)
+{
+    //Call with m_oMutex held. The positions are left alone.
+
+    if(!u32NElements)
+        u32NElements = 1;
+
+    //Build a new table. It shares the element objects with the current one so that kept elements stay where they are.
+    vector<boost::shared_ptr<cElement> > vpElements(u32NElements);
+
+    for(uint32_t ui = 0; ui < u32NElements; ui++)
+    {
+        if(ui < m_vpElements.size())
+            vpElements[ui] = m_vpElements[ui];
+        else
+            vpElements[ui].reset(new cElement);
+    }
+
+    //Readers may still be indexing the current table or using the memory of kept elements if there are any
+    boost::shared_ptr<cMemorySlab> pOldSlab = m_pSlab;
+    m_pSlab.reset();
+
+    if(u32NKept)
+    {
+        m_vvpRetiredElementTables.push_back(vector<boost::shared_ptr<cElement> >());
+        m_vvpRetiredElementTables.back().swap(m_vpElements);
+
+        if(pOldSlab.get())
+            m_vpRetiredSlabs.push_back(pOldSlab);
+
+        m_bStorageRetired.store(true);
+    }
+    else
+    {
+        m_vvpRetiredElementTables.clear();
+        m_vpRetiredSlabs.clear();
+        m_bStorageRetired.store(false);
+    }
+
+    m_vpElements.swap(vpElements);
+
+    //Free the old slab before allocating the new one
+    pOldSlab.reset();
+
+    if(m_eAllocationMode == ALLOCATION_LOCKED_SLAB)
+    {
+        //Every element starts on a cache line
+        uint32_t u32Stride_B = (u32ElementSize_B + CACHE_LINE_SIZE_B - 1) / CACHE_LINE_SIZE_B * CACHE_LINE_SIZE_B;
+        if(!u32Stride_B)
+            u32Stride_B = CACHE_LINE_SIZE_B;
+
+        //Pages are bound to the NUMA node (if any) by the slab before they are touched
+        m_pSlab.reset(new cMemorySlab((size_t)u32Stride_B * u32NElements, true, true, m_i32NUMANode));
+        m_u32SlabStride_B = u32Stride_B;
+
+        //Kept elements are moved to the slab once they are free (see prepareElementsForWriting())
+        for(uint32_t ui = 0; ui < m_vpElements.size(); ui++)
+        {
+            if(ui - u32FirstKeptIndex < u32NKept)
+                continue;
+
+            m_vpElements[ui]->assign(m_pSlab->getPointer() + (size_t)u32Stride_B * ui, u32ElementSize_B);
+        }
+    }
+    else
+    {
+        for(uint32_t ui = 0; ui < m_vpElements.size(); ui++)
+        {
+            if(ui - u32FirstKeptIndex < u32NKept)
+                continue;
+
+            m_vpElements[ui]->allocate(u32ElementSize_B);
+        }
+
+        bindElementsToNUMANode();
+    }
+
+    m_ppElementTable.store(&m_vpElements.front(), boost::memory_order_release);
+    m_u32NElements.store(u32NElements);
+    m_u32ElementSize_B.store(u32ElementSize_B);
+}
+
+void cPacketRingBuffer::bindToNUMANode(int32_t i32Node)
+{
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    m_i32NUMANode = i32Node;
+
+    bindElementsToNUMANode();
+}
+
+int32_t cPacketRingBuffer::getNUMANode()
+{
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    return m_i32NUMANode;
+}
+
+void cPacketRingBuffer::setAllocationMode(allocationMode eMode)
+{
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        if(eMode == m_eAllocationMode)
+            return;
+
+        m_eAllocationMode = eMode;
+    }
+
+    resize(getNElements(), getElementSize_B());
+}
+
+cPacketRingBuffer::allocationMode cPacketRingBuffer::getAllocationMode()
+{
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    return m_eAllocationMode;
+}
+
+void cPacketRingBuffer::bindElementsToNUMANode()
+{
+    if(m_i32NUMANode < 0)
+        return;
+
+    if(m_pSlab.get())
+    {
+        cThreadPlacement::bindMemoryToNUMANode(m_pSlab->getPointer(), m_pSlab->getSize_B(), m_i32NUMANode);
+        return;
+    }
+
+    //Heap elements share their pages with other allocations so they are left where they were first touched
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cPacketRingBuffer::bindElementsToNUMANode(): Warning: Heap allocated elements are not bound to NUMA node "
+                                       << m_i32NUMANode << ". Use the locked slab allocation mode for NUMA binding.";
+}
+
+void cPacketRingBuffer::clear()
+{
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        for(uint32_t ui = 0; ui < m_vpElements.size(); ui++)
+        {
+            m_vpElements[ui]->clearData();
+        }
+
+        //Discard the queued elements by moving every cursor to the write position. Positions only ever move forward so that
+        //no cursor can end up ahead of the write position.
+        uint64_t u64WritePosition = m_u64WritePosition.load();
+
+        m_u64Geometry.store((uint64_t)m_u32NElements.load() << 32);
+        m_u64WritersReadPosition = u64WritePosition;
+
+        for(uint32_t ui = 0; ui < MAX_READ_CURSORS; ui++)
+        {
+            m_aoReadCursors[ui].m_u64Position.store(u64WritePosition);
+            m_aoReadCursors[ui].m_u64ReadersWritePosition = u64WritePosition;
+        }
+    }
+
+    m_oSpaceAvailableNotifier.notify();
+}
+
+void cPacketRingBuffer::setBackend(backend eBackend)
+{
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    m_eBackend = eBackend;
+}
+
+cPacketRingBuffer::backend cPacketRingBuffer::getBackend()
+{
+    return m_eBackend;
+}
+
+void cPacketRingBuffer::setSpinTime(uint32_t u32SpinTime_us)
+{
+    m_u32SpinTime_us.store(u32SpinTime_us);
+}
+
+uint32_t cPacketRingBuffer::getSpinTime_us()
+{
+    return m_u32SpinTime_us.load();
+}
+
+int32_t cPacketRingBuffer::getNextWriteIndex(uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    int32_t i32Index = -1;
+
+    if(!getNextWriteIndices(i32Index, 1, u32Timeout_ms, fAbort))
+        return -1;
+
+    return i32Index;
+}
+
+int32_t cPacketRingBuffer::tryToGetNextWriteIndex()
+{
+    uint32_t u32Index;
+
+    do
+    {
+        if(!getNFreeElements())
+            return -1;
+
+        u32Index = getIndex(m_u64WritePosition.load(boost::memory_order_relaxed));
+    }
+    while(!prepareElementsForWriting(u32Index, 1));
+
+    return u32Index;
+}
+
+uint32_t cPacketRingBuffer::getNextWriteIndices(int32_t &i32FirstIndex, uint32_t u32MaxNElements, uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    //Wait for at least one free element and return the number of consecutive free elements (up to u32MaxNElements)
+    //starting at i32FirstIndex. Index n of the batch is (i32FirstIndex + n) % getNElements().
+
+    while(true)
+    {
+        uint32_t u32NFree = waitForElements(true, 0, u32Timeout_ms, fAbort);
+
+        if(!u32NFree)
+        {
+            i32FirstIndex = -1;
+            return 0;
+        }
+
+        i32FirstIndex = getIndex(m_u64WritePosition.load(boost::memory_order_relaxed));
+
+        if(u32MaxNElements < u32NFree)
+            u32NFree = u32MaxNElements;
+
+        //Otherwise the buffer was resized and the free elements have to be found again
+        if(prepareElementsForWriting(i32FirstIndex, u32NFree))
+            return u32NFree;
+    }
+}
+
+void cPacketRingBuffer::elementWritten()
+{
+    elementsWritten(1);
+}
+
+void cPacketRingBuffer::elementsWritten(uint32_t u32NElements)
+{
+    if(m_eBackend == BACKEND_LOCK_FREE_SPSC)
+    {
+        //Publish the element contents along with the new position
+        m_u64WritePosition.store(m_u64WritePosition.load(boost::memory_order_relaxed) + u32NElements, boost::memory_order_release);
+    }
+    else
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        m_u64WritePosition.store(m_u64WritePosition.load() + u32NElements);
+    }
+
+    m_oDataAvailableNotifier.notify();
+}
+
+void cPacketRingBuffer::growElement(uint32_t u32Index, uint32_t u32Size_B)
+{
+    cElement &oElement = *getElementPointer(u32Index);
+
+    if(oElement.allocationSize() >= u32Size_B)
+        return;
+
+    //Moves a slab element onto the heap. It is put back into the slab once it is written to again (see prepareElement()).
+    vector<char> vcData(oElement.getDataPointer(), oElement.getDataPointer() + oElement.dataSize());
+
+    oElement.allocate(u32Size_B);
+
+    if(vcData.size())
+    {
+        memcpy(oElement.getDataPointer(), &vcData.front(), vcData.size());
+        oElement.setDataAdded(vcData.size());
+    }
+}
+
+int32_t cPacketRingBuffer::getNextReadIndex(uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    return getNextReadIndexForCursor(PRIMARY_READ_CURSOR, u32Timeout_ms, fAbort);
+}
+
+int32_t cPacketRingBuffer::tryToGetNextReadIndex()
+{
+    if(!getNAvailableElements(PRIMARY_READ_CURSOR))
+        return -1;
+
+    return getIndex(m_aoReadCursors[PRIMARY_READ_CURSOR].m_u64Position.load(boost::memory_order_relaxed));
+}
+
+uint32_t cPacketRingBuffer::tryToGetNextReadIndices(int32_t &i32FirstIndex, uint32_t u32MaxNElements)
+{
+    //As getNextReadIndices() but returns 0 immediately if no data is available
+
+    uint32_t u32NAvailable = getNAvailableElements(PRIMARY_READ_CURSOR);
+
+    if(!u32NAvailable)
+    {
+        i32FirstIndex = -1;
+        return 0;
+    }
+
+    i32FirstIndex = getIndex(m_aoReadCursors[PRIMARY_READ_CURSOR].m_u64Position.load(boost::memory_order_relaxed));
+
+    if(u32MaxNElements < u32NAvailable)
+        return u32MaxNElements;
+
+    return u32NAvailable;
+}
+
+uint32_t cPacketRingBuffer::getNextReadIndices(int32_t &i32FirstIndex, uint32_t u32MaxNElements, uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    return getNextReadIndicesForCursor(PRIMARY_READ_CURSOR, i32FirstIndex, u32MaxNElements, u32Timeout_ms, fAbort);
+}
+
+void cPacketRingBuffer::elementRead()
+{
+    elementsReadForCursor(PRIMARY_READ_CURSOR, 1);
+}
+
+void cPacketRingBuffer::elementsRead(uint32_t u32NElements)
+{
+    elementsReadForCursor(PRIMARY_READ_CURSOR, u32NElements);
+}
+
+int32_t cPacketRingBuffer::addReadCursor(bool bFromOldest)
+{
+    uint32_t u32Cursor = PRIMARY_READ_CURSOR + 1;
+
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        while(u32Cursor < MAX_READ_CURSORS && m_aoReadCursors[u32Cursor].m_bActive.load())
+            u32Cursor++;
+
+        if(u32Cursor == MAX_READ_CURSORS)
+            return -1;
+
+        //Reserve the slot
+        m_aoReadCursors[u32Cursor].m_bActive.store(true);
+        m_aoReadCursors[u32Cursor].m_u64Position.store(m_u64WritePosition.load());
+    }
+
+    activateReadCursor(u32Cursor, bFromOldest);
+
+    return u32Cursor;
+}
+
+void cPacketRingBuffer::activateReadCursor(uint32_t u32Cursor, bool bFromOldest)
+{
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    cReadCursor &oCursor = m_aoReadCursors[u32Cursor];
+
+    //Starting at the write position is always safe. Starting at the oldest element held by another cursor is safe as long as
+    //that cursor does not move on before the writer sees the new one, so re-check once this cursor is visible to the writer.
+    uint64_t u64Position = bFromOldest ? getOldestReadPosition(u32Cursor) : m_u64WritePosition.load();
+
+    oCursor.m_u64Position.store(u64Position);
+    oCursor.m_u64ReadersWritePosition = u64Position;
+    oCursor.m_bActive.store(true);
+
+    if(u32Cursor >= m_u32NReadCursorSlotsUsed.load())
+        m_u32NReadCursorSlotsUsed.store(u32Cursor + 1);
+
+    if(bFromOldest)
+    {
+        uint64_t u64OldestPosition = getOldestReadPosition(u32Cursor);
+
+        if(u64OldestPosition > u64Position)
+        {
+            oCursor.m_u64Position.store(u64OldestPosition);
+            oCursor.m_u64ReadersWritePosition = u64OldestPosition;
+        }
+    }
+}
+
+void cPacketRingBuffer::deactivateReadCursor(uint32_t u32Cursor)
+{
+    m_aoReadCursors[u32Cursor].m_bActive.store(false);
+
+    //The writer may now be able to continue
+    m_oSpaceAvailableNotifier.notify();
+}
+
+bool cPacketRingBuffer::isReadCursorActive(uint32_t u32Cursor)
+{
+    return m_aoReadCursors[u32Cursor].m_bActive.load();
+}
+
+int32_t cPacketRingBuffer::getNextReadIndexForCursor(uint32_t u32Cursor, uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    int32_t i32Index = -1;
+
+    if(!getNextReadIndicesForCursor(u32Cursor, i32Index, 1, u32Timeout_ms, fAbort))
+        return -1;
+
+    return i32Index;
+}
+
+uint32_t cPacketRingBuffer::getNextReadIndicesForCursor(uint32_t u32Cursor, int32_t &i32FirstIndex, uint32_t u32MaxNElements, uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    //Wait for at least one element of data and return the number of consecutive elements available (up to u32MaxNElements)
+    //starting at i32FirstIndex. Index n of the batch is (i32FirstIndex + n) % getNElements().
+
+    uint32_t u32NAvailable = waitForElements(false, u32Cursor, u32Timeout_ms, fAbort);
+
+    if(!u32NAvailable)
+    {
+        i32FirstIndex = -1;
+        return 0;
+    }
+
+    i32FirstIndex = getIndex(m_aoReadCursors[u32Cursor].m_u64Position.load(boost::memory_order_relaxed));
+
+    if(u32MaxNElements < u32NAvailable)
+        return u32MaxNElements;
+
+    return u32NAvailable;
+}
+
+void cPacketRingBuffer::elementsReadForCursor(uint32_t u32Cursor, uint32_t u32NElements)
+{
+    cReadCursor &oCursor = m_aoReadCursors[u32Cursor];
+
+    if(m_eBackend == BACKEND_LOCK_FREE_SPSC)
+    {
+        //Hand the elements back to the writer (once all other cursors are also done with them)
+        oCursor.m_u64Position.store(oCursor.m_u64Position.load(boost::memory_order_relaxed) + u32NElements, boost::memory_order_release);
+    }
+    else
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+        oCursor.m_u64Position.store(oCursor.m_u64Position.load() + u32NElements);
+    }
+
+    m_oSpaceAvailableNotifier.notify();
+}
+
+char* cPacketRingBuffer::getElementDataPointer(uint32_t u32Index)
+{
+    return getElementPointer(u32Index)->getDataPointer();
+}
+
+cPacketRingBuffer::cElement* cPacketRingBuffer::getElementPointer(uint32_t u32Index)
+{
+    //The table may be replaced by a resize at any time. Elements held keep their index in the new table.
+    return m_ppElementTable.load(boost::memory_order_acquire)[u32Index].get();
+}
+
+uint32_t cPacketRingBuffer::getNElements()
+{
+    return m_u32NElements.load(boost::memory_order_relaxed);
+}
+
+uint32_t cPacketRingBuffer::getElementSize_B()
+{
+    return m_u32ElementSize_B.load(boost::memory_order_relaxed);
+}
+
+uint32_t cPacketRingBuffer::getIndex(uint64_t u64Position)
+{
+    //The element count and the offset change together when resizing with data queued so load them in one go. Positions
+    //queued at the time map to the same index before and after.
+    uint64_t u64Geometry = m_u64Geometry.load(boost::memory_order_acquire);
+
+    return (uint32_t)((u64Position + (uint32_t)u64Geometry) % (u64Geometry >> 32));
+}
+
+uint32_t cPacketRingBuffer::getLevel()
+{
+    uint64_t u64ReadPosition = getOldestReadPosition();
+
+    return (uint32_t)(m_u64WritePosition.load(boost::memory_order_acquire) - u64ReadPosition);
+}
+
+void cPacketRingBuffer::interruptWaits()
+{
+    m_oDataAvailableNotifier.notify();
+    m_oSpaceAvailableNotifier.notify();
+}
+
+uint64_t cPacketRingBuffer::getOldestReadPosition(int32_t i32ExcludedCursor)
+{
+    //The oldest position still held by an active cursor or the write position if there are no active cursors
+
+    uint64_t u64WritePosition = m_u64WritePosition.load(boost::memory_order_acquire);
+    uint64_t u64OldestPosition = u64WritePosition;
+
+    uint32_t u32NSlots = m_u32NReadCursorSlotsUsed.load(boost::memory_order_acquire);
+
+    for(uint32_t ui = 0; ui < u32NSlots; ui++)
+    {
+        if((int32_t)ui == i32ExcludedCursor || !m_aoReadCursors[ui].m_bActive.load(boost::memory_order_acquire))
+            continue;
+
+        uint64_t u64Position = m_aoReadCursors[ui].m_u64Position.load(boost::memory_order_acquire);
+
+        if(u64Position < u64OldestPosition)
+            u64OldestPosition = u64Position;
+    }
+
+    return u64OldestPosition;
+}
+
+void cPacketRingBuffer::updateWritersReadPosition()
+{
+    //Called from the writer. Clears the elements that all cursors have finished with since the last update.
+
+    uint64_t u64OldestPosition = getOldestReadPosition();
+
+    for(uint64_t u64Position = m_u64WritersReadPosition; u64Position < u64OldestPosition; u64Position++)
+    {
+        getElementPointer(getIndex(u64Position))->clearData();
+    }
+
+    m_u64WritersReadPosition = u64OldestPosition;
+}
+
+uint32_t cPacketRingBuffer::getNFreeElements()
+{
+    //Called from the writing thread only. With the lock free backend the cursors are only reloaded when the cached
+    //read position says the buffer is full.
+
+    uint32_t u32NBufferElements = m_u32NElements.load(boost::memory_order_relaxed);
+
+    if(m_eBackend == BACKEND_LOCK_FREE_SPSC)
+    {
+        uint64_t u64WritePosition = m_u64WritePosition.load(boost::memory_order_relaxed);
+
+        uint32_t u32NFree = u32NBufferElements - (uint32_t)(u64WritePosition - m_u64WritersReadPosition);
+
+        if(!u32NFree)
+        {
+            updateWritersReadPosition();
+            u32NFree = u32NBufferElements - (uint32_t)(u64WritePosition - m_u64WritersReadPosition);
+        }
+
+        return u32NFree;
+    }
+
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    updateWritersReadPosition();
+
+    return u32NBufferElements - (uint32_t)(m_u64WritePosition.load() - m_u64WritersReadPosition);
+}
+
+uint32_t cPacketRingBuffer::getNAvailableElements(uint32_t u32Cursor)
+{
+    //Called from the cursor's reading thread only. With the lock free backend the write position is only reloaded when the
+    //cached copy says the buffer is empty. The reader may have read past the cached copy when it counted elements with
+    //getLevel() (e.g. to drop them).
+
+    cReadCursor &oCursor = m_aoReadCursors[u32Cursor];
+
+    if(m_eBackend == BACKEND_LOCK_FREE_SPSC)
+    {
+        uint64_t u64ReadPosition = oCursor.m_u64Position.load(boost::memory_order_relaxed);
+
+        if(oCursor.m_u64ReadersWritePosition <= u64ReadPosition)
+            oCursor.m_u64ReadersWritePosition = m_u64WritePosition.load(boost::memory_order_acquire);
+
+        return (uint32_t)(oCursor.m_u64ReadersWritePosition - u64ReadPosition);
+    }
+
+    boost::unique_lock<boost::mutex> oLock(m_oMutex);
+
+    return (uint32_t)(m_u64WritePosition.load() - oCursor.m_u64Position.load());
+}
+
+uint32_t cPacketRingBuffer::waitForElements(bool bFree, uint32_t u32Cursor, uint32_t u32Timeout_ms, const abortCondition &fAbort)
+{
+    //Wait for free elements (writer) or elements of data (reader). Returns the number available or 0 on timeout or abort.
+
+    uint32_t u32NElements = bFree ? getNFreeElements() : getNAvailableElements(u32Cursor);
+
+    if(u32NElements)
+        return u32NElements;
+
+    //In low latency mode poll for the set time (checking the clock and abort condition only now and then)
+    uint32_t u32SpinTime_us = m_u32SpinTime_us.load(boost::memory_order_relaxed);
+
+    if(u32SpinTime_us)
+    {
+        uint64_t u64SpinDeadline_ns = getMonotonicTime_ns() + u32SpinTime_us * 1000ULL;
+
+        for(uint32_t u32NAttempts = 1; ; u32NAttempts++)
+        {
+            cpuRelax();
+
+            u32NElements = bFree ? getNFreeElements() : getNAvailableElements(u32Cursor);
+
+            if(u32NElements)
+                return u32NElements;
+
+            if(!(u32NAttempts % SPIN_CHECK_INTERVAL) && ((fAbort && fAbort()) || getMonotonicTime_ns() >= u64SpinDeadline_ns))
+                break;
+        }
+    }
+
+    //The lock free backend polls for a while first as a handover is usually imminent
+    if(m_eBackend == BACKEND_LOCK_FREE_SPSC)
+    {
+        for(uint32_t u32NAttempts = 0; u32NAttempts < YIELD_ATTEMPTS; u32NAttempts++)
+        {
+            if(u32NAttempts >= SPIN_ATTEMPTS)
+                boost::this_thread::yield();
+
+            u32NElements = bFree ? getNFreeElements() : getNAvailableElements(u32Cursor);
+
+            if(u32NElements)
+                return u32NElements;
+        }
+    }
+
+    cEventNotifier &oNotifier = bFree ? m_oSpaceAvailableNotifier : m_oDataAvailableNotifier;
+
+    boost::system_time oDeadline = boost::get_system_time() + boost::posix_time::milliseconds(u32Timeout_ms);
+
+    while(true)
+    {
+        uint64_t u64Epoch = oNotifier.prepareWait();
+
+        //Re-check after registering as a waiter so that no notification is missed
+        u32NElements = bFree ? getNFreeElements() : getNAvailableElements(u32Cursor);
+
+        if(u32NElements || (fAbort && fAbort()))
+        {
+            oNotifier.cancelWait();
+            return u32NElements;
+        }
+
+        uint32_t u32WaitTime_ms = 0;
+
+        if(u32Timeout_ms)
+        {
+            boost::posix_time::time_duration oRemaining = oDeadline - boost::get_system_time();
+
+            if(oRemaining.is_negative() || !oRemaining.total_milliseconds())
+            {
+                oNotifier.cancelWait();
+                return 0;
+            }
+
+            u32WaitTime_ms = oRemaining.total_milliseconds();
+        }
+
+        oNotifier.wait(u64Epoch, u32WaitTime_ms);
+    }
+}
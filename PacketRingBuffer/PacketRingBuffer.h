@@ -0,0 +1,268 @@
+#ifndef PACKET_RING_BUFFER_H
+#define PACKET_RING_BUFFER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <vector>
+#include <string>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/function.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/shared_ptr.hpp>
+#endif
+
+//Local includes
+#include "../EventNotifier/EventNotifier.h"
+#include "../MemorySlab/MemorySlab.h"
+
+//Circular buffer of char elements for the socket streamers. The interface is a superset of cThreadSafeCircularBuffer<char>
+//so it can be used as a drop in replacement. In addition it allows the writer to reserve several consecutive elements at
+//once so that a batch of packets can be received into the ring with a single system call and the reader to consume several
+//elements with a single wait.
+
+//Indices handed out by the get...Index() functions stay valid until the corresponding element(s) are marked as written or read.
+//A timeout of 0 ms means wait indefinitely. Waits are event driven: they return as soon as an element is written / read, or
+//when the (optional) abort condition is true. The abort condition is checked before blocking and again each time
+//interruptWaits() is called, so callers can block indefinitely and still react to stop requests immediately.
+
+//Two synchronisation backends are available:
+//BACKEND_LOCKING guards the read and write positions with a mutex. This is the default.
+//BACKEND_LOCK_FREE_SPSC publishes the positions with atomics only (on separate cache lines) so handing over an element costs
+//a couple of loads and a store. It supports exactly one writing thread and one reading thread. Waiters spin briefly before
+//blocking.
+//In either case resize(), clear() and setBackend() must not be called while another thread is waiting on the buffer. A buffer
+//in use can be resized with requestResize() instead.
+
+//Element memory is either allocated per element on the heap (ALLOCATION_HEAP, the default) or carved out of a single
+//slab for the whole ring (ALLOCATION_LOCKED_SLAB, see cMemorySlab). The slab uses huge pages when available, is locked in RAM
+//and starts every element on a cache line boundary.
+
+//Several readers can each see every element through independent read cursors. An element is only handed back to the writer
+//once all active cursors have read it. Cursor 0 (PRIMARY_READ_CURSOR) is used by the plain reading functions and is active
+//by default. With the lock free backend each cursor must be read by one thread only.
+
+class cPacketRingBuffer
+{
+public:
+    enum backend
+    {
+        BACKEND_LOCKING = 0,
+        BACKEND_LOCK_FREE_SPSC
+    };
+
+    enum allocationMode
+    {
+        ALLOCATION_HEAP = 0,
+        ALLOCATION_LOCKED_SLAB
+    };
+
+    typedef boost::function<bool ()>                        abortCondition;
+
+    static const uint32_t                                   MAX_READ_CURSORS = 32;
+    static const uint32_t                                   PRIMARY_READ_CURSOR = 0;
+
+    //Fixed size description of the packet in an element, filled in by the writer where known (see cUDPReceiver). Zero fields
+    //are unknown. Kept beside the data so that it costs no allocation per packet.
+    class cMetadata
+    {
+    public:
+        cMetadata();
+
+        void                                                clear();
+        std::string                                         getSourceAddressString() const; //Empty if unknown
+
+        uint8_t                                             m_au8SourceAddress[16]; //Network byte order. IPv4 uses the first 4 bytes.
+        uint8_t                                             m_u8AddressFamily; //4, 6 or 0 if unknown
+        bool                                                m_bKernelTimestamp; //Receive time from the kernel rather than the receiving thread
+        uint16_t                                            m_u16SourcePort;
+        uint32_t                                            m_u32PayloadSize_B; //As sent. More than the element holds if the datagram was truncated.
+        int64_t                                             m_i64ReceiveTime_ns; //Since the Unix epoch
+    };
+
+    class cElement
+    {
+    public:
+        cElement();
+
+        void                                                allocate(uint32_t u32Size_B); //Owned heap memory
+        void                                                assign(char *cpMemory, uint32_t u32Size_B); //Memory owned elsewhere, e.g. by a slab
+
+        char*                                               getDataPointer();
+        uint32_t                                            allocationSize() const;
+        uint32_t                                            dataSize() const;
+
+        void                                                setDataAdded(uint32_t u32Size_B);
+        void                                                clearData();
+
+        cMetadata&                                          metadata();
+
+    private:
+        std::vector<char>                                   m_vcData;
+        char*                                               m_cpAssignedData; //NULL when using m_vcData
+        uint32_t                                            m_u32AssignedSize_B;
+        uint32_t                                            m_u32DataSize_B;
+
+        cMetadata                                           m_oMetadata;
+    };
+
+    cPacketRingBuffer(uint32_t u32NElements, uint32_t u32ElementSize_B, backend eBackend = BACKEND_LOCKING);
+
+    void                                                    resize(uint32_t u32NElements, uint32_t u32ElementSize_B);
+    void                                                    clear();
+
+    //Resize without losing data. Can be called from any thread, also while the buffer is in use. A larger element size takes
+    //effect immediately for the elements handed to the writer from then on; elements still holding data are grown once they
+    //are free again. Any other change is applied by the writer as soon as the queued elements do not wrap around the end of
+    //the ring in either size (so that they keep their indices), at the latest when it finds the buffer empty. Until then the
+    //current geometry is used. Values passed unchanged (e.g. the current element count when only growing the elements)
+    //leave those of a request still pending alone. Readers must take getNElements() after getting their indices.
+    void                                                    requestResize(uint32_t u32NElements, uint32_t u32ElementSize_B);
+    bool                                                    isResizePending();
+
+    //Place the element memory on a NUMA node (see cThreadPlacement). The node is kept for later resizes. -1 leaves placement
+    //to the OS for future allocations. Only the slab of ALLOCATION_LOCKED_SLAB is bound, heap elements are left where they
+    //are first touched (with a warning).
+    void                                                    bindToNUMANode(int32_t i32Node);
+    int32_t                                                 getNUMANode();
+
+    //Reallocates the elements (discarding all data as resize() does)
+    void                                                    setAllocationMode(allocationMode eMode);
+    allocationMode                                          getAllocationMode();
+
+    void                                                    setBackend(backend eBackend);
+    backend                                                 getBackend();
+
+    //Low latency waits: Waiters poll the buffer for up to this long before blocking so that a handover does not cost a thread
+    //wakeup. Keeps a core busy per waiting thread and is best combined with BACKEND_LOCK_FREE_SPSC. 0 (default) disables.
+    void                                                    setSpinTime(uint32_t u32SpinTime_us);
+    uint32_t                                                getSpinTime_us();
+
+    //Writing
+    int32_t                                                 getNextWriteIndex(uint32_t u32Timeout_ms = 0, const abortCondition &fAbort = abortCondition());
+    int32_t                                                 tryToGetNextWriteIndex();
+    uint32_t                                                getNextWriteIndices(int32_t &i32FirstIndex, uint32_t u32MaxNElements, uint32_t u32Timeout_ms = 0, const abortCondition &fAbort = abortCondition());
+    void                                                    elementWritten();
+    void                                                    elementsWritten(uint32_t u32NElements);
+    //Grow one element held for writing, keeping the data already in it, e.g. for a single oversized packet. Other elements
+    //and getElementSize_B() are left alone.
+    void                                                    growElement(uint32_t u32Index, uint32_t u32Size_B);
+
+    //Reading
+    int32_t                                                 getNextReadIndex(uint32_t u32Timeout_ms = 0, const abortCondition &fAbort = abortCondition());
+    int32_t                                                 tryToGetNextReadIndex();
+    uint32_t                                                tryToGetNextReadIndices(int32_t &i32FirstIndex, uint32_t u32MaxNElements);
+    uint32_t                                                getNextReadIndices(int32_t &i32FirstIndex, uint32_t u32MaxNElements, uint32_t u32Timeout_ms = 0, const abortCondition &fAbort = abortCondition());
+    void                                                    elementRead();
+    void                                                    elementsRead(uint32_t u32NElements);
+
+    //Read cursors. A cursor starts either at the oldest element still held by any active cursor or at the write position.
+    int32_t                                                 addReadCursor(bool bFromOldest = false); //Returns -1 if no cursor is available
+    void                                                    activateReadCursor(uint32_t u32Cursor, bool bFromOldest = false);
+    void                                                    deactivateReadCursor(uint32_t u32Cursor);
+    bool                                                    isReadCursorActive(uint32_t u32Cursor);
+
+    int32_t                                                 getNextReadIndexForCursor(uint32_t u32Cursor, uint32_t u32Timeout_ms = 0, const abortCondition &fAbort = abortCondition());
+    uint32_t                                                getNextReadIndicesForCursor(uint32_t u32Cursor, int32_t &i32FirstIndex, uint32_t u32MaxNElements, uint32_t u32Timeout_ms = 0, const abortCondition &fAbort = abortCondition());
+    void                                                    elementsReadForCursor(uint32_t u32Cursor, uint32_t u32NElements);
+
+    //Element access
+    char*                                                   getElementDataPointer(uint32_t u32Index);
+    cElement*                                               getElementPointer(uint32_t u32Index);
+
+    uint32_t                                                getNElements();
+    uint32_t                                                getElementSize_B();
+    uint32_t                                                getLevel();
+
+    //Wake all waiting threads so that they re-evaluate their abort conditions
+    void                                                    interruptWaits();
+
+private:
+    static const uint32_t                                   CACHE_LINE_SIZE_B = 64;
+
+    class cReadCursor
+    {
+    public:
+        cReadCursor();
+
+        boost::atomic<bool>                                 m_bActive;
+        boost::atomic<uint64_t>                             m_u64Position;
+        uint64_t                                            m_u64ReadersWritePosition; //Reader's cached copy of the write position
+        char                                                m_acPadding[CACHE_LINE_SIZE_B];
+    };
+
+    //Elements are referenced through a table that readers index without locking. Resizing with data queued builds a new table
+    //that shares the queued elements (and their memory) with the old one. Tables and slabs replaced that way are kept until
+    //the writer next finds the buffer empty.
+    std::vector<boost::shared_ptr<cElement> >               m_vpElements;
+    boost::atomic<boost::shared_ptr<cElement>*>             m_ppElementTable;
+    std::vector<std::vector<boost::shared_ptr<cElement> > > m_vvpRetiredElementTables;
+    boost::atomic<uint32_t>                                 m_u32NElements;
+    boost::atomic<uint64_t>                                 m_u64Geometry; //Element count (upper 32 bits) and position offset (lower 32 bits)
+    boost::atomic<uint32_t>                                 m_u32ElementSize_B;
+    int32_t                                                 m_i32NUMANode;
+
+    allocationMode                                          m_eAllocationMode;
+    boost::shared_ptr<cMemorySlab>                          m_pSlab; //ALLOCATION_LOCKED_SLAB only
+    uint32_t                                                m_u32SlabStride_B;
+    std::vector<boost::shared_ptr<cMemorySlab> >            m_vpRetiredSlabs;
+    boost::atomic<bool>                                     m_bStorageRetired;
+
+    //Geometry requested by requestResize(). Protected by m_oMutex.
+    boost::atomic<bool>                                     m_bResizePending;
+    uint32_t                                                m_u32PendingNElements;
+    uint32_t                                                m_u32PendingElementSize_B;
+
+    backend                                                 m_eBackend;
+    boost::atomic<uint32_t>                                 m_u32SpinTime_us;
+
+    //Positions count elements monotonically. The index of a position is (position + offset) % element count (see getIndex()).
+    //Producer and consumer state live on separate cache lines so that they do not contend.
+    char                                                    m_acPadding0[CACHE_LINE_SIZE_B];
+    boost::atomic<uint64_t>                                 m_u64WritePosition;
+    uint64_t                                                m_u64WritersReadPosition; //Writer's cached copy of the oldest read position
+    char                                                    m_acPadding1[CACHE_LINE_SIZE_B];
+    cReadCursor                                             m_aoReadCursors[MAX_READ_CURSORS];
+    boost::atomic<uint32_t>                                 m_u32NReadCursorSlotsUsed;
+
+    //Locking backend
+    boost::mutex                                            m_oMutex;
+
+    //Wakeups for blocked writers and readers
+    cEventNotifier                                          m_oDataAvailableNotifier;
+    cEventNotifier                                          m_oSpaceAvailableNotifier;
+
+    void                                                    bindElementsToNUMANode(); //Call with m_oMutex held
+    //Call with m_oMutex held. Elements in the kept index range may be held by readers and are left as they are.
+    void                                                    reallocateElements(uint32_t u32NElements, uint32_t u32ElementSize_B, uint32_t u32FirstKeptIndex = 0, uint32_t u32NKept = 0);
+    bool                                                    applyPendingResize(); //Writer only, call with m_oMutex held
+    void                                                    releaseRetiredStorage(); //Writer only, call with m_oMutex held and the buffer empty
+    bool                                                    prepareElementsForWriting(uint32_t u32FirstIndex, uint32_t u32NElements);
+    void                                                    prepareElement(uint32_t u32Index, uint32_t u32ElementSize_B, bool bReplaceMemory = false); //Writer only
+    uint32_t                                                getIndex(uint64_t u64Position);
+
+    uint64_t                                                getOldestReadPosition(int32_t i32ExcludedCursor = -1);
+    void                                                    updateWritersReadPosition();
+
+    uint32_t                                                getNFreeElements();
+    uint32_t                                                getNAvailableElements(uint32_t u32Cursor);
+    uint32_t                                                waitForElements(bool bFree, uint32_t u32Cursor, uint32_t u32Timeout_ms, const abortCondition &fAbort);
+};
+
+#endif // PACKET_RING_BUFFER_H
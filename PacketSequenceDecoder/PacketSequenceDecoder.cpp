@@ -0,0 +1,244 @@
+//System includes
+
+//Library includes
+
+//Local includes
+#include "PacketSequenceDecoder.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+cPacketSequenceDecoder::cStatistics::cStatistics() :
+    m_u64NPacketsDecoded(0),
+    m_u64NPacketsUndecodable(0),
+    m_u64NGaps(0),
+    m_u64NPacketsMissing(0),
+    m_u64NPacketsLate(0),
+    m_u64NPacketsDuplicated(0),
+    m_u64HighestSequence(0)
+{
+}
+
+cPacketSequenceDecoder::cPacketSequenceDecoder(uint32_t u32Offset_B, uint32_t u32Width_B, endianness eEndianness, uint64_t u64Increment) :
+    m_u32Offset_B(u32Offset_B),
+    m_u32Width_B(u32Width_B),
+    m_eEndianness(eEndianness),
+    m_u64Increment(u64Increment),
+    m_bStarted(false),
+    m_i64HighestSequence(0),
+    m_i64HighestPacketNumber(0),
+    m_vu64History(HISTORY_N_PACKETS / 64, 0),
+    m_u64NPacketsDecoded(0),
+    m_u64NPacketsUndecodable(0),
+    m_u64NGaps(0),
+    m_u64NPacketsMissing(0),
+    m_u64NPacketsLate(0),
+    m_u64NPacketsDuplicated(0),
+    m_u64HighestSequence(0)
+{
+    if(m_u32Width_B < 1 || m_u32Width_B > 8)
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cPacketSequenceDecoder::cPacketSequenceDecoder(): Warning: Sequence field width of " << u32Width_B << " bytes is not supported. Using 8 bytes.";
+        m_u32Width_B = 8;
+    }
+
+    if(!m_u64Increment)
+        m_u64Increment = 1;
+}
+
+cPacketSequenceDecoder::~cPacketSequenceDecoder()
+{
+}
+
+bool cPacketSequenceDecoder::extractSequence(const char *cpData, uint32_t u32Size_B, uint64_t &u64Sequence) const
+{
+    if(u32Size_B < m_u32Offset_B + m_u32Width_B)
+        return false;
+
+    const unsigned char *ucpField = (const unsigned char*)cpData + m_u32Offset_B;
+
+    u64Sequence = 0;
+
+    if(m_eEndianness == ENDIAN_BIG)
+    {
+        for(uint32_t ui = 0; ui < m_u32Width_B; ui++)
+            u64Sequence = (u64Sequence << 8) | ucpField[ui];
+    }
+    else
+    {
+        for(uint32_t ui = m_u32Width_B; ui > 0; ui--)
+            u64Sequence = (u64Sequence << 8) | ucpField[ui - 1];
+    }
+
+    return true;
+}
+
+cPacketSequenceDecoder::sequenceResult cPacketSequenceDecoder::processPacket(const char *cpData, uint32_t u32Size_B, int64_t &i64PacketNumber)
+{
+    uint64_t u64Sequence;
+
+    if(!extractSequence(cpData, u32Size_B, u64Sequence))
+    {
+        m_u64NPacketsUndecodable.fetch_add(1, boost::memory_order_relaxed);
+        return SEQUENCE_UNDECODABLE;
+    }
+
+    m_u64NPacketsDecoded.fetch_add(1, boost::memory_order_relaxed);
+
+    if(!m_bStarted)
+    {
+        m_bStarted = true;
+
+        m_i64HighestSequence = (int64_t)u64Sequence;
+        m_i64HighestPacketNumber = m_i64HighestSequence / (int64_t)m_u64Increment;
+
+        for(uint32_t ui = 0; ui < m_vu64History.size(); ui++)
+            m_vu64History[ui] = 0;
+
+        addToHistory(m_i64HighestPacketNumber);
+        m_u64HighestSequence.store(m_i64HighestSequence, boost::memory_order_relaxed);
+
+        i64PacketNumber = m_i64HighestPacketNumber;
+        return SEQUENCE_FIRST;
+    }
+
+    int64_t i64Sequence = unwrap(u64Sequence);
+    i64PacketNumber = i64Sequence / (int64_t)m_u64Increment;
+
+    if(i64PacketNumber > m_i64HighestPacketNumber)
+    {
+        int64_t i64NSkipped = i64PacketNumber - m_i64HighestPacketNumber - 1;
+
+        advanceHistory(m_i64HighestPacketNumber, i64PacketNumber);
+        addToHistory(i64PacketNumber);
+
+        m_i64HighestSequence = i64Sequence;
+        m_i64HighestPacketNumber = i64PacketNumber;
+        m_u64HighestSequence.store(i64Sequence, boost::memory_order_relaxed);
+
+        if(!i64NSkipped)
+            return SEQUENCE_IN_ORDER;
+
+        m_u64NGaps.fetch_add(1, boost::memory_order_relaxed);
+        m_u64NPacketsMissing.fetch_add(i64NSkipped, boost::memory_order_relaxed);
+
+        return SEQUENCE_GAP;
+    }
+
+    //Older than the highest packet. Within the history duplicates can be told apart from late packets.
+    if(m_i64HighestPacketNumber - i64PacketNumber < (int64_t)HISTORY_N_PACKETS && isInHistory(i64PacketNumber))
+    {
+        m_u64NPacketsDuplicated.fetch_add(1, boost::memory_order_relaxed);
+        return SEQUENCE_DUPLICATE;
+    }
+
+    if(m_i64HighestPacketNumber - i64PacketNumber < (int64_t)HISTORY_N_PACKETS)
+        addToHistory(i64PacketNumber);
+
+    m_u64NPacketsLate.fetch_add(1, boost::memory_order_relaxed);
+
+    //Only the receiving thread decrements so the counter can only have been lowered by resetStatistics() in between
+    if(m_u64NPacketsMissing.load(boost::memory_order_relaxed))
+        m_u64NPacketsMissing.fetch_sub(1, boost::memory_order_relaxed);
+
+    return SEQUENCE_LATE;
+}
+
+void cPacketSequenceDecoder::restart()
+{
+    m_bStarted = false;
+}
+
+int64_t cPacketSequenceDecoder::unwrap(uint64_t u64Sequence)
+{
+    //Interpret the difference to the highest sequence as a signed number of the field width
+    uint64_t u64Difference = u64Sequence - (uint64_t)m_i64HighestSequence;
+
+    if(m_u32Width_B == 8)
+        return m_i64HighestSequence + (int64_t)u64Difference;
+
+    uint32_t u32NBits = 8 * m_u32Width_B;
+    u64Difference &= (1ULL << u32NBits) - 1;
+
+    if(u64Difference & (1ULL << (u32NBits - 1)))
+        return m_i64HighestSequence + (int64_t)u64Difference - (int64_t)(1ULL << u32NBits);
+
+    return m_i64HighestSequence + (int64_t)u64Difference;
+}
+
+bool cPacketSequenceDecoder::isInHistory(int64_t i64PacketNumber)
+{
+    uint32_t u32Bit = (uint64_t)i64PacketNumber & (HISTORY_N_PACKETS - 1);
+
+    return (m_vu64History[u32Bit / 64] >> (u32Bit % 64)) & 1;
+}
+
+void cPacketSequenceDecoder::addToHistory(int64_t i64PacketNumber)
+{
+    uint32_t u32Bit = (uint64_t)i64PacketNumber & (HISTORY_N_PACKETS - 1);
+
+    m_vu64History[u32Bit / 64] |= 1ULL << (u32Bit % 64);
+}
+
+void cPacketSequenceDecoder::advanceHistory(int64_t i64From, int64_t i64To)
+{
+    if(i64To - i64From >= (int64_t)HISTORY_N_PACKETS)
+    {
+        for(uint32_t ui = 0; ui < m_vu64History.size(); ui++)
+            m_vu64History[ui] = 0;
+
+        return;
+    }
+
+    for(int64_t i64PacketNumber = i64From + 1; i64PacketNumber <= i64To; i64PacketNumber++)
+    {
+        uint32_t u32Bit = (uint64_t)i64PacketNumber & (HISTORY_N_PACKETS - 1);
+
+        m_vu64History[u32Bit / 64] &= ~(1ULL << (u32Bit % 64));
+    }
+}
+
+cPacketSequenceDecoder::cStatistics cPacketSequenceDecoder::getStatistics()
+{
+    cStatistics oStatistics;
+
+    oStatistics.m_u64NPacketsDecoded = m_u64NPacketsDecoded.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NPacketsUndecodable = m_u64NPacketsUndecodable.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NGaps = m_u64NGaps.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NPacketsMissing = m_u64NPacketsMissing.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NPacketsLate = m_u64NPacketsLate.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NPacketsDuplicated = m_u64NPacketsDuplicated.load(boost::memory_order_relaxed);
+    oStatistics.m_u64HighestSequence = m_u64HighestSequence.load(boost::memory_order_relaxed);
+
+    return oStatistics;
+}
+
+void cPacketSequenceDecoder::resetStatistics()
+{
+    m_u64NPacketsDecoded.store(0, boost::memory_order_relaxed);
+    m_u64NPacketsUndecodable.store(0, boost::memory_order_relaxed);
+    m_u64NGaps.store(0, boost::memory_order_relaxed);
+    m_u64NPacketsMissing.store(0, boost::memory_order_relaxed);
+    m_u64NPacketsLate.store(0, boost::memory_order_relaxed);
+    m_u64NPacketsDuplicated.store(0, boost::memory_order_relaxed);
+}
+
+uint32_t cPacketSequenceDecoder::getOffset_B() const
+{
+    return m_u32Offset_B;
+}
+
+uint32_t cPacketSequenceDecoder::getWidth_B() const
+{
+    return m_u32Width_B;
+}
+
+cPacketSequenceDecoder::endianness cPacketSequenceDecoder::getEndianness() const
+{
+    return m_eEndianness;
+}
+
+uint64_t cPacketSequenceDecoder::getIncrement() const
+{
+    return m_u64Increment;
+}
@@ -0,0 +1,127 @@
+#ifndef PACKET_SEQUENCE_DECODER_H
+#define PACKET_SEQUENCE_DECODER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <vector>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#endif
+
+//Local includes
+
+//Reads a sequence number (or timestamp) from each packet's header and accounts for lost, duplicated and reordered packets.
+
+//The field is an unsigned integer of 1 to 8 bytes at a fixed offset. Consecutive packets differ by the increment (e.g. the
+//number of samples per packet for a timestamp). Fields narrower than 64 bits are unwrapped, so jumps of up to half the field
+//range in either direction are tracked correctly. Override extractSequence() for headers that need more than a fixed field.
+
+//Accounting is in arrival order and keeps a history of the last HISTORY_N_PACKETS packet numbers:
+//  Gap:            A packet number beyond the next expected one. The skipped packets are counted as missing.
+//  Late:           A packet number below the highest seen and not seen before. It is no longer missing.
+//  Duplicate:      A packet number seen before within the history.
+//Packets older than the history are counted as late.
+
+//processPacket() is called by the receiving thread only. The statistics can be read from any thread.
+
+class cPacketSequenceDecoder
+{
+public:
+    enum endianness
+    {
+        ENDIAN_BIG = 0, //Network byte order
+        ENDIAN_LITTLE
+    };
+
+    enum sequenceResult
+    {
+        SEQUENCE_FIRST = 0,
+        SEQUENCE_IN_ORDER,
+        SEQUENCE_GAP,
+        SEQUENCE_LATE,
+        SEQUENCE_DUPLICATE,
+        SEQUENCE_UNDECODABLE //Packet too short for the field
+    };
+
+    class cStatistics
+    {
+    public:
+        cStatistics();
+
+        uint64_t                                            m_u64NPacketsDecoded;
+        uint64_t                                            m_u64NPacketsUndecodable;
+        uint64_t                                            m_u64NGaps; //Occurrences
+        uint64_t                                            m_u64NPacketsMissing; //Skipped by gaps less those that arrived late
+        uint64_t                                            m_u64NPacketsLate;
+        uint64_t                                            m_u64NPacketsDuplicated;
+        uint64_t                                            m_u64HighestSequence; //Unwrapped field value
+    };
+
+    static const uint32_t                                   HISTORY_N_PACKETS = 1024; //Power of 2
+
+    cPacketSequenceDecoder(uint32_t u32Offset_B, uint32_t u32Width_B = 8, endianness eEndianness = ENDIAN_BIG, uint64_t u64Increment = 1);
+    virtual ~cPacketSequenceDecoder();
+
+    //Returns false if the packet does not hold the field
+    virtual bool                                            extractSequence(const char *cpData, uint32_t u32Size_B, uint64_t &u64Sequence) const;
+
+    //Decodes and accounts one packet. i64PacketNumber is the unwrapped sequence divided by the increment and is only valid if
+    //the result is not SEQUENCE_UNDECODABLE.
+    sequenceResult                                          processPacket(const char *cpData, uint32_t u32Size_B, int64_t &i64PacketNumber);
+
+    //Forget the stream, e.g. when a receiver is restarted. The next packet is SEQUENCE_FIRST. Receiving thread only.
+    void                                                    restart();
+
+    cStatistics                                             getStatistics();
+    void                                                    resetStatistics();
+
+    uint32_t                                                getOffset_B() const;
+    uint32_t                                                getWidth_B() const;
+    endianness                                              getEndianness() const;
+    uint64_t                                                getIncrement() const;
+
+protected:
+    uint32_t                                                m_u32Offset_B;
+    uint32_t                                                m_u32Width_B;
+    endianness                                              m_eEndianness;
+    uint64_t                                                m_u64Increment;
+
+private:
+    //Receiving thread state
+    bool                                                    m_bStarted;
+    int64_t                                                 m_i64HighestSequence; //Unwrapped
+    int64_t                                                 m_i64HighestPacketNumber;
+    std::vector<uint64_t>                                   m_vu64History; //One bit per packet number modulo HISTORY_N_PACKETS
+
+    boost::atomic<uint64_t>                                 m_u64NPacketsDecoded;
+    boost::atomic<uint64_t>                                 m_u64NPacketsUndecodable;
+    boost::atomic<uint64_t>                                 m_u64NGaps;
+    boost::atomic<uint64_t>                                 m_u64NPacketsMissing;
+    boost::atomic<uint64_t>                                 m_u64NPacketsLate;
+    boost::atomic<uint64_t>                                 m_u64NPacketsDuplicated;
+    boost::atomic<uint64_t>                                 m_u64HighestSequence;
+
+    int64_t                                                 unwrap(uint64_t u64Sequence);
+
+    bool                                                    isInHistory(int64_t i64PacketNumber);
+    void                                                    addToHistory(int64_t i64PacketNumber);
+    void                                                    advanceHistory(int64_t i64From, int64_t i64To); //Clears (i64From, i64To]
+};
+
+#endif // PACKET_SEQUENCE_DECODER_H
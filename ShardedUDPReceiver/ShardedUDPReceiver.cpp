@@ -0,0 +1,229 @@
+//System includes
+
+//Library includes
+
+//Local includes
+#include "ShardedUDPReceiver.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+cShardedUDPReceiver::cMergingHandler::cMergingHandler(boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pHandler) :
+    m_pHandler(pHandler)
+{
+}
+
+void cShardedUDPReceiver::cMergingHandler::offloadData_callback(char* pData, uint32_t u32Size_B)
+{
+    boost::mutex::scoped_lock oLock(m_oMutex);
+
+    m_pHandler->offloadData_callback(pData, u32Size_B);
+}
+
+void cShardedUDPReceiver::cMergingHandler::offloadDataAndMetadata_callback(char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata)
+{
+    boost::mutex::scoped_lock oLock(m_oMutex);
+
+    m_pHandler->offloadDataAndMetadata_callback(pData, u32Size_B, oMetadata);
+}
+
+cShardedUDPReceiver::cShardedUDPReceiver(const string &strLocalInterface, uint16_t u16LocalPort, uint32_t u32NShards, const string &strPeerAddress, uint16_t usPeerPort,
+                                         uint32_t u32BufferNElements, uint32_t u32BufferElementSize_B)
+{
+    if(!u32NShards)
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cShardedUDPReceiver::cShardedUDPReceiver(): Warning: Requested 0 shards. Using 1.";
+        u32NShards = 1;
+    }
+
+    for(uint32_t u32ShardNo = 0; u32ShardNo < u32NShards; u32ShardNo++)
+    {
+        boost::shared_ptr<cUDPReceiver> pShard(new cUDPReceiver(strLocalInterface, u16LocalPort, strPeerAddress, usPeerPort, u32BufferNElements, u32BufferElementSize_B));
+        pShard->setReusePort(true);
+
+        m_vpShards.push_back(pShard);
+    }
+}
+
+cShardedUDPReceiver::~cShardedUDPReceiver()
+{
+    shutdown();
+}
+
+void cShardedUDPReceiver::startReceiving()
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->startReceiving();
+}
+
+void cShardedUDPReceiver::stopReceiving()
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->stopReceiving();
+}
+
+void cShardedUDPReceiver::startCallbackOffloading()
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->startCallbackOffloading();
+}
+
+void cShardedUDPReceiver::stopCallbackOffloading()
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->stopCallbackOffloading();
+}
+
+void cShardedUDPReceiver::shutdown()
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->shutdown();
+}
+
+void cShardedUDPReceiver::setReceiveBatchSize(uint32_t u32NDatagrams)
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->setReceiveBatchSize(u32NDatagrams);
+}
+
+void cShardedUDPReceiver::setPreserveDatagramBoundaries(bool bPreserve)
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->setPreserveDatagramBoundaries(bPreserve);
+}
+
+void cShardedUDPReceiver::setSocketOptions(const cSocketOptions &oOptions)
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->setSocketOptions(oOptions);
+}
+
+void cShardedUDPReceiver::setSpinTime(uint32_t u32SpinTime_us)
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->setSpinTime(u32SpinTime_us);
+}
+
+uint32_t cShardedUDPReceiver::getNShards()
+{
+    return m_vpShards.size();
+}
+
+boost::shared_ptr<cUDPReceiver> cShardedUDPReceiver::getShard(uint32_t u32Shard)
+{
+    if(u32Shard >= m_vpShards.size())
+        return boost::shared_ptr<cUDPReceiver>();
+
+    return m_vpShards[u32Shard];
+}
+
+cSocketReceiverBase::cStatistics cShardedUDPReceiver::getStatistics()
+{
+    cSocketReceiverBase::cStatistics oTotal;
+
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+    {
+        cSocketReceiverBase::cStatistics oShard = m_vpShards[u32ShardNo]->getStatistics();
+
+        oTotal.m_u64NPacketsReceived        += oShard.m_u64NPacketsReceived;
+        oTotal.m_u64NBytesReceived          += oShard.m_u64NBytesReceived;
+        oTotal.m_u64NSocketErrors           += oShard.m_u64NSocketErrors;
+        oTotal.m_u64NTruncatedPackets       += oShard.m_u64NTruncatedPackets;
+        oTotal.m_u64BufferFullWaitTime_us   += oShard.m_u64BufferFullWaitTime_us;
+        oTotal.m_u64NCallbacks              += oShard.m_u64NCallbacks;
+        oTotal.m_u64CallbackTime_us         += oShard.m_u64CallbackTime_us;
+
+        if(oShard.m_u32BufferSize > oTotal.m_u32BufferSize)
+            oTotal.m_u32BufferSize = oShard.m_u32BufferSize;
+
+        if(oShard.m_u32BufferLevel > oTotal.m_u32BufferLevel)
+            oTotal.m_u32BufferLevel = oShard.m_u32BufferLevel;
+
+        if(oShard.m_u32BufferHighWaterMark > oTotal.m_u32BufferHighWaterMark)
+            oTotal.m_u32BufferHighWaterMark = oShard.m_u32BufferHighWaterMark;
+    }
+
+    return oTotal;
+}
+
+void cShardedUDPReceiver::resetStatistics()
+{
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        m_vpShards[u32ShardNo]->resetStatistics();
+}
+
+uint64_t cShardedUDPReceiver::getNKernelQueueDrops()
+{
+    uint64_t u64NDrops = 0;
+
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+        u64NDrops += m_vpShards[u32ShardNo]->getNKernelQueueDrops();
+
+    return u64NDrops;
+}
+
+bool cShardedUDPReceiver::registerDataCallbackHandler(boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pNewHandler)
+{
+    boost::mutex::scoped_lock oLock(m_oMergingHandlersMutex);
+
+    //One wrapper shared by all shards so that they also share its mutex
+    boost::shared_ptr<cMergingHandler> pMergingHandler(new cMergingHandler(pNewHandler));
+
+    for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+    {
+        if(!m_vpShards[u32ShardNo]->registerDataCallbackHandler(pMergingHandler))
+        {
+            //All shards or none
+            for(uint32_t u32Registered = 0; u32Registered < u32ShardNo; u32Registered++)
+                m_vpShards[u32Registered]->deregisterDataCallbackHandler(pMergingHandler);
+
+            return false;
+        }
+    }
+
+    m_vpMergingHandlers.push_back(pMergingHandler);
+
+    return true;
+}
+
+void cShardedUDPReceiver::deregisterDataCallbackHandler(boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pHandler)
+{
+    boost::mutex::scoped_lock oLock(m_oMergingHandlersMutex);
+
+    for(uint32_t ui = 0; ui < m_vpMergingHandlers.size(); ui++)
+    {
+        if(m_vpMergingHandlers[ui]->m_pHandler == pHandler)
+        {
+            for(uint32_t u32ShardNo = 0; u32ShardNo < m_vpShards.size(); u32ShardNo++)
+                m_vpShards[u32ShardNo]->deregisterDataCallbackHandler(m_vpMergingHandlers[ui]);
+
+            m_vpMergingHandlers.erase(m_vpMergingHandlers.begin() + ui);
+
+            return;
+        }
+    }
+
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cShardedUDPReceiver::deregisterDataCallbackHandler(): Warning: Handler is not registered for merged output.";
+}
+
+bool cShardedUDPReceiver::registerDataCallbackHandler(uint32_t u32Shard, boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pNewHandler)
+{
+    if(u32Shard >= m_vpShards.size())
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cShardedUDPReceiver::registerDataCallbackHandler(): Error: Shard " << u32Shard << " does not exist. There are " << m_vpShards.size() << " shards.";
+        return false;
+    }
+
+    return m_vpShards[u32Shard]->registerDataCallbackHandler(pNewHandler);
+}
+
+void cShardedUDPReceiver::deregisterDataCallbackHandler(uint32_t u32Shard, boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pHandler)
+{
+    if(u32Shard >= m_vpShards.size())
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cShardedUDPReceiver::deregisterDataCallbackHandler(): Error: Shard " << u32Shard << " does not exist. There are " << m_vpShards.size() << " shards.";
+        return;
+    }
+
+    m_vpShards[u32Shard]->deregisterDataCallbackHandler(pHandler);
+}
@@ -0,0 +1,106 @@
+#ifndef SHARDED_UDP_RECEIVER_H
+#define SHARDED_UDP_RECEIVER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <vector>
+#include <string>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/noncopyable.hpp>
+#endif
+
+//Local includes
+#include "../UDPReceiver/UDPReceiver.h"
+
+//Receives a single UDP port with several sockets bound with SO_REUSEPORT. Each shard is a complete cUDPReceiver with its
+//own socket, receiving thread and ring buffer so receiving scales across CPUs (pin each shard with its setThreadPlacement()).
+
+//The kernel assigns datagrams to sockets by a hash of the flow (source and destination address and port), so packets of one
+//flow always arrive on the same shard and in order, but a single flow does not spread across shards. Several senders or
+//source ports are needed for the load to be shared.
+
+//Shards can be consumed in two ways:
+//  Independent:    Register handlers per shard (or pull from getShard()) and process the N streams in parallel.
+//  Merged:         Register a handler with the sharded receiver. It receives the packets of all shards. Calls are
+//                  serialised so the handler need not be thread safe. Packets are in order per flow, not across flows.
+
+class cShardedUDPReceiver : private boost::noncopyable
+{
+public:
+    cShardedUDPReceiver(const std::string &strLocalInterface, uint16_t u16LocalPort, uint32_t u32NShards, const std::string &strPeerAddress = std::string(""),
+                        uint16_t usPeerPort = 60001, uint32_t u32BufferNElements = cSocketReceiverBase::DEFAULT_BUFFER_N_ELEMENTS,
+                        uint32_t u32BufferElementSize_B = cSocketReceiverBase::DEFAULT_BUFFER_ELEMENT_SIZE_B);
+    ~cShardedUDPReceiver();
+
+    //Applied to all shards
+    void                                                            startReceiving();
+    void                                                            stopReceiving();
+
+    void                                                            startCallbackOffloading();
+    void                                                            stopCallbackOffloading();
+
+    void                                                            shutdown();
+
+    void                                                            setReceiveBatchSize(uint32_t u32NDatagrams);
+    void                                                            setPreserveDatagramBoundaries(bool bPreserve);
+    void                                                            setSocketOptions(const cSocketOptions &oOptions);
+    void                                                            setSpinTime(uint32_t u32SpinTime_us); //A busy core per shard thread
+
+    //Individual shards for per shard configuration (thread placement, buffers), pulling data and statistics
+    uint32_t                                                        getNShards();
+    boost::shared_ptr<cUDPReceiver>                                 getShard(uint32_t u32Shard);
+
+    //Sum over all shards. The buffer size, level and high water mark are the largest of any shard.
+    cSocketReceiverBase::cStatistics                                getStatistics();
+    void                                                            resetStatistics();
+    uint64_t                                                        getNKernelQueueDrops(); //Sum over all shards
+
+    //Merged output. Registration fails if any shard has no room for another handler (see cSocketReceiverBase).
+    bool                                                            registerDataCallbackHandler(boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pNewHandler);
+    void                                                            deregisterDataCallbackHandler(boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pHandler);
+
+    //Independent output
+    bool                                                            registerDataCallbackHandler(uint32_t u32Shard, boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pNewHandler);
+    void                                                            deregisterDataCallbackHandler(uint32_t u32Shard, boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pHandler);
+
+private:
+    //Registered with every shard in place of a merged handler. Serialises the shards' dispatchers onto the handler.
+    class cMergingHandler : public cSocketReceiverBase::cDataCallbackInterface
+    {
+    public:
+        explicit cMergingHandler(boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> pHandler);
+
+        virtual void                                                offloadData_callback(char* pData, uint32_t u32Size_B);
+        virtual void                                                offloadDataAndMetadata_callback(char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata);
+
+        boost::shared_ptr<cSocketReceiverBase::cDataCallbackInterface> m_pHandler;
+
+    private:
+        boost::mutex                                                m_oMutex;
+    };
+
+    std::vector<boost::shared_ptr<cUDPReceiver> >                   m_vpShards;
+
+    std::vector<boost::shared_ptr<cMergingHandler> >                m_vpMergingHandlers;
+    boost::mutex                                                    m_oMergingHandlersMutex;
+};
+
+#endif // SHARDED_UDP_RECEIVER_H
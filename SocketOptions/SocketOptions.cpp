@@ -0,0 +1,193 @@
+//System includes
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include <fstream>
+
+//Library includes
+
+//Local includes
+#include "SocketOptions.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+cSocketOptions::cSocketOptions()
+{
+    clear();
+}
+
+void cSocketOptions::setReceiveBufferSize(uint32_t u32Size_B)
+{
+    m_bReceiveBufferSizeSet = true;
+    m_u32ReceiveBufferSize_B = u32Size_B;
+}
+
+void cSocketOptions::setSendBufferSize(uint32_t u32Size_B)
+{
+    m_bSendBufferSizeSet = true;
+    m_u32SendBufferSize_B = u32Size_B;
+}
+
+void cSocketOptions::setNoDelay(bool bNoDelay)
+{
+    m_bNoDelaySet = true;
+    m_bNoDelay = bNoDelay;
+}
+
+void cSocketOptions::setBusyPoll(uint32_t u32Time_us)
+{
+    m_bBusyPollSet = true;
+    m_u32BusyPoll_us = u32Time_us;
+}
+
+void cSocketOptions::setPriority(uint32_t u32Priority)
+{
+    m_bPrioritySet = true;
+    m_u32Priority = u32Priority;
+}
+
+void cSocketOptions::setTypeOfService(uint8_t u8TypeOfService)
+{
+    m_bTypeOfServiceSet = true;
+    m_u8TypeOfService = u8TypeOfService;
+}
+
+void cSocketOptions::clear()
+{
+    m_bReceiveBufferSizeSet = false;
+    m_u32ReceiveBufferSize_B = 0;
+    m_bSendBufferSizeSet = false;
+    m_u32SendBufferSize_B = 0;
+    m_bNoDelaySet = false;
+    m_bNoDelay = false;
+    m_bBusyPollSet = false;
+    m_u32BusyPoll_us = 0;
+    m_bPrioritySet = false;
+    m_u32Priority = 0;
+    m_bTypeOfServiceSet = false;
+    m_u8TypeOfService = 0;
+}
+
+bool cSocketOptions::isEmpty() const
+{
+    return !(m_bReceiveBufferSizeSet || m_bSendBufferSizeSet || m_bNoDelaySet || m_bBusyPollSet || m_bPrioritySet || m_bTypeOfServiceSet);
+}
+
+bool cSocketOptions::apply(int iSocketFD, const string &strSocketName) const
+{
+    if(isEmpty())
+        return true;
+
+#ifdef __linux__
+    bool bSuccess = true;
+
+    if(m_bReceiveBufferSizeSet)
+        bSuccess &= setBufferSize(iSocketFD, true, m_u32ReceiveBufferSize_B, strSocketName);
+
+    if(m_bSendBufferSizeSet)
+        bSuccess &= setBufferSize(iSocketFD, false, m_u32SendBufferSize_B, strSocketName);
+
+    if(m_bNoDelaySet)
+    {
+        int iType = 0;
+        socklen_t iLength = sizeof(iType);
+
+        if(!getsockopt(iSocketFD, SOL_SOCKET, SO_TYPE, &iType, &iLength) && iType == SOCK_STREAM)
+            bSuccess &= setIntegerOption(iSocketFD, IPPROTO_TCP, TCP_NODELAY, m_bNoDelay, "TCP_NODELAY", strSocketName);
+    }
+
+    if(m_bBusyPollSet)
+    {
+#ifdef SO_BUSY_POLL
+        bSuccess &= setIntegerOption(iSocketFD, SOL_SOCKET, SO_BUSY_POLL, m_u32BusyPoll_us, "SO_BUSY_POLL", strSocketName);
+
+        //The receivers' waits only spin if poll() does
+        uint32_t u32PollBusyPoll_us = 0;
+        ifstream oFile("/proc/sys/net/core/busy_poll");
+
+        if(m_u32BusyPoll_us && oFile >> u32PollBusyPoll_us && !u32PollBusyPoll_us)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketOptions::apply(): Warning: net.core.busy_poll is 0. SO_BUSY_POLL has little effect on waits of "
+                                               << strSocketName << ".";
+        }
+#else
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketOptions::apply(): Warning: SO_BUSY_POLL is not supported by this build. Ignoring for " << strSocketName << ".";
+        bSuccess = false;
+#endif
+    }
+
+    if(m_bPrioritySet)
+        bSuccess &= setIntegerOption(iSocketFD, SOL_SOCKET, SO_PRIORITY, m_u32Priority, "SO_PRIORITY", strSocketName);
+
+    if(m_bTypeOfServiceSet)
+    {
+        sockaddr_storage sAddress;
+        socklen_t iLength = sizeof(sAddress);
+
+        if(!getsockname(iSocketFD, (sockaddr*)&sAddress, &iLength) && sAddress.ss_family == AF_INET6)
+            bSuccess &= setIntegerOption(iSocketFD, IPPROTO_IPV6, IPV6_TCLASS, m_u8TypeOfService, "IPV6_TCLASS", strSocketName);
+        else
+            bSuccess &= setIntegerOption(iSocketFD, IPPROTO_IP, IP_TOS, m_u8TypeOfService, "IP_TOS", strSocketName);
+    }
+
+    return bSuccess;
+#else
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketOptions::apply(): Warning: Socket options are only implemented for Linux. Ignoring for " << strSocketName << ".";
+
+    return false;
+#endif
+}
+
+bool cSocketOptions::setBufferSize(int iSocketFD, bool bReceive, uint32_t u32Size_B, const string &strSocketName)
+{
+#ifdef __linux__
+    int iOption = bReceive ? SO_RCVBUF : SO_SNDBUF;
+    const char *cpOptionName = bReceive ? "SO_RCVBUF" : "SO_SNDBUF";
+
+    if(!setIntegerOption(iSocketFD, SOL_SOCKET, iOption, u32Size_B, cpOptionName, strSocketName))
+        return false;
+
+    //The kernel reports twice the usable size. Check whether the request was capped by the system maximum.
+    int iActualSize_B = 0;
+    socklen_t iLength = sizeof(iActualSize_B);
+    getsockopt(iSocketFD, SOL_SOCKET, iOption, &iActualSize_B, &iLength);
+
+    if((uint32_t)iActualSize_B / 2 >= u32Size_B)
+        return true;
+
+    int iForceOption = bReceive ? SO_RCVBUFFORCE : SO_SNDBUFFORCE;
+    int iSize_B = u32Size_B;
+
+    if(!setsockopt(iSocketFD, SOL_SOCKET, iForceOption, &iSize_B, sizeof(iSize_B)))
+        return true;
+
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketOptions::setBufferSize(): Warning: " << strSocketName << " " << cpOptionName << " is capped at " << iActualSize_B / 2
+                                       << " bytes instead of " << u32Size_B << ". Raise net.core." << (bReceive ? "rmem_max" : "wmem_max") << " or grant CAP_NET_ADMIN.";
+    return false;
+#else
+    return false;
+#endif
+}
+
+bool cSocketOptions::setIntegerOption(int iSocketFD, int iLevel, int iOption, int iValue, const char *cpOptionName, const string &strSocketName)
+{
+#ifdef __linux__
+    if(setsockopt(iSocketFD, iLevel, iOption, &iValue, sizeof(iValue)))
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketOptions::setIntegerOption(): Warning: Unable to set " << cpOptionName << " to " << iValue << " on " << strSocketName << ": " << strerror(errno);
+        return false;
+    }
+
+    return true;
+#else
+    return false;
+#endif
+}
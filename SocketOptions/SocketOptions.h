@@ -0,0 +1,84 @@
+#ifndef SOCKET_OPTIONS_H
+#define SOCKET_OPTIONS_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <string>
+
+//Library include:
+
+//Local includes
+
+//A profile of socket options applied by the streamers when they open, bind, connect or accept a socket. Only the options that
+//have been set are applied, the rest keep the system defaults. Options that do not apply to a socket (e.g. TCP_NODELAY on a
+//UDP socket) are skipped. Failures are logged and do not stop the socket from being used.
+
+//Notes:
+//  Buffer sizes:   The kernel doubles the value for bookkeeping and caps it at net.core.rmem_max / wmem_max. If the cap
+//                  is hit SO_RCVBUFFORCE / SO_SNDBUFFORCE is tried, which needs CAP_NET_ADMIN.
+//  Busy polling:   SO_BUSY_POLL lets the socket spin in the driver for up to this many microseconds instead of sleeping.
+//                  Raising it above the current value needs CAP_NET_ADMIN. net.core.busy_read sets the system wide
+//                  default. The receivers wait for data with poll() and then read without blocking, so the spinning
+//                  only happens if net.core.busy_poll (the time poll() spins) is non-zero too, e.g.
+//                  sysctl -w net.core.busy_poll=50. apply() warns if it is not.
+//  Priority:       SO_PRIORITY above 6 needs CAP_NET_ADMIN.
+//  Type of service: IP_TOS (IPV6_TCLASS on IPv6 sockets), i.e. DSCP << 2 | ECN.
+
+//Linux only. Elsewhere apply() logs a warning and does nothing.
+
+class cSocketOptions
+{
+public:
+    cSocketOptions();
+
+    void                                                    setReceiveBufferSize(uint32_t u32Size_B);
+    void                                                    setSendBufferSize(uint32_t u32Size_B);
+    void                                                    setNoDelay(bool bNoDelay); //TCP only
+    void                                                    setBusyPoll(uint32_t u32Time_us);
+    void                                                    setPriority(uint32_t u32Priority);
+    void                                                    setTypeOfService(uint8_t u8TypeOfService);
+
+    void                                                    clear();
+    bool                                                    isEmpty() const;
+
+    //Returns false if any of the options could not be applied
+    bool                                                    apply(int iSocketFD, const std::string &strSocketName) const;
+
+private:
+    bool                                                    m_bReceiveBufferSizeSet;
+    uint32_t                                                m_u32ReceiveBufferSize_B;
+
+    bool                                                    m_bSendBufferSizeSet;
+    uint32_t                                                m_u32SendBufferSize_B;
+
+    bool                                                    m_bNoDelaySet;
+    bool                                                    m_bNoDelay;
+
+    bool                                                    m_bBusyPollSet;
+    uint32_t                                                m_u32BusyPoll_us;
+
+    bool                                                    m_bPrioritySet;
+    uint32_t                                                m_u32Priority;
+
+    bool                                                    m_bTypeOfServiceSet;
+    uint8_t                                                 m_u8TypeOfService;
+
+    static bool                                             setBufferSize(int iSocketFD, bool bReceive, uint32_t u32Size_B, const std::string &strSocketName);
+    static bool                                             setIntegerOption(int iSocketFD, int iLevel, int iOption, int iValue, const char *cpOptionName, const std::string &strSocketName);
+};
+
+#endif // SOCKET_OPTIONS_H
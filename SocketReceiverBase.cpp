@@ -1,29 +1,52 @@
 //System includes
-#include <iostream>
 #include <sstream>
+#include <algorithm>
 
 //Library includes
 #ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
 #include <boost/asio/buffer.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/bind.hpp>
 #endif
 
 //Local includes
 #include "SocketReceiverBase.h"
+#include "Logger/Logger.h"
 
 using namespace std;
 
-cSocketReceiverBase::cSocketReceiverBase(const string &strPeerAddress, uint16_t u16PeerPort) :
+cSocketReceiverBase::cSocketReceiverBase(const string &strPeerAddress, uint16_t u16PeerPort, uint32_t u32BufferNElements, uint32_t u32BufferElementSize_B) :
     m_strPeerAddress(strPeerAddress),
     m_u16PeerPort(u16PeerPort),
     m_bReceivingEnabled(false),
     m_bCallbackOffloadingEnabled(false),
     m_bShutdownFlag(false),
+    m_oRunStateNotifier(true),
     m_pSocketReceivingThread(NULL),
     m_pDataOffloadingThread(NULL),
+    m_u64NPacketsReceived(0),
+    m_u64NBytesReceived(0),
+    m_u64NSocketErrors(0),
+    m_u64NTruncatedPackets(0),
+    m_u32BufferHighWaterMark(0),
+    m_u64BufferFullWaitTime_us(0),
+    m_u64NCallbacks(0),
+    m_u64CallbackTime_us(0),
+    m_bBufferAutoTuning(false),
+    m_u32AutoTuningHeadroom_ms(100),
+    m_u32AutoTuningMinNElements(256),
+    m_u32AutoTuningMaxNElements(65536),
+    m_u32AutoTuningNCalls(0),
+    m_u32AutoTuningPeakLevel(0),
+    m_u64AutoTuningNElements(0),
     m_i32GetRawDataInputBufferIndex(-1),
-    m_oBuffer(1024, 1040)
+    m_bPacketBorrowed(false),
+    m_oBuffer(u32BufferNElements, u32BufferElementSize_B)
 {
+    m_pDataCallbackHandlers.reset(new dataCallbackHandlerList());
+
+    m_fReceivingStopCondition = boost::bind(&cSocketReceiverBase::isReceivingStopRequested, this);
+    m_fCallbackOffloadingStopCondition = boost::bind(&cSocketReceiverBase::isCallbackOffloadingStopRequested, this);
 }
 
 cSocketReceiverBase::~cSocketReceiverBase()
@@ -33,85 +56,220 @@ cSocketReceiverBase::~cSocketReceiverBase()
 
 void cSocketReceiverBase::clearBuffer()
 {
+    //The dispatcher threads hold read cursors on the buffer while offloading
+    if(isCallbackOffloadingEnabled())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::clearBuffer(): Warning: Cannot clear buffer while offloading. Ignoring.";
+        return;
+    }
+
+    m_bPacketBorrowed = false;
     m_oBuffer.clear();
 }
 
-void cSocketReceiverBase::startReceiving()
+void cSocketReceiverBase::setBufferBackend(cPacketRingBuffer::backend eBackend)
+{
+    if(isReceivingEnabled() || isCallbackOffloadingEnabled())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::setBufferBackend(): Warning: Cannot change buffer backend while receiving or offloading. Ignoring.";
+        return;
+    }
+
+    m_oBuffer.setBackend(eBackend);
+}
+
+void cSocketReceiverBase::setBufferGeometry(uint32_t u32NElements, uint32_t u32ElementSize_B)
+{
+    m_oBuffer.requestResize(u32NElements, u32ElementSize_B);
+}
+
+void cSocketReceiverBase::setBufferAutoTuning(bool bEnable, uint32_t u32Headroom_ms, uint32_t u32MinNElements, uint32_t u32MaxNElements)
 {
-    cout << "cSocketReceiverBase::startReceiving()" << endl;
+    if(!u32MinNElements)
+        u32MinNElements = 1;
 
-    u64TotalBytesProcessed = 0;
+    if(u32MaxNElements < u32MinNElements)
+        u32MaxNElements = u32MinNElements;
 
+    m_u32AutoTuningHeadroom_ms.store(u32Headroom_ms);
+    m_u32AutoTuningMinNElements.store(u32MinNElements);
+    m_u32AutoTuningMaxNElements.store(u32MaxNElements);
+    m_bBufferAutoTuning.store(bEnable);
+}
+
+void cSocketReceiverBase::setBufferAllocationMode(cPacketRingBuffer::allocationMode eMode)
+{
+    if(isReceivingEnabled() || isCallbackOffloadingEnabled())
     {
-        boost::unique_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-        m_bReceivingEnabled = true;
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::setBufferAllocationMode(): Warning: Cannot change buffer allocation while receiving or offloading. Ignoring.";
+        return;
     }
 
+    m_bPacketBorrowed = false;
+    m_oBuffer.setAllocationMode(eMode);
+}
+
+void cSocketReceiverBase::setSpinTime(uint32_t u32SpinTime_us)
+{
+    //Spinning threads sharing a core only delay each other
+    if(u32SpinTime_us && boost::thread::hardware_concurrency() < 2)
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::setSpinTime(): Warning: Only one CPU core available. Spinning will increase latency.";
+
+    m_oBuffer.setSpinTime(u32SpinTime_us);
+}
+
+uint32_t cSocketReceiverBase::getSpinTime_us()
+{
+    return m_oBuffer.getSpinTime_us();
+}
+
+void cSocketReceiverBase::startReceiving()
+{
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::startReceiving()";
+
+    resetStatistics();
+
+    m_bReceivingEnabled.store(true);
+
     m_i32GetRawDataInputBufferIndex = -1;
 
-    clearBuffer();
+    //Packets still queued for the callback handlers are left to them
+    if(!isCallbackOffloadingEnabled())
+        clearBuffer();
+
+    //Start a new auto tuning interval
+    m_u32AutoTuningNCalls = 0;
+    m_u32AutoTuningPeakLevel = 0;
+    m_u64AutoTuningNElements = 0;
+    m_oAutoTuningLastTime = boost::posix_time::ptime();
 
     m_pSocketReceivingThread.reset(new boost::thread(&cSocketReceiverBase::socketReceivingThreadFunction, this));
+
+    getThreadPlacement(THREAD_RECEIVING).apply(*m_pSocketReceivingThread, string("socket receiving"));
 }
 
 void cSocketReceiverBase::stopReceiving()
 {
-    cout << "cSocketReceiverBase::stopReceiving()" << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::stopReceiving()";
+
+    m_bReceivingEnabled.store(false);
 
-    boost::unique_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-    m_bReceivingEnabled = false;
+    notifyRunStateChange();
 }
 
 void cSocketReceiverBase::startCallbackOffloading()
 {
-    cout << "cSocketReceiverBase::startCallbackOffloading()" << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::startCallbackOffloading()";
 
+    if(isCallbackOffloadingEnabled())
     {
-        boost::unique_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-        m_bCallbackOffloadingEnabled = true;
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::startCallbackOffloading(): Warning: Callback offloading is already enabled. Ignoring.";
+        return;
     }
 
+    //Wait for a previous offloading thread to hand the buffer back
+    if(m_pDataOffloadingThread.get())
+        m_pDataOffloadingThread->join();
+
+    //A borrowed packet is dropped. The dispatchers start from the oldest unread packet.
+    if(m_bPacketBorrowed)
+        releasePacket();
+
+    m_bCallbackOffloadingEnabled.store(true);
+
     m_i32GetRawDataInputBufferIndex = -1;
 
-    clearBuffer();
+    m_pDataOffloadingThread.reset(new boost::thread(&cSocketReceiverBase::dataOffloadingThreadFunction, this));
 
-    m_pSocketReceivingThread.reset(new boost::thread(&cSocketReceiverBase::dataOffloadingThreadFunction, this));
+    getThreadPlacement(THREAD_OFFLOADING).apply(*m_pDataOffloadingThread, string("data offloading"));
 }
 
 void cSocketReceiverBase::stopCallbackOffloading()
 {
     //Thread safe flag mutator
 
-    cout << "cSocketReceiverBase::stopCallbackOffloading()" << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::stopCallbackOffloading()";
+
+    m_bCallbackOffloadingEnabled.store(false);
+
+    notifyRunStateChange();
+}
+
+void cSocketReceiverBase::setThreadPlacement(threadRole eThread, const cThreadPlacement &oPlacement)
+{
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oThreadPlacementMutex);
+
+        if(eThread == THREAD_RECEIVING)
+            m_oReceivingThreadPlacement = oPlacement;
+        else
+            m_oOffloadingThreadPlacement = oPlacement;
+    }
+
+    //The receiving thread writes every packet so the buffer belongs on its node
+    if(eThread == THREAD_RECEIVING && oPlacement.getBindMemoryToNUMANode())
+    {
+        int32_t i32Node = oPlacement.getNUMANode();
+
+        if(i32Node < 0)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::setThreadPlacement(): Warning: NUMA node of the receiving thread's CPUs is unknown. Buffer memory is not bound.";
+            return;
+        }
+
+        m_oBuffer.bindToNUMANode(i32Node);
+    }
+}
+
+cThreadPlacement cSocketReceiverBase::getThreadPlacement(threadRole eThread)
+{
+    boost::unique_lock<boost::mutex> oLock(m_oThreadPlacementMutex);
+
+    if(eThread == THREAD_RECEIVING)
+        return m_oReceivingThreadPlacement;
+
+    return m_oOffloadingThreadPlacement;
+}
+
+void cSocketReceiverBase::setSocketOptions(const cSocketOptions &oOptions)
+{
+    boost::unique_lock<boost::mutex> oLock(m_oSocketOptionsMutex);
 
-    boost::unique_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-    m_bCallbackOffloadingEnabled = false;
+    m_oSocketOptions = oOptions;
+}
+
+cSocketOptions cSocketReceiverBase::getSocketOptions()
+{
+    boost::unique_lock<boost::mutex> oLock(m_oSocketOptionsMutex);
+
+    return m_oSocketOptions;
 }
 
 bool  cSocketReceiverBase::isReceivingEnabled()
 {
     //Thread safe accessor
 
-    boost::shared_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-    return m_bReceivingEnabled;
+    return m_bReceivingEnabled.load(boost::memory_order_relaxed);
 }
 
 bool  cSocketReceiverBase::isCallbackOffloadingEnabled()
 {
     //Thread safe accessor
 
-    boost::shared_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-    return m_bCallbackOffloadingEnabled;
+    return m_bCallbackOffloadingEnabled.load(boost::memory_order_relaxed);
 }
 
 void cSocketReceiverBase::shutdown()
 {
     //Thread safe flag mutator
 
-    {
-        boost::unique_lock<boost::shared_mutex>  oLock(m_oFlagMutex);
-        m_bShutdownFlag = true;
-    }
+    m_bShutdownFlag.store(true);
+
+    notifyRunStateChange();
+
+    //Also interrupt any blocking socket operations of the derived class
+    if(isReceivingEnabled())
+        stopReceiving();
 
     if(m_pSocketReceivingThread.get())
     {
@@ -128,157 +286,563 @@ bool cSocketReceiverBase::isShutdownRequested()
 {
     //Thread safe accessor
 
-    boost::shared_lock<boost::shared_mutex> oLock(m_oFlagMutex);
-    return m_bShutdownFlag;
+    return m_bShutdownFlag.load(boost::memory_order_relaxed);
 }
 
-int32_t cSocketReceiverBase::getNextPacketSize_B(uint32_t u32Timeout_ms)
+bool cSocketReceiverBase::isReceivingStopRequested()
 {
-    //Get (or wait for) the next available element to read data from
-    //If waiting, timeout every 500 ms and check for shutdown or stop streaming flags
-    //This prevents the program locking up in this thread.
+    return !isReceivingEnabled() || isShutdownRequested();
+}
 
-    //Current time:
-    boost::posix_time::ptime oStartTime = boost::posix_time::microsec_clock::local_time();
+bool cSocketReceiverBase::isCallbackOffloadingStopRequested()
+{
+    return !isCallbackOffloadingEnabled() || isShutdownRequested();
+}
 
-    int32_t i32Index = -1;
-    while(i32Index == -1)
+void cSocketReceiverBase::notifyRunStateChange()
+{
+    //Wake everything that may be blocked so that it re-evaluates the flags
+    m_oBuffer.interruptWaits();
+    m_oRunStateNotifier.notify();
+}
+
+uint32_t cSocketReceiverBase::waitForPackets(int32_t &i32FirstIndex, uint32_t u32MaxNPackets, uint32_t u32Timeout_ms, const string &strCaller)
+{
+    //Get (or wait for) the next available elements to read data from.
+    //The wait returns immediately if receiving is stopped or shutdown is requested.
+
+    if(isCallbackOffloadingEnabled())
     {
-        boost::posix_time::time_duration oDuration = boost::posix_time::microsec_clock::local_time() - oStartTime;
-        if(u32Timeout_ms && oDuration.total_milliseconds() >= u32Timeout_ms)
-        {
-            cout << "cSocketReceiverBase::getNextPacketSize_B(): Hit caller specified timeout. Returning." << endl;
-            return -1;
-        }
+        AVN_LOG(cLogger::SEVERITY_WARNING) << strCaller << ": Warning: Packets are being offloaded to callback handlers. Stop callback offloading to read packets directly.";
+        i32FirstIndex = -1;
+        return 0;
+    }
 
-        i32Index = m_oBuffer.getNextReadIndex(100);
+    uint32_t u32NAvailable = m_oBuffer.getNextReadIndices(i32FirstIndex, u32MaxNPackets, u32Timeout_ms, m_fReceivingStopCondition);
 
+    if(!u32NAvailable)
+    {
+        if(isReceivingStopRequested())
+            AVN_LOG(cLogger::SEVERITY_DEBUG) << strCaller << ": Got stop flag. Aborting...";
+        else
+            AVN_LOG(cLogger::SEVERITY_DEBUG) << strCaller << ": Hit caller specified timeout. Returning.";
     }
 
-    return m_oBuffer.getElementPointer(i32Index)->allocationSize();
+    return u32NAvailable;
+}
+
+int32_t cSocketReceiverBase::getNextPacketSize_B(uint32_t u32Timeout_ms)
+{
+    int32_t i32Index = -1;
+
+    if(!waitForPackets(i32Index, 1, u32Timeout_ms, string("cSocketReceiverBase::getNextPacketSize_B()")))
+        return -1;
+
+    return m_oBuffer.getElementPointer(i32Index)->dataSize();
 }
 
 bool cSocketReceiverBase::getNextPacket(char *cpData, uint32_t u32Timeout_ms, bool bPopData)
+{
+    cPacketRingBuffer::cMetadata oMetadata;
+
+    return getNextPacket(cpData, oMetadata, u32Timeout_ms, bPopData);
+}
+
+bool cSocketReceiverBase::getNextPacket(char *cpData, cPacketRingBuffer::cMetadata &oMetadata, uint32_t u32Timeout_ms, bool bPopData)
 {
     //By setting pop data to false this function can be used to peek into the front of the queue. Otherwise it reads
-    //data off the queue by default. Note bPopData = true should probably not be used concurrently with callback based
-    //offloading as this will results in inconsistent data distribution.
+    //data off the queue by default.
 
     //Note cpData should be of sufficient size to store data. Check with getNextPacketSize_B()
 
-    //Get (or wait for) the next available element to read data from
-    //If waiting timeout every 100 ms and check for shutdown or stop streaming flags
-    //This prevents the program locking up in this thread.
+    int32_t i32Index = -1;
 
-    //Current time:
-    boost::posix_time::ptime oStartTime = boost::posix_time::microsec_clock::local_time();
+    if(!waitForPackets(i32Index, 1, u32Timeout_ms, string("cSocketReceiverBase::getNextPacket()")))
+        return false;
 
-    int32_t i32Index = -1;
-    while(i32Index == -1)
+    memcpy(cpData, m_oBuffer.getElementDataPointer(i32Index), m_oBuffer.getElementPointer(i32Index)->dataSize());
+    oMetadata = m_oBuffer.getElementPointer(i32Index)->metadata();
+
+    if(bPopData)
+        m_oBuffer.elementRead(); //Signal to pop element off FIFO
+
+    return true;
+}
+
+uint32_t cSocketReceiverBase::getNextPackets(char *cpData, uint32_t u32DataSize_B, vector<uint32_t> &vu32PacketSizes_B, uint32_t u32MaxNPackets, uint32_t u32Timeout_ms)
+{
+    //Reads up to u32MaxNPackets packets (buffer elements) off the queue with a single wait. Packets are copied back to back
+    //into cpData (of size u32DataSize_B) and the size of each packet is returned in vu32PacketSizes_B. With datagram boundaries
+    //preserved (see cUDPReceiver) each packet is exactly one datagram. Returns the number of packets read, 0 on timeout or stop.
+
+    vu32PacketSizes_B.clear();
+
+    int32_t i32FirstIndex = -1;
+    uint32_t u32NAvailable = waitForPackets(i32FirstIndex, u32MaxNPackets, u32Timeout_ms, string("cSocketReceiverBase::getNextPackets()"));
+
+    if(!u32NAvailable)
+        return 0;
+
+    //Copy as many of the available packets as will fit
+    uint32_t u32NBufferElements = m_oBuffer.getNElements();
+    uint32_t u32Offset_B = 0;
+
+    for(uint32_t ui = 0; ui < u32NAvailable; ui++)
     {
-        boost::posix_time::time_duration oDuration = boost::posix_time::microsec_clock::local_time() - oStartTime;
-        if(u32Timeout_ms && oDuration.total_milliseconds() >= u32Timeout_ms)
-        {
-            cout << "cSocketReceiverBase::getNextPacket(): Hit caller specified timeout. Returning." << endl;
-            return false;
-        }
+        uint32_t u32Index = (i32FirstIndex + ui) % u32NBufferElements;
+        uint32_t u32PacketSize_B = m_oBuffer.getElementPointer(u32Index)->dataSize();
 
-        i32Index = m_oBuffer.getNextReadIndex(100);
+        if(u32Offset_B + u32PacketSize_B > u32DataSize_B)
+            break;
 
-        if(i32Index == -1)
-            cout << "Got semaphore timeout." << endl;
+        memcpy(cpData + u32Offset_B, m_oBuffer.getElementDataPointer(u32Index), u32PacketSize_B);
 
-        //Also check for shutdown flag
-        if(!isReceivingEnabled() || isShutdownRequested())
-        {
-            cout << "cSocketReceiverBase::getNextPacket(): Got stop flag. Aborting..." << endl;
-            return false;
-        }
+        vu32PacketSizes_B.push_back(u32PacketSize_B);
+        u32Offset_B += u32PacketSize_B;
     }
 
-    memcpy(cpData, m_oBuffer.getElementDataPointer(i32Index), m_oBuffer.getElementPointer(i32Index)->allocationSize());
+    if(vu32PacketSizes_B.empty())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::getNextPackets(): Warning: Destination buffer is too small for the next packet.";
+        return 0;
+    }
 
-    if(bPopData)
+    m_oBuffer.elementsRead(vu32PacketSizes_B.size()); //Signal to pop elements off FIFO
+
+    return vu32PacketSizes_B.size();
+}
+
+bool cSocketReceiverBase::borrowNextPacket(const char* &cpData, uint32_t &u32Size_B, uint32_t u32Timeout_ms)
+{
+    cPacketRingBuffer::cMetadata oMetadata;
+
+    return borrowNextPacket(cpData, u32Size_B, oMetadata, u32Timeout_ms);
+}
+
+bool cSocketReceiverBase::borrowNextPacket(const char* &cpData, uint32_t &u32Size_B, cPacketRingBuffer::cMetadata &oMetadata, uint32_t u32Timeout_ms)
+{
+    //Returns a pointer directly into the buffer element instead of copying it out as getNextPacket() does. The element is
+    //only popped off the FIFO when the caller calls releasePacket() so the receiving thread cannot overwrite it in the mean time.
+
+    if(m_bPacketBorrowed)
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::borrowNextPacket(): Warning: Previous packet not released. Releasing it now.";
+        releasePacket();
+    }
+
+    int32_t i32Index = -1;
+
+    if(!waitForPackets(i32Index, 1, u32Timeout_ms, string("cSocketReceiverBase::borrowNextPacket()")))
+        return false;
+
+    cpData = m_oBuffer.getElementDataPointer(i32Index);
+    u32Size_B = m_oBuffer.getElementPointer(i32Index)->dataSize();
+    oMetadata = m_oBuffer.getElementPointer(i32Index)->metadata();
+
+    m_bPacketBorrowed = true;
+
+    return true;
+}
+
+void cSocketReceiverBase::releasePacket()
+{
+    if(!m_bPacketBorrowed)
+        return;
+
+    m_bPacketBorrowed = false;
+
+    m_oBuffer.elementRead(); //Signal to pop element off FIFO
+}
+
+uint32_t cSocketReceiverBase::waitForFreeElements(int32_t &i32FirstIndex, uint32_t u32MaxNElements)
+{
+    //Get (or wait for) as many consecutive free elements as are available up to u32MaxNElements.
+    //The wait is interrupted as soon as receiving is stopped or shutdown is requested. Only waits are timed.
+
+    if(m_oBuffer.tryToGetNextWriteIndex() != -1)
+        return m_oBuffer.getNextWriteIndices(i32FirstIndex, u32MaxNElements, 0, m_fReceivingStopCondition);
+
+    boost::posix_time::ptime oStartTime = boost::posix_time::microsec_clock::universal_time();
+
+    uint32_t u32NElements = m_oBuffer.getNextWriteIndices(i32FirstIndex, u32MaxNElements, 0, m_fReceivingStopCondition);
+
+    m_u64BufferFullWaitTime_us.fetch_add((boost::posix_time::microsec_clock::universal_time() - oStartTime).total_microseconds(), boost::memory_order_relaxed);
+
+    return u32NElements;
+}
+
+void cSocketReceiverBase::elementsReceived(uint32_t u32NElements)
+{
+    //Signal we have filled elements of the input buffer.
+    m_oBuffer.elementsWritten(u32NElements);
+
+    //Only the receiving thread raises the high water mark
+    uint32_t u32Level = m_oBuffer.getLevel();
+
+    if(u32Level > m_u32BufferHighWaterMark.load(boost::memory_order_relaxed))
+        m_u32BufferHighWaterMark.store(u32Level, boost::memory_order_relaxed);
+
+    if(m_bBufferAutoTuning.load(boost::memory_order_relaxed))
+        autoTuneBuffer(u32NElements, u32Level);
+}
+
+void cSocketReceiverBase::autoTuneBuffer(uint32_t u32NElementsReceived, uint32_t u32Level)
+{
+    //Receiving thread only
+
+    m_u64AutoTuningNElements += u32NElementsReceived;
+
+    if(u32Level > m_u32AutoTuningPeakLevel)
+        m_u32AutoTuningPeakLevel = u32Level;
+
+    //Only look at the clock every so often
+    if(++m_u32AutoTuningNCalls < 256)
+        return;
+
+    m_u32AutoTuningNCalls = 0;
+
+    boost::posix_time::ptime oNow = boost::posix_time::microsec_clock::universal_time();
+
+    if(m_oAutoTuningLastTime.is_not_a_date_time())
+    {
+        m_oAutoTuningLastTime = oNow;
+        m_u64AutoTuningNElements = 0;
+        m_u32AutoTuningPeakLevel = 0;
+        return;
+    }
+
+    int64_t i64Interval_us = (oNow - m_oAutoTuningLastTime).total_microseconds();
+
+    if(i64Interval_us < 1000000)
+        return;
+
+    uint32_t u32NBufferElements = m_oBuffer.getNElements();
+
+    //Elements needed to hold the headroom at the observed rate
+    uint64_t u64Target = m_u64AutoTuningNElements * m_u32AutoTuningHeadroom_ms.load() * 1000 / i64Interval_us;
+
+    //Consumers are falling behind
+    if(m_u32AutoTuningPeakLevel >= u32NBufferElements / 4 * 3 && u64Target < 2 * (uint64_t)u32NBufferElements)
+        u64Target = 2 * (uint64_t)u32NBufferElements;
+
+    uint32_t u32NElements = m_u32AutoTuningMinNElements.load();
+    uint32_t u32MaxNElements = m_u32AutoTuningMaxNElements.load();
+
+    while(u32NElements < u64Target && u32NElements <= u32MaxNElements / 2)
+        u32NElements *= 2;
+
+    //Grow whenever needed but only shrink if well oversized
+    if(u32NElements > u32NBufferElements || (u32NElements <= u32NBufferElements / 4 && m_u32AutoTuningPeakLevel < u32NElements / 2))
     {
-        if(m_bCallbackOffloadingEnabled)
+        if(!m_oBuffer.isResizePending())
         {
-            cout << "cSocketReceiverBase::getNextPacket(): Warning. Popping data while callback offloading is enabled. Data may be insistency distributed amongst destinations." << endl;
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::autoTuneBuffer(): Resizing buffer from " << u32NBufferElements << " to " << u32NElements
+                                            << " elements. Rate " << m_u64AutoTuningNElements * 1000000 / i64Interval_us << " elements/s, peak level " << m_u32AutoTuningPeakLevel << ".";
+
+            m_oBuffer.requestResize(u32NElements, m_oBuffer.getElementSize_B());
         }
-        m_oBuffer.elementRead(); //Signal to pop element off FIFO
     }
 
-    return true;
+    m_oAutoTuningLastTime = oNow;
+    m_u64AutoTuningNElements = 0;
+    m_u32AutoTuningPeakLevel = 0;
+}
+
+void cSocketReceiverBase::addReceivedData(uint32_t u32NPackets, uint64_t u64NBytes)
+{
+    m_u64NPacketsReceived.fetch_add(u32NPackets, boost::memory_order_relaxed);
+    m_u64NBytesReceived.fetch_add(u64NBytes, boost::memory_order_relaxed);
+}
+
+void cSocketReceiverBase::addSocketError()
+{
+    m_u64NSocketErrors.fetch_add(1, boost::memory_order_relaxed);
+}
+
+void cSocketReceiverBase::addTruncatedPacket()
+{
+    m_u64NTruncatedPackets.fetch_add(1, boost::memory_order_relaxed);
+}
+
+cSocketReceiverBase::cStatistics::cStatistics() :
+    m_u64NPacketsReceived(0),
+    m_u64NBytesReceived(0),
+    m_u64NSocketErrors(0),
+    m_u64NTruncatedPackets(0),
+    m_u32BufferSize(0),
+    m_u32BufferLevel(0),
+    m_u32BufferHighWaterMark(0),
+    m_u64BufferFullWaitTime_us(0),
+    m_u64NCallbacks(0),
+    m_u64CallbackTime_us(0)
+{
+}
+
+cSocketReceiverBase::cStatistics cSocketReceiverBase::getStatistics()
+{
+    //Each counter is read atomically but the snapshot as a whole is not taken at a single instant.
+
+    cStatistics oStatistics;
+
+    oStatistics.m_u64NPacketsReceived = m_u64NPacketsReceived.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NBytesReceived = m_u64NBytesReceived.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NSocketErrors = m_u64NSocketErrors.load(boost::memory_order_relaxed);
+    oStatistics.m_u64NTruncatedPackets = m_u64NTruncatedPackets.load(boost::memory_order_relaxed);
+
+    oStatistics.m_u32BufferSize = m_oBuffer.getNElements();
+    oStatistics.m_u32BufferLevel = m_oBuffer.getLevel();
+    oStatistics.m_u32BufferHighWaterMark = m_u32BufferHighWaterMark.load(boost::memory_order_relaxed);
+    oStatistics.m_u64BufferFullWaitTime_us = m_u64BufferFullWaitTime_us.load(boost::memory_order_relaxed);
+
+    oStatistics.m_u64NCallbacks = m_u64NCallbacks.load(boost::memory_order_relaxed);
+    oStatistics.m_u64CallbackTime_us = m_u64CallbackTime_us.load(boost::memory_order_relaxed);
+
+    return oStatistics;
+}
+
+void cSocketReceiverBase::resetStatistics()
+{
+    m_u64NPacketsReceived.store(0);
+    m_u64NBytesReceived.store(0);
+    m_u64NSocketErrors.store(0);
+    m_u64NTruncatedPackets.store(0);
+    m_u32BufferHighWaterMark.store(0);
+    m_u64BufferFullWaitTime_us.store(0);
+    m_u64NCallbacks.store(0);
+    m_u64CallbackTime_us.store(0);
+}
+
+cSocketReceiverBase::cDataCallbackDispatcher::cDataCallbackDispatcher(boost::shared_ptr<cDataCallbackInterface> pHandler, uint32_t u32ReadCursor) :
+    m_pHandler(pHandler),
+    m_u32ReadCursor(u32ReadCursor),
+    m_bStopFlag(false)
+{
 }
 
 void cSocketReceiverBase::dataOffloadingThreadFunction()
 {
-    cout << "Entered cSocketReceiverBase::dataOffloadingThreadFuncton()." << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Entered cSocketReceiverBase::dataOffloadingThreadFuncton().";
 
-    while(isCallbackOffloadingEnabled() && !isShutdownRequested())
+    //Start a dispatcher for every registered handler and keep the set of dispatchers in line with the handler list until
+    //offloading is stopped. Packets still in the buffer go to the initial handlers, handlers added later start with the next
+    //packet received.
+
+    vector<boost::shared_ptr<cDataCallbackDispatcher> > vpDispatchers;
+    bool bInitialHandlers = true;
+
+    cThreadPlacement oDispatcherPlacement = getThreadPlacement(THREAD_OFFLOADING);
+
+    while(!isCallbackOffloadingStopRequested())
     {
-        //Get (or wait for) the next available element to read data from
-        //If waiting timeout every 500 ms and check for shutdown or stop streaming flags
-        //This prevents the program locking up in this thread.
-        int32_t i32Index = -1;
-        while(i32Index == -1)
-        {
-            i32Index = m_oBuffer.getNextReadIndex(500);
+        //Register for wakeups before reading the handler list so that no (de)registration is missed
+        uint64_t u64Epoch = m_oRunStateNotifier.prepareWait();
+
+        boost::shared_ptr<const dataCallbackHandlerList> pHandlers = getDataCallbackHandlers();
 
-            //Also check for shutdown flag
-            if(!m_bCallbackOffloadingEnabled || isShutdownRequested())
+        //Stop dispatchers of handlers that have been deregistered
+        for(uint32_t ui = 0; ui < vpDispatchers.size();)
+        {
+            if(find(pHandlers->begin(), pHandlers->end(), vpDispatchers[ui]->m_pHandler) == pHandlers->end())
+            {
+                stopDataCallbackDispatcher(vpDispatchers[ui]);
+                vpDispatchers.erase(vpDispatchers.begin() + ui);
+            }
+            else
             {
-                cout << "cSocketReceiverBase::dataOffloadingThreadFunction(): Got stop flag. Aborting..." << endl;
-                return;
+                ui++;
             }
         }
 
+        //Start dispatchers for new handlers
+        for(uint32_t ui = 0; ui < pHandlers->size(); ui++)
         {
-            boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+            bool bFound = false;
 
-            for(uint32_t ui = 0; ui < m_vpDataCallbackHandlers.size(); ui++)
+            for(uint32_t uj = 0; uj < vpDispatchers.size(); uj++)
             {
-                m_vpDataCallbackHandlers[ui]->offloadData_callback(m_oBuffer.getElementDataPointer(i32Index), m_oBuffer.getElementPointer(i32Index)->allocationSize());
+                if(vpDispatchers[uj]->m_pHandler == (*pHandlers)[ui])
+                {
+                    bFound = true;
+                    break;
+                }
             }
+
+            if(bFound)
+                continue;
+
+            int32_t i32ReadCursor = m_oBuffer.addReadCursor(bInitialHandlers);
+
+            if(i32ReadCursor == -1)
+            {
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::dataOffloadingThreadFunction(): Warning: No buffer read cursor available for callback handler "
+                                                   << (*pHandlers)[ui].get() << ". Handler will not be called.";
+                continue;
+            }
+
+            boost::shared_ptr<cDataCallbackDispatcher> pDispatcher(new cDataCallbackDispatcher((*pHandlers)[ui], i32ReadCursor));
+            pDispatcher->m_pThread.reset(new boost::thread(&cSocketReceiverBase::dataCallbackDispatchThreadFunction, this, pDispatcher));
+            oDispatcherPlacement.apply(*pDispatcher->m_pThread, string("callback dispatch"));
+
+            vpDispatchers.push_back(pDispatcher);
         }
 
-        m_oBuffer.elementRead(); //Signal to pop element off FIFO
+        //The dispatchers now own the read side of the buffer
+        if(bInitialHandlers)
+        {
+            m_oBuffer.deactivateReadCursor(cPacketRingBuffer::PRIMARY_READ_CURSOR);
+            bInitialHandlers = false;
+        }
+
+        if(isCallbackOffloadingStopRequested())
+        {
+            m_oRunStateNotifier.cancelWait();
+            break;
+        }
+
+        m_oRunStateNotifier.wait(u64Epoch);
     }
 
-    cout << "Exiting cSocketReceiverBase::dataOffloadingThreadFunction()." << endl;
+    //Hand the buffer back to the pull interface from the oldest packet not yet seen by all handlers
+    if(!bInitialHandlers)
+        m_oBuffer.activateReadCursor(cPacketRingBuffer::PRIMARY_READ_CURSOR, true);
+
+    for(uint32_t ui = 0; ui < vpDispatchers.size(); ui++)
+    {
+        stopDataCallbackDispatcher(vpDispatchers[ui]);
+    }
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Exiting cSocketReceiverBase::dataOffloadingThreadFunction().";
 }
 
-void cSocketReceiverBase::registerDataCallbackHandler(boost::shared_ptr<cDataCallbackInterface> pNewHandler)
+void cSocketReceiverBase::dataCallbackDispatchThreadFunction(boost::shared_ptr<cDataCallbackDispatcher> pDispatcher)
 {
-    boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Entered cSocketReceiverBase::dataCallbackDispatchThreadFunction() for callback handler " << pDispatcher->m_pHandler.get() << ".";
+
+    //Consume packets in small batches to save on buffer synchronisation while still freeing elements promptly
+    const uint32_t u32MaxBatchSize = 16;
 
-    m_vpDataCallbackHandlers.push_back(pNewHandler);
+    cPacketRingBuffer::abortCondition fStopCondition = boost::bind(&cSocketReceiverBase::isDispatchStopRequested, this, pDispatcher.get());
 
-    cout << "cSocketReceiverBase::registerDataCallbackHandler(): Successfully registered callback handler: " << pNewHandler.get() << endl;
+    while(true)
+    {
+        //Get (or wait for) the next available elements to read data from
+        //The wait is interrupted as soon as offloading is stopped, shutdown is requested or the handler is deregistered.
+        int32_t i32FirstIndex = -1;
+        uint32_t u32NAvailable = m_oBuffer.getNextReadIndicesForCursor(pDispatcher->m_u32ReadCursor, i32FirstIndex, u32MaxBatchSize, 0, fStopCondition);
+
+        if(!u32NAvailable)
+            break;
+
+        //The buffer may be resized at any time. Elements already handed out keep their indices (see cPacketRingBuffer::requestResize()).
+        uint32_t u32NBufferElements = m_oBuffer.getNElements();
+
+        boost::posix_time::ptime oStartTime = boost::posix_time::microsec_clock::universal_time();
+
+        for(uint32_t ui = 0; ui < u32NAvailable; ui++)
+        {
+            uint32_t u32Index = (i32FirstIndex + ui) % u32NBufferElements;
+
+            cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(u32Index);
+
+            pDispatcher->m_pHandler->offloadDataAndMetadata_callback(pElement->getDataPointer(), pElement->dataSize(), pElement->metadata());
+        }
+
+        m_u64NCallbacks.fetch_add(u32NAvailable, boost::memory_order_relaxed);
+        m_u64CallbackTime_us.fetch_add((boost::posix_time::microsec_clock::universal_time() - oStartTime).total_microseconds(), boost::memory_order_relaxed);
+
+        m_oBuffer.elementsReadForCursor(pDispatcher->m_u32ReadCursor, u32NAvailable); //Signal to pop elements off this handler's FIFO
+    }
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Exiting cSocketReceiverBase::dataCallbackDispatchThreadFunction() for callback handler " << pDispatcher->m_pHandler.get() << ".";
+}
+
+bool cSocketReceiverBase::isDispatchStopRequested(cDataCallbackDispatcher *pDispatcher)
+{
+    return pDispatcher->m_bStopFlag.load(boost::memory_order_relaxed) || isCallbackOffloadingStopRequested();
+}
+
+void cSocketReceiverBase::stopDataCallbackDispatcher(boost::shared_ptr<cDataCallbackDispatcher> pDispatcher)
+{
+    pDispatcher->m_bStopFlag.store(true);
+
+    m_oBuffer.interruptWaits();
+
+    pDispatcher->m_pThread->join();
+
+    //Release any elements held only by this handler
+    m_oBuffer.deactivateReadCursor(pDispatcher->m_u32ReadCursor);
+}
+
+bool cSocketReceiverBase::registerDataCallbackHandler(boost::shared_ptr<cDataCallbackInterface> pNewHandler)
+{
+    {
+        boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+
+        //Deregistered handlers give back their cursors before new ones take theirs so the list length is the limit
+        if(m_pDataCallbackHandlers->size() >= MAX_DATA_CALLBACK_HANDLERS)
+        {
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cSocketReceiverBase::registerDataCallbackHandler(): Error: Unable to register callback handler: " << pNewHandler.get()
+                                             << ". The maximum of " << m_pDataCallbackHandlers->size() << " handlers are registered.";
+            return false;
+        }
+
+        boost::shared_ptr<dataCallbackHandlerList> pHandlers(new dataCallbackHandlerList(*m_pDataCallbackHandlers));
+        pHandlers->push_back(pNewHandler);
+
+        m_pDataCallbackHandlers = pHandlers;
+    }
+
+    //Let the offloading thread start a dispatcher for the new handler
+    m_oRunStateNotifier.notify();
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::registerDataCallbackHandler(): Successfully registered callback handler: " << pNewHandler.get();
+
+    return true;
 }
 
 void cSocketReceiverBase::deregisterDataCallbackHandler(boost::shared_ptr<cDataCallbackInterface> pHandler)
 {
-    boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
     bool bSuccess = false;
 
-    //Search for matching pointer values and erase
-    for(uint32_t ui = 0; ui < m_vpDataCallbackHandlers.size();)
     {
-        if(m_vpDataCallbackHandlers[ui].get() == pHandler.get())
-        {
-            m_vpDataCallbackHandlers.erase(m_vpDataCallbackHandlers.begin() + ui);
+        boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
 
-            cout << "cSocketReceiverBase::deregisterDataCallbackHandler(): Deregistered callback handler: " << pHandler.get() << endl;
-            bSuccess = true;
-        }
-        else
+        boost::shared_ptr<dataCallbackHandlerList> pHandlers(new dataCallbackHandlerList(*m_pDataCallbackHandlers));
+
+        //Search for matching pointer values and erase
+        for(uint32_t ui = 0; ui < pHandlers->size();)
         {
-            ui++;
+            if((*pHandlers)[ui].get() == pHandler.get())
+            {
+                pHandlers->erase(pHandlers->begin() + ui);
+
+                AVN_LOG(cLogger::SEVERITY_INFO) << "cSocketReceiverBase::deregisterDataCallbackHandler(): Deregistered callback handler: " << pHandler.get();
+                bSuccess = true;
+            }
+            else
+            {
+                ui++;
+            }
         }
+
+        m_pDataCallbackHandlers = pHandlers;
     }
 
     if(!bSuccess)
     {
-        cout << "cSocketReceiverBase::deregisterDataCallbackHandler(): Warning: Deregistering callback handler: " << pHandler.get() << " failed. Object instance not found." << endl;
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cSocketReceiverBase::deregisterDataCallbackHandler(): Warning: Deregistering callback handler: " << pHandler.get() << " failed. Object instance not found.";
+        return;
     }
+
+    //Let the offloading thread stop the handler's dispatcher. The handler may still be called until that has happened.
+    m_oRunStateNotifier.notify();
+}
+
+boost::shared_ptr<const cSocketReceiverBase::dataCallbackHandlerList> cSocketReceiverBase::getDataCallbackHandlers()
+{
+    //Returns a snapshot of the handler list which stays valid (and unchanged) for as long as it is held.
+
+    boost::shared_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+
+    return m_pDataCallbackHandlers;
 }
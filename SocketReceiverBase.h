@@ -25,10 +25,16 @@ typedef unsigned __int64 uint64_t;
 #include <boost/scoped_ptr.hpp>
 #include <boost/shared_array.hpp>
 #include <boost/thread/shared_mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
 #endif
 
 //Local includes
-#include "../../AVNUtilLibs/DataStructures/ThreadSafeCircularBuffer/ThreadSafeCircularBuffer.h"
+#include "PacketRingBuffer/PacketRingBuffer.h"
+#include "EventNotifier/EventNotifier.h"
+#include "ThreadPlacement/ThreadPlacement.h"
+#include "SocketOptions/SocketOptions.h"
 
 class cSocketReceiverBase
 {
@@ -37,10 +43,53 @@ public:
     {
     public:
         virtual void offloadData_callback(char* pData, uint32_t u32Size_B) = 0;
+
+        //Called instead of offloadData_callback() with the packet's metadata (sender, receive time). Override to use it.
+        virtual void offloadDataAndMetadata_callback(char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata)
+        {
+            (void)oMetadata;
+            offloadData_callback(pData, u32Size_B);
+        }
     };
 
 
-    explicit cSocketReceiverBase(const std::string &strPeerAddress, uint16_t usPeerPort = 60001);
+    typedef std::vector<boost::shared_ptr<cDataCallbackInterface> >         dataCallbackHandlerList;
+
+    //Snapshot of the receiver's counters. See getStatistics().
+    class cStatistics
+    {
+    public:
+        cStatistics();
+
+        uint64_t                                                            m_u64NPacketsReceived; //Socket reads or datagrams
+        uint64_t                                                            m_u64NBytesReceived;
+        uint64_t                                                            m_u64NSocketErrors;
+        uint64_t                                                            m_u64NTruncatedPackets; //Datagrams larger than the space left in their element
+
+        uint32_t                                                            m_u32BufferSize; //Elements
+        uint32_t                                                            m_u32BufferLevel;
+        uint32_t                                                            m_u32BufferHighWaterMark;
+        uint64_t                                                            m_u64BufferFullWaitTime_us; //Time the receiving thread waited for a free element
+
+        uint64_t                                                            m_u64NCallbacks;
+        uint64_t                                                            m_u64CallbackTime_us; //Summed over all data callback handlers
+    };
+
+    enum threadRole
+    {
+        THREAD_RECEIVING = 0,
+        THREAD_OFFLOADING //The offloading thread and the callback dispatchers
+    };
+
+    //1024 elements of 1040 bytes for each complex uint32_t FFT window of 2 channels or I,Q,U,V uint32_t stokes parameters
+    static const uint32_t                                                   DEFAULT_BUFFER_N_ELEMENTS = 1024;
+    static const uint32_t                                                   DEFAULT_BUFFER_ELEMENT_SIZE_B = 1040;
+
+    //The primary read cursor is in use until the dispatchers have started
+    static const uint32_t                                                   MAX_DATA_CALLBACK_HANDLERS = cPacketRingBuffer::MAX_READ_CURSORS - 1;
+
+    explicit cSocketReceiverBase(const std::string &strPeerAddress, uint16_t usPeerPort = 60001, uint32_t u32BufferNElements = DEFAULT_BUFFER_N_ELEMENTS,
+                                 uint32_t u32BufferElementSize_B = DEFAULT_BUFFER_ELEMENT_SIZE_B);
     virtual ~cSocketReceiverBase();
 
     void                                                                    startReceiving();
@@ -55,42 +104,160 @@ public:
     void                                                                    shutdown();
     bool                                                                    isShutdownRequested();
 
-    void                                                                    clearBuffer();
+    void                                                                    clearBuffer(); //Not while offloading
+
+    //Select the synchronisation backend of the buffer (see cPacketRingBuffer). BACKEND_LOCK_FREE_SPSC requires that packets
+    //are consumed by one thread only, i.e. either callback offloading or one pull consumer. Only change while stopped.
+    void                                                                    setBufferBackend(cPacketRingBuffer::backend eBackend);
+
+    //Change the buffer geometry at any time without losing queued packets. Larger elements are used straight away, other
+    //changes as soon as the queued packets allow (see cPacketRingBuffer::requestResize()).
+    void                                                                    setBufferGeometry(uint32_t u32NElements, uint32_t u32ElementSize_B);
+
+    //Let the receiving thread size the buffer (number of elements) by itself: large enough to hold u32Headroom_ms of packets at
+    //the observed rate and, if the consumers fall behind by more than 3/4 of the buffer, twice as large. The buffer is shrunk
+    //again once a quarter of it would do. Re-evaluated about once a second. Sizes are powers of 2 within the given limits.
+    void                                                                    setBufferAutoTuning(bool bEnable, uint32_t u32Headroom_ms = 100, uint32_t u32MinNElements = 256,
+                                                                                                uint32_t u32MaxNElements = 65536);
+
+    //Back the buffer with a single locked, cache aligned slab on huge pages where available (see cMemorySlab) rather than a
+    //heap allocation per element. Only change while stopped.
+    void                                                                    setBufferAllocationMode(cPacketRingBuffer::allocationMode eMode);
+
+    //Low latency mode: The receiving and offloading threads and pull consumers spin on the buffer for up to this long before
+    //blocking (see cPacketRingBuffer::setSpinTime()) and cUDPReceiver polls its socket without blocking for as long. Costs a
+    //busy core per thread so pin the threads (setThreadPlacement()). 0 (default) disables. Can be changed at any time.
+    void                                                                    setSpinTime(uint32_t u32SpinTime_us);
+    uint32_t                                                                getSpinTime_us();
 
-    int32_t getNextPacketSize_B(uint32_t u32Timeout_ms = 0);
+    //Pull interface. Not available while callback offloading is enabled as the handlers then own the buffer's read side.
+    //The overloads taking a cPacketRingBuffer::cMetadata also return the packet's sender and receive time.
+    int32_t                                                                 getNextPacketSize_B(uint32_t u32Timeout_ms = 0);
     bool                                                                    getNextPacket(char *cpData, uint32_t u32Timeout_ms = 0, bool bPopData = true);
+    bool                                                                    getNextPacket(char *cpData, cPacketRingBuffer::cMetadata &oMetadata, uint32_t u32Timeout_ms = 0, bool bPopData = true);
+    uint32_t                                                                getNextPackets(char *cpData, uint32_t u32DataSize_B, std::vector<uint32_t> &vu32PacketSizes_B, uint32_t u32MaxNPackets, uint32_t u32Timeout_ms = 0);
 
-    void                                                                    registerDataCallbackHandler(boost::shared_ptr<cDataCallbackInterface> pNewHandler);
+    //Zero copy access: Borrow a read only view of the next packet in the buffer. The buffer element is held
+    //until releasePacket() is called after which the pointer is no longer valid. Only one packet can be borrowed at a time.
+    bool                                                                    borrowNextPacket(const char* &cpData, uint32_t &u32Size_B, uint32_t u32Timeout_ms = 0);
+    bool                                                                    borrowNextPacket(const char* &cpData, uint32_t &u32Size_B, cPacketRingBuffer::cMetadata &oMetadata, uint32_t u32Timeout_ms = 0);
+    void                                                                    releasePacket();
+
+    //The counters are atomics updated by the receiving and offloading threads. Reading them takes no locks. They are reset
+    //by startReceiving() and resetStatistics().
+    cStatistics                                                             getStatistics();
+    void                                                                    resetStatistics();
+
+    //CPU affinity and scheduling of the streamer threads. Takes effect when the threads are next started (dispatchers when
+    //they are next created). If the receiving placement asks for NUMA binding the buffer is moved to its node immediately
+    //(locked slab allocation only, see cPacketRingBuffer::bindToNUMANode()).
+    void                                                                    setThreadPlacement(threadRole eThread, const cThreadPlacement &oPlacement);
+    cThreadPlacement                                                        getThreadPlacement(threadRole eThread);
+
+    //Socket options applied whenever the receiver opens its socket (see cSocketOptions). Takes effect on the next bind or
+    //connection.
+    void                                                                    setSocketOptions(const cSocketOptions &oOptions);
+    cSocketOptions                                                          getSocketOptions();
+
+    //Each handler is fed through its own buffer read cursor. Returns false if MAX_DATA_CALLBACK_HANDLERS are registered already.
+    bool                                                                    registerDataCallbackHandler(boost::shared_ptr<cDataCallbackInterface> pNewHandler);
     void                                                                    deregisterDataCallbackHandler(boost::shared_ptr<cDataCallbackInterface> pHandler);
+    boost::shared_ptr<const dataCallbackHandlerList>                        getDataCallbackHandlers();
 
 protected:
     std::string                                                             m_strPeerAddress;
     uint16_t                                                                m_u16PeerPort;
 
-    bool                                                                    m_bReceivingEnabled;
-    bool                                                                    m_bCallbackOffloadingEnabled;
-    bool                                                                    m_bShutdownFlag;
-    boost::shared_mutex                                                     m_oFlagMutex;
+    //Run state flags. These are polled for every packet so they are atomics rather than mutex protected.
+    boost::atomic<bool>                                                     m_bReceivingEnabled;
+    boost::atomic<bool>                                                     m_bCallbackOffloadingEnabled;
+    boost::atomic<bool>                                                     m_bShutdownFlag;
+
+    //Wakes threads blocked on the buffer or on sockets (via its file descriptor) when a run state flag changes
+    cEventNotifier                                                          m_oRunStateNotifier;
+    void                                                                    notifyRunStateChange();
+
+    bool                                                                    isReceivingStopRequested();
+    bool                                                                    isCallbackOffloadingStopRequested();
+
+    //Abort conditions for buffer waits
+    cPacketRingBuffer::abortCondition                                       m_fReceivingStopCondition;
+    cPacketRingBuffer::abortCondition                                       m_fCallbackOffloadingStopCondition;
     boost::shared_mutex                                                     m_oCallbackHandlersMutex;
 
-    //Callback handlers
-    std::vector<boost::shared_ptr<cDataCallbackInterface> >                 m_vpDataCallbackHandlers;
+    //Callback handlers. The list is never modified in place: (de)registration publishes a new copy so that the dispatch
+    //threads only need the mutex for as long as it takes to copy the pointer.
+    boost::shared_ptr<const dataCallbackHandlerList>                        m_pDataCallbackHandlers;
+
+    //Each callback handler is served by its own thread reading the buffer through its own read cursor so that a slow handler
+    //does not delay the others. An element is freed once all handlers have been called with it.
+    class cDataCallbackDispatcher
+    {
+    public:
+        cDataCallbackDispatcher(boost::shared_ptr<cDataCallbackInterface> pHandler, uint32_t u32ReadCursor);
+
+        boost::shared_ptr<cDataCallbackInterface>                           m_pHandler;
+        uint32_t                                                            m_u32ReadCursor;
+        boost::atomic<bool>                                                 m_bStopFlag;
+        boost::scoped_ptr<boost::thread>                                    m_pThread;
+    };
 
     //Threads
     boost::scoped_ptr<boost::thread>                                        m_pSocketReceivingThread;
     boost::scoped_ptr<boost::thread>                                        m_pDataOffloadingThread;
 
+    boost::mutex                                                            m_oThreadPlacementMutex;
+    cThreadPlacement                                                        m_oReceivingThreadPlacement;
+    cThreadPlacement                                                        m_oOffloadingThreadPlacement;
+
+    boost::mutex                                                            m_oSocketOptionsMutex;
+    cSocketOptions                                                          m_oSocketOptions;
+
     //Derived class will need some sort of socket here.
 
     //Thread functions
     virtual void                                                            socketReceivingThreadFunction() = 0; //Implement socket receiving here
-    void                                                                    dataOffloadingThreadFunction();
+    void                                                                    dataOffloadingThreadFunction(); //Starts and stops dispatchers as handlers come and go
+    void                                                                    dataCallbackDispatchThreadFunction(boost::shared_ptr<cDataCallbackDispatcher> pDispatcher);
+    bool                                                                    isDispatchStopRequested(cDataCallbackDispatcher *pDispatcher);
+    void                                                                    stopDataCallbackDispatcher(boost::shared_ptr<cDataCallbackDispatcher> pDispatcher);
+
+    uint32_t                                                                waitForPackets(int32_t &i32FirstIndex, uint32_t u32MaxNPackets, uint32_t u32Timeout_ms, const std::string &strCaller);
+
+    //For the receiving thread of derived classes: Buffer access that keeps the statistics
+    uint32_t                                                                waitForFreeElements(int32_t &i32FirstIndex, uint32_t u32MaxNElements);
+    void                                                                    elementsReceived(uint32_t u32NElements);
+    void                                                                    addReceivedData(uint32_t u32NPackets, uint64_t u64NBytes);
+    void                                                                    addSocketError();
+    void                                                                    addTruncatedPacket();
+
+    //Statistics
+    boost::atomic<uint64_t>                                                 m_u64NPacketsReceived;
+    boost::atomic<uint64_t>                                                 m_u64NBytesReceived;
+    boost::atomic<uint64_t>                                                 m_u64NSocketErrors;
+    boost::atomic<uint64_t>                                                 m_u64NTruncatedPackets;
+    boost::atomic<uint32_t>                                                 m_u32BufferHighWaterMark;
+    boost::atomic<uint64_t>                                                 m_u64BufferFullWaitTime_us;
+    boost::atomic<uint64_t>                                                 m_u64NCallbacks;
+    boost::atomic<uint64_t>                                                 m_u64CallbackTime_us;
+
+    //Buffer auto tuning. Settings are atomics, the state is only used by the receiving thread.
+    boost::atomic<bool>                                                     m_bBufferAutoTuning;
+    boost::atomic<uint32_t>                                                 m_u32AutoTuningHeadroom_ms;
+    boost::atomic<uint32_t>                                                 m_u32AutoTuningMinNElements;
+    boost::atomic<uint32_t>                                                 m_u32AutoTuningMaxNElements;
+    uint32_t                                                                m_u32AutoTuningNCalls;
+    uint32_t                                                                m_u32AutoTuningPeakLevel;
+    uint64_t                                                                m_u64AutoTuningNElements;
+    boost::posix_time::ptime                                                m_oAutoTuningLastTime;
+
+    void                                                                    autoTuneBuffer(uint32_t u32NElementsReceived, uint32_t u32Level);
 
     int32_t                                                                 m_i32GetRawDataInputBufferIndex;
-    uint64_t                                                                u64TotalBytesProcessed;
+    bool                                                                    m_bPacketBorrowed;
 
     //Circular buffers
-    cThreadSafeCircularBuffer<char>                                         m_oBuffer;
+    cPacketRingBuffer                                                       m_oBuffer;
 
 };
 
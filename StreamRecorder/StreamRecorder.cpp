@@ -0,0 +1,544 @@
+//System includes
+#include <cstring>
+#include <cerrno>
+#include <sstream>
+#include <iomanip>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <time.h>
+
+//Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#endif
+
+//Local includes
+#include "StreamRecorder.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+namespace
+{
+    const char      FILE_MAGIC[8] = { 'A', 'V', 'N', 'R', 'E', 'C', '0', '1' };
+    const uint32_t  BLOCK_MAGIC = 0x424E5641; //"AVNB"
+    const uint32_t  FILE_OPEN_RETRY_INTERVAL_MS = 1000; //After a file could not be opened or written
+}
+
+cStreamRecorder::cStreamRecorder(const string &strFilenamePrefix, const string &strSourceDescription, uint32_t u32SourceId,
+                                 uint32_t u32BlockSize_B, uint32_t u32NBlocks) :
+    m_strFilenamePrefix(strFilenamePrefix),
+    m_strSourceDescription(strSourceDescription),
+    m_u32SourceId(u32SourceId),
+    m_u32BlockSize_B((u32BlockSize_B + BLOCK_ALIGNMENT_B - 1) / BLOCK_ALIGNMENT_B * BLOCK_ALIGNMENT_B),
+    m_u64MaxFileSize_B(0),
+    m_u32MaxFileDuration_s(0),
+    m_bDirectIO(false),
+    m_u32FlushInterval_ms(1000),
+    //Over allocate each block so that it can be aligned for direct IO
+    m_oBlocks(u32NBlocks < 2 ? 2 : u32NBlocks, m_u32BlockSize_B + BLOCK_ALIGNMENT_B, cPacketRingBuffer::BACKEND_LOCK_FREE_SPSC),
+    m_i32CurrentBlockIndex(-1),
+    m_u32CurrentBlockOffset_B(0),
+    m_u64CurrentBlockStart_ms(0),
+    m_u64NextBlockNumber(0),
+    m_bRecording(false),
+    m_bStopFlag(false),
+    m_iFileDescriptor(-1),
+    m_u64FileSize_B(0),
+    m_u64FileStart_ms(0),
+    m_u32FileNumber(0),
+    m_u64LastFileOpenAttempt_ms(0),
+    m_u64NPacketsRecorded(0),
+    m_u64NBytesRecorded(0),
+    m_u64NPacketsDropped(0),
+    m_u64NBytesWritten(0),
+    m_u64NBlocksDiscarded(0),
+    m_u64NPacketsDiscarded(0)
+{
+    if(m_u32BlockSize_B < BLOCK_ALIGNMENT_B)
+    {
+        m_u32BlockSize_B = BLOCK_ALIGNMENT_B;
+        m_oBlocks.resize(m_oBlocks.getNElements(), m_u32BlockSize_B + BLOCK_ALIGNMENT_B);
+    }
+}
+
+cStreamRecorder::~cStreamRecorder()
+{
+    stopRecording();
+}
+
+void cStreamRecorder::setFileRolling(uint64_t u64MaxFileSize_B, uint32_t u32MaxFileDuration_s)
+{
+    m_u64MaxFileSize_B = u64MaxFileSize_B;
+    m_u32MaxFileDuration_s = u32MaxFileDuration_s;
+}
+
+void cStreamRecorder::setDirectIO(bool bDirectIO)
+{
+    m_bDirectIO = bDirectIO;
+}
+
+void cStreamRecorder::setFlushInterval(uint32_t u32FlushInterval_ms)
+{
+    m_u32FlushInterval_ms = u32FlushInterval_ms;
+}
+
+bool cStreamRecorder::startRecording()
+{
+    if(m_bRecording.load())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cStreamRecorder::startRecording(): Warning: Already recording. Ignoring.";
+        return false;
+    }
+
+    if(m_pDiskWritingThread.get())
+    {
+        m_pDiskWritingThread->join();
+        m_pDiskWritingThread.reset();
+    }
+
+    m_oBlocks.clear();
+    m_i32CurrentBlockIndex = -1;
+    m_u32CurrentBlockOffset_B = 0;
+    m_u64NextBlockNumber = 0;
+    m_u32FileNumber = 0;
+
+    if(!openNextFile())
+        return false;
+
+    m_bStopFlag.store(false);
+    m_bRecording.store(true);
+
+    m_pDiskWritingThread.reset(new boost::thread(&cStreamRecorder::diskWritingThreadFunction, this));
+
+    return true;
+}
+
+void cStreamRecorder::stopRecording()
+{
+    if(!m_bRecording.exchange(false))
+        return;
+
+    //Hand over the partly filled block. No more packets are delivered at this point.
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oCurrentBlockMutex);
+
+        if(m_i32CurrentBlockIndex != -1)
+            publishCurrentBlock();
+    }
+
+    m_bStopFlag.store(true);
+    m_oBlocks.interruptWaits();
+
+    m_pDiskWritingThread->join();
+    m_pDiskWritingThread.reset();
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cStreamRecorder::stopRecording(): Recorded " << getNPacketsRecorded() << " packets (" << getNBytesRecorded()
+                                    << " bytes). Dropped " << getNPacketsDropped() << " packets. Discarded " << getNBlocksDiscarded()
+                                    << " blocks (" << getNPacketsDiscarded() << " packets).";
+}
+
+bool cStreamRecorder::isRecording()
+{
+    return m_bRecording.load();
+}
+
+bool cStreamRecorder::isStopRequested()
+{
+    return m_bStopFlag.load();
+}
+
+char* cStreamRecorder::getAlignedPointer(char *cpData)
+{
+    return (char*)(((size_t)cpData + BLOCK_ALIGNMENT_B - 1) & ~((size_t)BLOCK_ALIGNMENT_B - 1));
+}
+
+uint64_t cStreamRecorder::getTime_ns()
+{
+#ifdef __linux__
+    timespec sTime;
+    clock_gettime(CLOCK_REALTIME, &sTime);
+
+    return (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec;
+#else
+    static const boost::posix_time::ptime oEpoch(boost::gregorian::date(1970, 1, 1));
+
+    return (boost::posix_time::microsec_clock::universal_time() - oEpoch).total_microseconds() * 1000ULL;
+#endif
+}
+
+uint64_t cStreamRecorder::getMonotonicTime_ms()
+{
+#ifdef __linux__
+    timespec sTime;
+    clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+    return (uint64_t)sTime.tv_sec * 1000ULL + sTime.tv_nsec / 1000000;
+#else
+    return getTime_ns() / 1000000;
+#endif
+}
+
+void cStreamRecorder::offloadData_callback(char* pData, uint32_t u32Size_B)
+{
+    if(!m_bRecording.load(boost::memory_order_relaxed))
+        return;
+
+    cPacketRingBuffer::cMetadata oMetadata;
+    oMetadata.m_u32PayloadSize_B = u32Size_B;
+    oMetadata.m_i64ReceiveTime_ns = getTime_ns();
+
+    recordPacket(pData, u32Size_B, oMetadata);
+}
+
+void cStreamRecorder::offloadDataAndMetadata_callback(char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata)
+{
+    if(!m_bRecording.load(boost::memory_order_relaxed))
+        return;
+
+    //Prefer the time the packet arrived over the time it is offloaded
+    if(oMetadata.m_i64ReceiveTime_ns > 0)
+    {
+        recordPacket(pData, u32Size_B, oMetadata);
+    }
+    else
+    {
+        cPacketRingBuffer::cMetadata oOffloadMetadata = oMetadata;
+        oOffloadMetadata.m_i64ReceiveTime_ns = getTime_ns();
+        oOffloadMetadata.m_bKernelTimestamp = false;
+
+        recordPacket(pData, u32Size_B, oOffloadMetadata);
+    }
+}
+
+void cStreamRecorder::recordPacket(const char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata)
+{
+    uint32_t u32RecordSize_B = (RECORD_HEADER_SIZE_B + u32Size_B + 7) & ~7U;
+
+    if(u32RecordSize_B > m_u32BlockSize_B - BLOCK_HEADER_SIZE_B)
+    {
+        m_u64NPacketsDropped.fetch_add(1, boost::memory_order_relaxed);
+        return;
+    }
+
+    boost::unique_lock<boost::mutex> oLock(m_oCurrentBlockMutex);
+
+    //Hand over the current block if the record does not fit. Blocks held for too long are handed over by the disk thread.
+    if(m_i32CurrentBlockIndex != -1 && m_u32CurrentBlockOffset_B + u32RecordSize_B > m_u32BlockSize_B)
+        publishCurrentBlock();
+
+    if(m_i32CurrentBlockIndex == -1)
+    {
+        //Never wait for the disk
+        m_i32CurrentBlockIndex = m_oBlocks.tryToGetNextWriteIndex();
+
+        if(m_i32CurrentBlockIndex == -1)
+        {
+            m_u64NPacketsDropped.fetch_add(1, boost::memory_order_relaxed);
+            return;
+        }
+
+        m_u32CurrentBlockOffset_B = BLOCK_HEADER_SIZE_B;
+        m_u64CurrentBlockStart_ms = m_u32FlushInterval_ms ? getMonotonicTime_ms() : 0;
+    }
+
+    char *cpRecord = getAlignedPointer(m_oBlocks.getElementDataPointer(m_i32CurrentBlockIndex)) + m_u32CurrentBlockOffset_B;
+
+    uint64_t u64Time_ns = oMetadata.m_i64ReceiveTime_ns;
+    uint8_t u8Flags = oMetadata.m_bKernelTimestamp ? 1 : 0;
+    //Receivers that do not fill in the metadata leave the size as sent at 0
+    uint32_t u32SentSize_B = oMetadata.m_u32PayloadSize_B > u32Size_B ? oMetadata.m_u32PayloadSize_B : u32Size_B;
+
+    memcpy(cpRecord, &u32Size_B, sizeof(u32Size_B));
+    memcpy(cpRecord + 4, &m_u32SourceId, sizeof(m_u32SourceId));
+    memcpy(cpRecord + 8, &u64Time_ns, sizeof(u64Time_ns));
+    memcpy(cpRecord + 16, oMetadata.m_au8SourceAddress, sizeof(oMetadata.m_au8SourceAddress));
+    memcpy(cpRecord + 32, &oMetadata.m_u16SourcePort, sizeof(oMetadata.m_u16SourcePort));
+    cpRecord[34] = oMetadata.m_u8AddressFamily;
+    cpRecord[35] = u8Flags;
+    memcpy(cpRecord + 36, &u32SentSize_B, sizeof(u32SentSize_B));
+    memcpy(cpRecord + RECORD_HEADER_SIZE_B, pData, u32Size_B);
+    memset(cpRecord + RECORD_HEADER_SIZE_B + u32Size_B, 0, u32RecordSize_B - RECORD_HEADER_SIZE_B - u32Size_B);
+
+    m_u32CurrentBlockOffset_B += u32RecordSize_B;
+
+    m_u64NPacketsRecorded.fetch_add(1, boost::memory_order_relaxed);
+    m_u64NBytesRecorded.fetch_add(u32Size_B, boost::memory_order_relaxed);
+}
+
+void cStreamRecorder::publishCurrentBlock()
+{
+    char *cpBlock = getAlignedPointer(m_oBlocks.getElementDataPointer(m_i32CurrentBlockIndex));
+
+    memcpy(cpBlock, &BLOCK_MAGIC, sizeof(BLOCK_MAGIC));
+    memcpy(cpBlock + 4, &m_u32CurrentBlockOffset_B, sizeof(m_u32CurrentBlockOffset_B));
+    memcpy(cpBlock + 8, &m_u64NextBlockNumber, sizeof(m_u64NextBlockNumber));
+
+    m_u64NextBlockNumber++;
+
+    //The padding after the records is zeroed by the disk thread
+    m_oBlocks.elementWritten();
+    m_i32CurrentBlockIndex = -1;
+}
+
+void cStreamRecorder::flushStaleBlock()
+{
+    boost::unique_lock<boost::mutex> oLock(m_oCurrentBlockMutex);
+
+    if(m_i32CurrentBlockIndex == -1 || m_u32CurrentBlockOffset_B == BLOCK_HEADER_SIZE_B)
+        return;
+
+    if(getMonotonicTime_ms() - m_u64CurrentBlockStart_ms >= m_u32FlushInterval_ms)
+        publishCurrentBlock();
+}
+
+bool cStreamRecorder::openNextFile()
+{
+    closeFile();
+
+    boost::posix_time::ptime oNow = boost::posix_time::second_clock::universal_time();
+
+    stringstream oFilename;
+    oFilename << m_strFilenamePrefix << "_" << boost::posix_time::to_iso_string(oNow) << "_" << setw(4) << setfill('0') << m_u32FileNumber++ << ".avnrec";
+
+    int iFlags = O_WRONLY | O_CREAT | O_TRUNC;
+
+#ifdef __linux__
+    if(m_bDirectIO)
+    {
+        m_iFileDescriptor = open(oFilename.str().c_str(), iFlags | O_DIRECT, 0644);
+
+        //Not all file systems support direct IO
+        if(m_iFileDescriptor < 0 && errno == EINVAL)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cStreamRecorder::openNextFile(): Warning: Direct IO not supported for " << oFilename.str()
+                                               << ". Using buffered IO.";
+        }
+    }
+#else
+    if(m_bDirectIO)
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cStreamRecorder::openNextFile(): Warning: Direct IO is only available on Linux. Using buffered IO.";
+#endif
+
+    if(m_iFileDescriptor < 0)
+        m_iFileDescriptor = open(oFilename.str().c_str(), iFlags, 0644);
+
+    if(m_iFileDescriptor < 0)
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cStreamRecorder::openNextFile(): Error: Unable to open " << oFilename.str() << ": " << strerror(errno);
+        return false;
+    }
+
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oFilenameMutex);
+        m_strCurrentFilename = oFilename.str();
+    }
+
+    m_u64FileSize_B = 0;
+    m_u64FileStart_ms = getMonotonicTime_ms();
+
+    //The file header takes up a whole block so that data blocks stay aligned. Use a spare aligned buffer for it.
+    vector<char> vcHeader(m_u32BlockSize_B + BLOCK_ALIGNMENT_B, 0);
+    char *cpHeader = getAlignedPointer(&vcHeader.front());
+
+    uint32_t u32FileFormatVersion = FILE_FORMAT_VERSION;
+    uint32_t u32DescriptionLength_B = m_strSourceDescription.length();
+    if(u32DescriptionLength_B > m_u32BlockSize_B - 24)
+        u32DescriptionLength_B = m_u32BlockSize_B - 24;
+
+    memcpy(cpHeader, FILE_MAGIC, sizeof(FILE_MAGIC));
+    memcpy(cpHeader + 8, &u32FileFormatVersion, sizeof(u32FileFormatVersion));
+    memcpy(cpHeader + 12, &m_u32BlockSize_B, sizeof(m_u32BlockSize_B));
+    memcpy(cpHeader + 16, &m_u32SourceId, sizeof(m_u32SourceId));
+    memcpy(cpHeader + 20, &u32DescriptionLength_B, sizeof(u32DescriptionLength_B));
+    memcpy(cpHeader + 24, m_strSourceDescription.data(), u32DescriptionLength_B);
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cStreamRecorder::openNextFile(): Recording to " << oFilename.str();
+
+    if(!writeBlock(cpHeader))
+    {
+        closeFile();
+        return false;
+    }
+
+    return true;
+}
+
+void cStreamRecorder::closeFile()
+{
+    if(m_iFileDescriptor < 0)
+        return;
+
+    close(m_iFileDescriptor);
+    m_iFileDescriptor = -1;
+}
+
+bool cStreamRecorder::writeBlock(const char *cpBlock)
+{
+    uint32_t u32BytesLeft_B = m_u32BlockSize_B;
+
+    while(u32BytesLeft_B)
+    {
+        ssize_t i64NBytesWritten = write(m_iFileDescriptor, cpBlock + m_u32BlockSize_B - u32BytesLeft_B, u32BytesLeft_B);
+
+        if(i64NBytesWritten < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cStreamRecorder::writeBlock(): Error: Write to " << getCurrentFilename() << " failed: " << strerror(errno);
+            return false;
+        }
+
+        u32BytesLeft_B -= i64NBytesWritten;
+    }
+
+    m_u64FileSize_B += m_u32BlockSize_B;
+    m_u64NBytesWritten.fetch_add(m_u32BlockSize_B, boost::memory_order_relaxed);
+
+    return true;
+}
+
+void cStreamRecorder::discardBlock(const char *cpBlock)
+{
+    //Walk the records so that the packets lost are no longer counted as recorded
+    uint32_t u32BytesUsed_B;
+    memcpy(&u32BytesUsed_B, cpBlock + 4, sizeof(u32BytesUsed_B));
+
+    uint64_t u64NPackets = 0;
+    uint64_t u64NBytes = 0;
+
+    for(uint32_t u32Offset_B = BLOCK_HEADER_SIZE_B; u32Offset_B + RECORD_HEADER_SIZE_B <= u32BytesUsed_B; )
+    {
+        uint32_t u32Size_B;
+        memcpy(&u32Size_B, cpBlock + u32Offset_B, sizeof(u32Size_B));
+
+        u64NPackets++;
+        u64NBytes += u32Size_B;
+
+        u32Offset_B += (RECORD_HEADER_SIZE_B + u32Size_B + 7) & ~7U;
+    }
+
+    m_u64NPacketsRecorded.fetch_sub(u64NPackets, boost::memory_order_relaxed);
+    m_u64NBytesRecorded.fetch_sub(u64NBytes, boost::memory_order_relaxed);
+
+    m_u64NBlocksDiscarded.fetch_add(1, boost::memory_order_relaxed);
+    m_u64NPacketsDiscarded.fetch_add(u64NPackets, boost::memory_order_relaxed);
+}
+
+void cStreamRecorder::diskWritingThreadFunction()
+{
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Entered cStreamRecorder::diskWritingThreadFunction()";
+
+    cPacketRingBuffer::abortCondition fStopCondition = boost::bind(&cStreamRecorder::isStopRequested, this);
+
+    //Wake up regularly to hand over a partly filled block that is due
+    uint32_t u32WaitTimeout_ms = m_u32FlushInterval_ms ? (m_u32FlushInterval_ms + 3) / 4 : 0;
+
+    while(true)
+    {
+        if(m_u32FlushInterval_ms && !isStopRequested())
+            flushStaleBlock();
+
+        //Wait for a full block. Once stopping, write out whatever is left without waiting.
+        int32_t i32Index = isStopRequested() ? m_oBlocks.tryToGetNextReadIndex() : m_oBlocks.getNextReadIndex(u32WaitTimeout_ms, fStopCondition);
+
+        if(i32Index == -1)
+        {
+            if(isStopRequested() && m_oBlocks.tryToGetNextReadIndex() == -1)
+                break;
+
+            continue;
+        }
+
+        char *cpBlock = getAlignedPointer(m_oBlocks.getElementDataPointer(i32Index));
+        uint64_t u64Now_ms = getMonotonicTime_ms();
+
+        uint32_t u32BytesUsed_B;
+        memcpy(&u32BytesUsed_B, cpBlock + 4, sizeof(u32BytesUsed_B));
+        memset(cpBlock + u32BytesUsed_B, 0, m_u32BlockSize_B - u32BytesUsed_B);
+
+        //Roll over to a new file by size or age before writing the block. After a failure try a new file again, but not
+        //for every block.
+        bool bOpenNextFile;
+
+        if(m_iFileDescriptor >= 0)
+        {
+            bOpenNextFile = (m_u64MaxFileSize_B && m_u64FileSize_B + m_u32BlockSize_B > m_u64MaxFileSize_B)
+                    || (m_u32MaxFileDuration_s && u64Now_ms - m_u64FileStart_ms >= (uint64_t)m_u32MaxFileDuration_s * 1000);
+        }
+        else
+        {
+            bOpenNextFile = u64Now_ms - m_u64LastFileOpenAttempt_ms >= FILE_OPEN_RETRY_INTERVAL_MS;
+        }
+
+        if(bOpenNextFile)
+        {
+            m_u64LastFileOpenAttempt_ms = u64Now_ms;
+
+            if(!openNextFile())
+            {
+                AVN_LOG(cLogger::SEVERITY_ERROR) << "cStreamRecorder::diskWritingThreadFunction(): Error: No file to record to. Discarding blocks and retrying in "
+                                                 << FILE_OPEN_RETRY_INTERVAL_MS << " ms.";
+            }
+        }
+
+        if(m_iFileDescriptor < 0)
+        {
+            //Keep draining so the callback does not stall
+            discardBlock(cpBlock);
+        }
+        else if(!writeBlock(cpBlock))
+        {
+            //Part of the block may be in the file. Don't append to it, start a new file at the next retry.
+            closeFile();
+            m_u64LastFileOpenAttempt_ms = u64Now_ms;
+            discardBlock(cpBlock);
+        }
+
+        m_oBlocks.elementRead();
+    }
+
+    closeFile();
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Exiting cStreamRecorder::diskWritingThreadFunction()";
+}
+
+uint64_t cStreamRecorder::getNPacketsRecorded()
+{
+    return m_u64NPacketsRecorded.load(boost::memory_order_relaxed);
+}
+
+uint64_t cStreamRecorder::getNBytesRecorded()
+{
+    return m_u64NBytesRecorded.load(boost::memory_order_relaxed);
+}
+
+uint64_t cStreamRecorder::getNPacketsDropped()
+{
+    return m_u64NPacketsDropped.load(boost::memory_order_relaxed);
+}
+
+uint64_t cStreamRecorder::getNBlocksDiscarded()
+{
+    return m_u64NBlocksDiscarded.load(boost::memory_order_relaxed);
+}
+
+uint64_t cStreamRecorder::getNPacketsDiscarded()
+{
+    return m_u64NPacketsDiscarded.load(boost::memory_order_relaxed);
+}
+
+uint64_t cStreamRecorder::getNBytesWritten()
+{
+    return m_u64NBytesWritten.load(boost::memory_order_relaxed);
+}
+
+string cStreamRecorder::getCurrentFilename()
+{
+    boost::unique_lock<boost::mutex> oLock(m_oFilenameMutex);
+
+    return m_strCurrentFilename;
+}
@@ -0,0 +1,156 @@
+#ifndef STREAM_RECORDER_H
+#define STREAM_RECORDER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <string>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/thread.hpp>
+#endif
+
+//Local includes
+#include "../SocketReceiverBase.h"
+#include "../PacketRingBuffer/PacketRingBuffer.h"
+
+//Data callback handler that records a stream to disk.
+
+//Packets are framed into fixed size blocks by the callback thread and written out whole by a dedicated disk thread. Blocks
+//are handed over through a lock free ring (at least two blocks, i.e. double buffering) so the callback never waits for the
+//disk: if no block is free the packet is dropped and counted rather than holding up the receiver's buffer.
+
+//On disk format (all integers little endian as written by the host):
+//  File header block (one block):  char[8] "AVNREC01", uint32 version, uint32 block size, uint32 source id,
+//                                  uint32 source description length, source description
+//  Data blocks:                    uint32 magic "AVNB", uint32 bytes used (including this header), uint64 block number,
+//                                  then records up to the bytes used, then zero padding
+//  Record:                         uint32 packet length, uint32 source id, uint64 receive time (ns since the Unix epoch),
+//                                  uint8[16] source address (network byte order, IPv4 in the first 4 bytes), uint16 source
+//                                  port, uint8 address family (4, 6 or 0 if unknown), uint8 flags (bit 0: kernel receive
+//                                  time), uint32 length as sent (larger than the packet length if it was truncated on
+//                                  receipt), packet data, zero padding to a multiple of 8 bytes
+//Records never span blocks so packets larger than a block less its header are dropped. The source id is the one given to
+//the recorder, the source address and port are those of each packet where the receiver knows them (see
+//cPacketRingBuffer::cMetadata). Version 1 records end after the receive time.
+
+//A partly filled block is handed over by the disk thread once it is older than the flush interval, so a stream that goes
+//quiet is still written out.
+
+//Blocks are a multiple of 4096 bytes and are written from 4096 byte aligned memory so the files can be opened with O_DIRECT
+//(Linux) to bypass the page cache.
+
+class cStreamRecorder : public cSocketReceiverBase::cDataCallbackInterface
+{
+public:
+    static const uint32_t                                   FILE_FORMAT_VERSION = 2;
+    static const uint32_t                                   BLOCK_ALIGNMENT_B = 4096;
+    static const uint32_t                                   BLOCK_HEADER_SIZE_B = 16;
+    static const uint32_t                                   RECORD_HEADER_SIZE_B = 40;
+    static const uint32_t                                   RECORD_HEADER_SIZE_V1_B = 16;
+
+    //Files are named <prefix>_<UTC start time>_<file number>.avnrec
+    cStreamRecorder(const std::string &strFilenamePrefix, const std::string &strSourceDescription = std::string(""), uint32_t u32SourceId = 0,
+                    uint32_t u32BlockSize_B = 4 * 1024 * 1024, uint32_t u32NBlocks = 4);
+    virtual ~cStreamRecorder();
+
+    //Configuration. Only takes effect on the next call to startRecording().
+    void                                                    setFileRolling(uint64_t u64MaxFileSize_B, uint32_t u32MaxFileDuration_s); //0 disables
+    void                                                    setDirectIO(bool bDirectIO);
+    void                                                    setFlushInterval(uint32_t u32FlushInterval_ms); //Hand over a partly filled block after this time. 0 disables.
+
+    bool                                                    startRecording();
+    //Writes out everything received so far. Packets must no longer be delivered, i.e. stop callback offloading or deregister
+    //the recorder first.
+    void                                                    stopRecording();
+    bool                                                    isRecording();
+
+    virtual void                                            offloadData_callback(char* pData, uint32_t u32Size_B);
+    virtual void                                            offloadDataAndMetadata_callback(char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata); //Records the source and time of arrival where known
+
+    //Packets framed for writing, less those in blocks that could not be written
+    uint64_t                                                getNPacketsRecorded();
+    uint64_t                                                getNBytesRecorded(); //Packet data only
+    uint64_t                                                getNPacketsDropped(); //Not framed: too large or no free block
+    //Blocks (and the packets in them) thrown away because no file could be opened or writing failed
+    uint64_t                                                getNBlocksDiscarded();
+    uint64_t                                                getNPacketsDiscarded();
+    uint64_t                                                getNBytesWritten(); //To disk, including framing
+    std::string                                             getCurrentFilename();
+
+private:
+    std::string                                             m_strFilenamePrefix;
+    std::string                                             m_strSourceDescription;
+    uint32_t                                                m_u32SourceId;
+    uint32_t                                                m_u32BlockSize_B;
+
+    uint64_t                                                m_u64MaxFileSize_B;
+    uint32_t                                                m_u32MaxFileDuration_s;
+    bool                                                    m_bDirectIO;
+    uint32_t                                                m_u32FlushInterval_ms;
+
+    //Blocks handed from the callback thread (writer) to the disk thread (reader)
+    cPacketRingBuffer                                       m_oBlocks;
+
+    //Block being filled. Protected by m_oCurrentBlockMutex: filled by the callback thread, handed over by the disk thread
+    //once it is older than the flush interval. The mutex is never held while writing to disk.
+    int32_t                                                 m_i32CurrentBlockIndex;
+    uint32_t                                                m_u32CurrentBlockOffset_B;
+    uint64_t                                                m_u64CurrentBlockStart_ms;
+    uint64_t                                                m_u64NextBlockNumber;
+    boost::mutex                                            m_oCurrentBlockMutex;
+
+    boost::atomic<bool>                                     m_bRecording;
+    boost::atomic<bool>                                     m_bStopFlag;
+    boost::scoped_ptr<boost::thread>                        m_pDiskWritingThread;
+
+    //Disk thread state
+    int                                                     m_iFileDescriptor;
+    uint64_t                                                m_u64FileSize_B;
+    uint64_t                                                m_u64FileStart_ms;
+    uint32_t                                                m_u32FileNumber;
+    uint64_t                                                m_u64LastFileOpenAttempt_ms;
+    std::string                                             m_strCurrentFilename;
+    boost::mutex                                            m_oFilenameMutex;
+
+    //Statistics
+    boost::atomic<uint64_t>                                 m_u64NPacketsRecorded;
+    boost::atomic<uint64_t>                                 m_u64NBytesRecorded;
+    boost::atomic<uint64_t>                                 m_u64NPacketsDropped;
+    boost::atomic<uint64_t>                                 m_u64NBytesWritten;
+    boost::atomic<uint64_t>                                 m_u64NBlocksDiscarded;
+    boost::atomic<uint64_t>                                 m_u64NPacketsDiscarded;
+
+    static char*                                            getAlignedPointer(char *cpData);
+    static uint64_t                                         getTime_ns();
+    static uint64_t                                         getMonotonicTime_ms();
+
+    bool                                                    openNextFile();
+    void                                                    closeFile();
+    bool                                                    writeBlock(const char *cpBlock);
+    void                                                    discardBlock(const char *cpBlock);
+
+    void                                                    recordPacket(const char* pData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata);
+    void                                                    publishCurrentBlock(); //Call with m_oCurrentBlockMutex held
+    void                                                    flushStaleBlock(); //Disk thread
+    bool                                                    isStopRequested();
+    void                                                    diskWritingThreadFunction();
+};
+
+#endif // STREAM_RECORDER_H
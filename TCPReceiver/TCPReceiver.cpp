@@ -1,21 +1,48 @@
 //System includes
-#include <iostream>
 #include <sstream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#endif
 
 //Library includes
 #ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #endif
 
 //Local includes
 #include "TCPReceiver.h"
+#include "../Logger/Logger.h"
 
 using namespace std;
 
-cTCPReceiver::cTCPReceiver(const string &strPeerAddress, uint16_t u16PeerPort) :
-    cSocketReceiverBase(strPeerAddress, u16PeerPort),
-    m_oSocket(string("TCP socket"))
+cTCPReceiver::cFraming::cFraming() :
+    m_eMode(FRAMING_NONE),
+    m_u32MessageSize_B(0),
+    m_u32HeaderSize_B(0),
+    m_u32LengthOffset_B(0),
+    m_u32LengthWidth_B(4),
+    m_bLengthBigEndian(true),
+    m_bLengthIncludesHeader(false),
+    m_u32MaxMessageSize_B(0)
+{
+}
+
+cTCPReceiver::cTCPReceiver(const string &strPeerAddress, uint16_t u16PeerPort, uint32_t u32BufferNElements, uint32_t u32BufferElementSize_B) :
+    cSocketReceiverBase(strPeerAddress, u16PeerPort, u32BufferNElements, u32BufferElementSize_B),
+    m_oSocket(string("TCP socket")),
+    m_bAutoReconnect(true),
+    m_u32ReconnectInitialDelay_ms(DEFAULT_RECONNECT_INITIAL_DELAY_MS),
+    m_u32ReconnectMaxDelay_ms(DEFAULT_RECONNECT_MAX_DELAY_MS),
+    m_u32ReconnectBackoffFactor(2),
+    m_u64NReconnects(0),
+    m_bConnected(false)
 {
 }
 
@@ -26,41 +53,91 @@ cTCPReceiver::~cTCPReceiver()
 
 void cTCPReceiver::socketReceivingThreadFunction()
 {
-    cout << "Entered cTCPReceiver::socketReceivingThreadFunction()" << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Entered cTCPReceiver::socketReceivingThreadFunction()";
 
-    //First attempt to connect socket
-    if(m_oSocket.openAndConnect(m_strPeerAddress, m_u16PeerPort))
-    {
-        //Notification of socket connection
-        boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+    cFraming oFraming = getFraming();
+    uint32_t u32ReconnectDelay_ms = m_u32ReconnectInitialDelay_ms.load();
 
-        for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers.size(); ui++)
+    while(isReceivingEnabled() && !isShutdownRequested())
+    {
+        //Attempt to connect socket
+        if(!openAndConnectSocket())
         {
-            m_vpNotificationCallbackHandlers[ui]->socketConnected_callback();
+            //Only notify on the transition from connected. Failed retries are not reported again.
+            if(m_bConnected.load())
+                notifyDisconnected();
+
+            m_oSocket.close();
+
+            if(isReceivingStopRequested())
+                break;
+
+            if(!m_bAutoReconnect.load())
+            {
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPReceiver::socketReceivingThreadFunction(): Warning: Unable to connect to " << m_strPeerAddress << ":" << m_u16PeerPort
+                                                   << ". Stopping receiving.";
+                stopReceiving();
+                break;
+            }
+
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::socketReceivingThreadFunction(): Unable to connect to " << m_strPeerAddress << ":" << m_u16PeerPort
+                                            << ". Retrying in " << u32ReconnectDelay_ms << " ms.";
+
+            if(!waitForReconnectDelay(u32ReconnectDelay_ms))
+                break;
+
+            //Back off exponentially up to the maximum delay
+            uint64_t u64NextDelay_ms = (uint64_t)u32ReconnectDelay_ms * m_u32ReconnectBackoffFactor.load();
+            uint32_t u32MaxDelay_ms = m_u32ReconnectMaxDelay_ms.load();
+
+            u32ReconnectDelay_ms = (u64NextDelay_ms > u32MaxDelay_ms) ? u32MaxDelay_ms : u64NextDelay_ms;
+
+            continue;
         }
 
-        for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers_shared.size(); ui++)
+        //Notification of socket connection
+        notifyConnected();
+        readPeerMetadata();
+        u32ReconnectDelay_ms = m_u32ReconnectInitialDelay_ms.load();
+
+        bool bConnectionLost;
+
+        if(oFraming.m_eMode == FRAMING_NONE)
+            bConnectionLost = streamReceivingLoop();
+        else
+            bConnectionLost = framedReceivingLoop(oFraming);
+
+        if(!bConnectionLost)
+            break;
+
+        notifyDisconnected();
+        m_oSocket.close();
+
+        if(!m_bAutoReconnect.load())
         {
-            m_vpNotificationCallbackHandlers_shared[ui]->socketConnected_callback();
+            stopReceiving();
+            break;
         }
+
+        //The buffer, callback handlers and offloading carry on. Reconnect straight away, back off only if that fails.
+        m_u64NReconnects.fetch_add(1);
+
+        AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::socketReceivingThreadFunction(): Connection lost. Reconnecting to " << m_strPeerAddress << ":" << m_u16PeerPort << ".";
     }
-    else
+
+    if(m_bConnected.load())
     {
-        //Notification of socket connection failure
-        boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+        notifyDisconnected();
+        m_oSocket.close();
+    }
 
-        for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers.size(); ui++)
-        {
-            m_vpNotificationCallbackHandlers[ui]->socketDisconnected_callback();
-        }
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::socketReceivingThread(): Exiting receiving thread.";
+}
 
-        for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers_shared.size(); ui++)
-        {
-            m_vpNotificationCallbackHandlers_shared[ui]->socketDisconnected_callback();
-        }
-    }
+bool cTCPReceiver::streamReceivingLoop()
+{
+    //Returns true if the connection was lost, false if receiving was stopped
 
-    //Enter thread loop, repeated reading into the FIFO
     uint32_t u32PacketsReceived = 0;
     int32_t i32BytesLastRead;
     int32_t i32BytesLeftToRead;
@@ -68,20 +145,14 @@ void cTCPReceiver::socketReceivingThreadFunction()
     while(isReceivingEnabled() && !isShutdownRequested())
     {
         //Get (or wait for) the next available element to write data to
-        //If waiting timeout every 500 ms and check for shutdown or stop streaming flags
-        //This prevents the program locking up in this thread.
+        //The wait is interrupted as soon as receiving is stopped or shutdown is requested.
         int32_t i32Index = -1;
-        while(i32Index == -1)
-        {
-            i32Index = m_oBuffer.getNextWriteIndex(500);
+        waitForFreeElements(i32Index, 1);
 
-            //Also check for shutdown flag
-            if(!isReceivingEnabled() || isShutdownRequested())
-            {
-                cout << "cTCPReceiver::socketReceivingThread(): Exiting receiving thread." << endl;
-                cout << "---- Received " << u32PacketsReceived << " packets. ----" << endl;
-                return;
-            }
+        if(i32Index == -1)
+        {
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::streamReceivingLoop(): Stopped receiving. Received " << u32PacketsReceived << " packets.";
+            return false;
         }
 
         //Read as many packets as can be fitted in to the buffer (it should be empty at this point)
@@ -91,36 +162,26 @@ void cTCPReceiver::socketReceivingThreadFunction()
         {
             if(!m_oSocket.receive(m_oBuffer.getElementDataPointer(i32Index) + m_oBuffer.getElementPointer(i32Index)->dataSize(), i32BytesLeftToRead) )
             {
-                cout << "cTCPReceiver::socketReceivingThread(): Warning socket error: " << m_oSocket.getLastReadError().message() << endl;
-                cout << "cTCPReceiver::socketReceivingThread(): Warning socket error value: " << m_oSocket.getLastReadError().value() << endl;
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPReceiver::streamReceivingLoop(): Warning socket error: " << m_oSocket.getLastReadError().message()
+                                                   << " (value " << m_oSocket.getLastReadError().value() << ")";
 
-                //Check for errors from socket disconnection
-                //TODO: This should probably be done with error codes as apposed string matching
+                addSocketError();
 
-                if(m_oSocket.getLastReadError().message().find("End of file") != string::npos
-                        || m_oSocket.getLastReadError().message().find("Bad file descriptor") != string::npos )
+                if(isDisconnectionError(m_oSocket.getLastReadError()))
                 {
-                    boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
-
-                    for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers.size(); ui++)
-                    {
-                        m_vpNotificationCallbackHandlers[ui]->socketDisconnected_callback();
-                    }
-
-                    for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers_shared.size(); ui++)
-                    {
-                        m_vpNotificationCallbackHandlers_shared[ui]->socketDisconnected_callback();
-                    }
-
-                    cout << "cTCPReceiver::socketReceivingThread(): socket disconnected." << endl;
-                    stopReceiving();
-                    m_oSocket.close();
-                    break;
+                    //Hand on the part of the stream received before the disconnection
+                    if(m_oBuffer.getElementPointer(i32Index)->dataSize())
+                        commitElement(i32Index);
+
+                    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::streamReceivingLoop(): socket disconnected. Received " << u32PacketsReceived << " packets.";
+                    return true;
                 }
             }
 
             i32BytesLastRead = m_oSocket.getNBytesLastRead();
 
+            addReceivedData(1, i32BytesLastRead);
+
             u32PacketsReceived++;
 
             i32BytesLeftToRead -= i32BytesLastRead;
@@ -129,18 +190,467 @@ void cTCPReceiver::socketReceivingThreadFunction()
             //Also check for shutdown flag
             if(!isReceivingEnabled() || isShutdownRequested())
             {
-                cout << "cTCPReceiver::socketReceivingThread(): Exiting receiving thread." << endl;
-                cout << "---- Received " << u32PacketsReceived << " packets. ----" << endl;
-                return;
+                AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::streamReceivingLoop(): Stopped receiving. Received " << u32PacketsReceived << " packets.";
+                return false;
             }
         }
         //Signal we have completely filled an element of the input buffer.
-        m_oBuffer.elementWritten();
+        commitElement(i32Index);
+    }
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::streamReceivingLoop(): Stopped receiving. Received " << u32PacketsReceived << " packets.";
+
+    return false;
+}
+
+bool cTCPReceiver::framedReceivingLoop(const cFraming &oFraming)
+{
+    //Returns true if the connection was lost (or dropped), false if receiving was stopped
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::framedReceivingLoop(): Receiving " << (oFraming.m_eMode == FRAMING_FIXED_SIZE ? "fixed size" : "length prefixed") << " messages.";
+
+    uint32_t u32MessagesReceived = 0;
+
+    uint64_t u64MaxMessageSize_B = oFraming.m_u32MaxMessageSize_B;
+    if(!u64MaxMessageSize_B)
+        u64MaxMessageSize_B = (uint64_t)cFraming::DEFAULT_MAX_MESSAGE_SIZE_FACTOR * m_oBuffer.getElementSize_B();
+
+    while(isReceivingEnabled() && !isShutdownRequested())
+    {
+        //Get (or wait for) the next available element to write data to
+        //The wait is interrupted as soon as receiving is stopped or shutdown is requested.
+        int32_t i32Index = -1;
+        waitForFreeElements(i32Index, 1);
+
+        if(i32Index == -1)
+            break;
+
+        uint32_t u32MessageSize_B;
+
+        if(oFraming.m_eMode == FRAMING_FIXED_SIZE)
+        {
+            u32MessageSize_B = oFraming.m_u32MessageSize_B;
+        }
+        else
+        {
+            //The header is needed to know the message size. It always fits as elements are never smaller than the header.
+            if(!receiveIntoElement(i32Index, oFraming.m_u32HeaderSize_B))
+                return !isReceivingStopRequested();
+
+            const unsigned char *ucpLength = (const unsigned char*)m_oBuffer.getElementDataPointer(i32Index) + oFraming.m_u32LengthOffset_B;
+            uint64_t u64Length = 0;
+
+            if(oFraming.m_bLengthBigEndian)
+            {
+                for(uint32_t ui = 0; ui < oFraming.m_u32LengthWidth_B; ui++)
+                    u64Length = (u64Length << 8) | ucpLength[ui];
+            }
+            else
+            {
+                for(uint32_t ui = oFraming.m_u32LengthWidth_B; ui > 0; ui--)
+                    u64Length = (u64Length << 8) | ucpLength[ui - 1];
+            }
+
+            if(!oFraming.m_bLengthIncludesHeader)
+                u64Length += oFraming.m_u32HeaderSize_B;
+
+            if(u64Length < oFraming.m_u32HeaderSize_B || u64Length > u64MaxMessageSize_B)
+            {
+                AVN_LOG(cLogger::SEVERITY_ERROR) << "cTCPReceiver::framedReceivingLoop(): Error: Invalid message length " << u64Length << " bytes. The stream is out of sync. Dropping connection.";
+
+                addSocketError();
+                m_oBuffer.getElementPointer(i32Index)->clearData();
+                return true;
+            }
+
+            u32MessageSize_B = u64Length;
+        }
+
+        //Grow only the element we hold if the message does not fit, so that the buffer does not grow with a few large messages
+        if(u32MessageSize_B > m_oBuffer.getElementPointer(i32Index)->allocationSize())
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPReceiver::framedReceivingLoop(): Warning: Input buffer element size is too small for message. Growing element to "
+                                               << u32MessageSize_B << " bytes";
+
+            m_oBuffer.growElement(i32Index, u32MessageSize_B);
+        }
+
+        if(!receiveIntoElement(i32Index, u32MessageSize_B - m_oBuffer.getElementPointer(i32Index)->dataSize()))
+            return !isReceivingStopRequested();
+
+        //Signal we have a whole message in an element of the input buffer.
+        commitElement(i32Index);
+
+        u32MessagesReceived++;
     }
 
-    cout << "cTCPReceiver::socketReceivingThread(): Exiting receiving thread." << endl;
-    cout << "---- Received " << u32PacketsReceived << " packets ----" << endl;
-    fflush(stdout);
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::framedReceivingLoop(): Stopped receiving. Received " << u32MessagesReceived << " messages.";
+
+    return false;
+}
+
+bool cTCPReceiver::receiveIntoElement(uint32_t u32Index, uint32_t u32Size_B)
+{
+    cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(u32Index);
+
+    while(u32Size_B)
+    {
+        if(!m_oSocket.receive(pElement->getDataPointer() + pElement->dataSize(), u32Size_B))
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPReceiver::receiveIntoElement(): Warning socket error: " << m_oSocket.getLastReadError().message()
+                                               << " (value " << m_oSocket.getLastReadError().value() << ")";
+
+            addSocketError();
+
+            if(isDisconnectionError(m_oSocket.getLastReadError()))
+            {
+                //A partly received message is discarded
+                pElement->clearData();
+                return false;
+            }
+        }
+
+        uint32_t u32BytesLastRead = m_oSocket.getNBytesLastRead();
+
+        addReceivedData(1, u32BytesLastRead);
+
+        u32Size_B -= u32BytesLastRead;
+        pElement->setDataAdded(u32BytesLastRead);
+
+        //Also check for shutdown flag
+        if(!isReceivingEnabled() || isShutdownRequested())
+        {
+            pElement->clearData();
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void cTCPReceiver::commitElement(uint32_t u32Index)
+{
+    cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(u32Index);
+
+    pElement->metadata() = m_oPeerMetadata;
+    pElement->metadata().m_u32PayloadSize_B = pElement->dataSize();
+    pElement->metadata().m_i64ReceiveTime_ns = (boost::posix_time::microsec_clock::universal_time() - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds() * 1000;
+
+    elementsReceived(1);
+}
+
+void cTCPReceiver::readPeerMetadata()
+{
+    m_oPeerMetadata.clear();
+
+    boost::system::error_code oError;
+    boost::asio::ip::tcp::endpoint oEndpoint = m_oSocket.getBoostSocketPointer()->remote_endpoint(oError);
+
+    if(oError)
+        return;
+
+    m_oPeerMetadata.m_u16SourcePort = oEndpoint.port();
+
+    if(oEndpoint.address().is_v4())
+    {
+        boost::asio::ip::address_v4::bytes_type aucBytes = oEndpoint.address().to_v4().to_bytes();
+        memcpy(m_oPeerMetadata.m_au8SourceAddress, aucBytes.data(), aucBytes.size());
+        m_oPeerMetadata.m_u8AddressFamily = 4;
+    }
+    else
+    {
+        boost::asio::ip::address_v6::bytes_type aucBytes = oEndpoint.address().to_v6().to_bytes();
+        memcpy(m_oPeerMetadata.m_au8SourceAddress, aucBytes.data(), aucBytes.size());
+        m_oPeerMetadata.m_u8AddressFamily = 6;
+    }
+}
+
+void cTCPReceiver::notifyConnected()
+{
+    m_bConnected.store(true);
+
+    boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+
+    for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers.size(); ui++)
+    {
+        m_vpNotificationCallbackHandlers[ui]->socketConnected_callback();
+    }
+
+    for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers_shared.size(); ui++)
+    {
+        m_vpNotificationCallbackHandlers_shared[ui]->socketConnected_callback();
+    }
+}
+
+void cTCPReceiver::notifyDisconnected()
+{
+    m_bConnected.store(false);
+
+    boost::unique_lock<boost::shared_mutex> oLock(m_oCallbackHandlersMutex);
+
+    for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers.size(); ui++)
+    {
+        m_vpNotificationCallbackHandlers[ui]->socketDisconnected_callback();
+    }
+
+    for(uint32_t ui = 0; ui < m_vpNotificationCallbackHandlers_shared.size(); ui++)
+    {
+        m_vpNotificationCallbackHandlers_shared[ui]->socketDisconnected_callback();
+    }
+}
+
+bool cTCPReceiver::isDisconnectionError(const boost::system::error_code &oError)
+{
+    //Errors after which the connection is unusable. Others (e.g. interrupted calls) are retried on the same connection.
+    return oError == boost::asio::error::eof
+            || oError == boost::asio::error::connection_reset
+            || oError == boost::asio::error::connection_aborted
+            || oError == boost::asio::error::broken_pipe
+            || oError == boost::asio::error::not_connected
+            || oError == boost::asio::error::bad_descriptor
+            || oError == boost::asio::error::timed_out
+            || oError == boost::asio::error::host_unreachable
+            || oError == boost::asio::error::network_unreachable
+            || oError == boost::asio::error::network_down
+            || oError == boost::asio::error::shut_down;
+}
+
+bool cTCPReceiver::openAndConnectSocket()
+{
+#ifdef __linux__
+    //The receive buffer size sets the window scale offered in the SYN so the socket options have to be applied before
+    //connecting. Open the underlying socket here and connect it without blocking so that stopping receiving is not held up.
+    boost::asio::ip::tcp::socket *pSocket = m_oSocket.getBoostSocketPointer();
+
+    try
+    {
+        boost::asio::ip::tcp::endpoint oEndpoint;
+        boost::system::error_code oError;
+
+        boost::asio::ip::address oAddress = boost::asio::ip::address::from_string(m_strPeerAddress, oError);
+
+        if(oError)
+        {
+            //Not a numeric address: resolve it
+            boost::asio::io_service oIOService;
+            boost::asio::ip::tcp::resolver oResolver(oIOService);
+            stringstream oSS;
+            oSS << m_u16PeerPort;
+
+            oEndpoint = *oResolver.resolve(boost::asio::ip::tcp::resolver::query(m_strPeerAddress, oSS.str()));
+        }
+        else
+        {
+            oEndpoint = boost::asio::ip::tcp::endpoint(oAddress, m_u16PeerPort);
+        }
+
+        if(pSocket->is_open())
+            pSocket->close();
+
+        pSocket->open(oEndpoint.protocol());
+
+        getSocketOptions().apply(pSocket->native_handle(), m_oSocket.getName());
+
+        pSocket->native_non_blocking(true);
+
+        int iResult = ::connect(pSocket->native_handle(), oEndpoint.data(), oEndpoint.size());
+        int iError = iResult ? errno : 0;
+
+        while(iError == EINPROGRESS)
+        {
+            if(isReceivingStopRequested())
+            {
+                pSocket->close();
+                return false;
+            }
+
+            pollfd oPollFileDescriptor;
+            oPollFileDescriptor.fd = pSocket->native_handle();
+            oPollFileDescriptor.events = POLLOUT;
+            oPollFileDescriptor.revents = 0;
+
+            iResult = poll(&oPollFileDescriptor, 1, CONNECT_POLL_INTERVAL_MS);
+
+            if(iResult < 0 && errno != EINTR)
+            {
+                iError = errno;
+            }
+            else if(iResult > 0)
+            {
+                socklen_t iLength = sizeof(iError);
+                if(getsockopt(pSocket->native_handle(), SOL_SOCKET, SO_ERROR, &iError, &iLength))
+                    iError = errno;
+            }
+        }
+
+        if(iError)
+        {
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::openAndConnectSocket(): Connecting to " << m_strPeerAddress << ":" << m_u16PeerPort << " failed: " << strerror(iError);
+            pSocket->close();
+            return false;
+        }
+
+        pSocket->native_non_blocking(false);
+    }
+    catch(boost::system::system_error const &oSystemError)
+    {
+        AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::openAndConnectSocket(): Connecting to " << m_strPeerAddress << ":" << m_u16PeerPort << " failed: " << oSystemError.what();
+
+        if(pSocket->is_open())
+            pSocket->close();
+
+        return false;
+    }
+
+    return true;
+#else
+    if(!m_oSocket.openAndConnect(m_strPeerAddress, m_u16PeerPort))
+        return false;
+
+    //Socket options are only implemented for Linux, apply() logs a warning
+    getSocketOptions().apply(m_oSocket.getBoostSocketPointer()->native_handle(), m_oSocket.getName());
+
+    return true;
+#endif
+}
+
+bool cTCPReceiver::waitForReconnectDelay(uint32_t u32Delay_ms)
+{
+    //Sleep unless receiving is stopped in the mean time. Returns false if it was.
+
+    boost::posix_time::ptime oDeadline = boost::posix_time::microsec_clock::universal_time() + boost::posix_time::milliseconds(u32Delay_ms);
+
+    while(true)
+    {
+        uint64_t u64Epoch = m_oRunStateNotifier.prepareWait();
+
+        if(isReceivingStopRequested())
+        {
+            m_oRunStateNotifier.cancelWait();
+            return false;
+        }
+
+        int64_t i64Remaining_ms = (oDeadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+
+        if(i64Remaining_ms <= 0)
+        {
+            m_oRunStateNotifier.cancelWait();
+            return true;
+        }
+
+        //Other run state changes also wake us up
+        m_oRunStateNotifier.wait(u64Epoch, i64Remaining_ms);
+    }
+}
+
+void cTCPReceiver::setAutoReconnect(bool bEnable, uint32_t u32InitialDelay_ms, uint32_t u32MaxDelay_ms, uint32_t u32BackoffFactor)
+{
+    if(!u32InitialDelay_ms)
+        u32InitialDelay_ms = 1;
+
+    if(u32MaxDelay_ms < u32InitialDelay_ms)
+        u32MaxDelay_ms = u32InitialDelay_ms;
+
+    if(!u32BackoffFactor)
+        u32BackoffFactor = 1;
+
+    m_u32ReconnectInitialDelay_ms.store(u32InitialDelay_ms);
+    m_u32ReconnectMaxDelay_ms.store(u32MaxDelay_ms);
+    m_u32ReconnectBackoffFactor.store(u32BackoffFactor);
+    m_bAutoReconnect.store(bEnable);
+}
+
+bool cTCPReceiver::getAutoReconnect()
+{
+    return m_bAutoReconnect.load();
+}
+
+uint64_t cTCPReceiver::getNReconnects()
+{
+    return m_u64NReconnects.load();
+}
+
+bool cTCPReceiver::isConnected()
+{
+    return m_bConnected.load();
+}
+
+bool cTCPReceiver::setFraming(const cFraming &oFraming)
+{
+    if(oFraming.m_eMode == FRAMING_FIXED_SIZE && !oFraming.m_u32MessageSize_B)
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cTCPReceiver::setFraming(): Error: Fixed size framing needs a message size.";
+        return false;
+    }
+
+    if(oFraming.m_eMode == FRAMING_LENGTH_PREFIXED)
+    {
+        uint32_t u32Width_B = oFraming.m_u32LengthWidth_B;
+
+        if(u32Width_B != 1 && u32Width_B != 2 && u32Width_B != 4 && u32Width_B != 8)
+        {
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cTCPReceiver::setFraming(): Error: Length field width of " << u32Width_B << " bytes is not supported.";
+            return false;
+        }
+
+        if(oFraming.m_u32LengthOffset_B + u32Width_B > oFraming.m_u32HeaderSize_B)
+        {
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cTCPReceiver::setFraming(): Error: Length field at offset " << oFraming.m_u32LengthOffset_B << " does not fit in a header of "
+                                             << oFraming.m_u32HeaderSize_B << " bytes.";
+            return false;
+        }
+    }
+
+    boost::mutex::scoped_lock oLock(m_oFramingMutex);
+
+    m_oFraming = oFraming;
+
+    //The header must fit into an element before the message size is known. Fixed size messages all need the same size.
+    if(m_oFraming.m_eMode == FRAMING_LENGTH_PREFIXED && m_oFraming.m_u32HeaderSize_B > m_oBuffer.getElementSize_B())
+        m_oBuffer.requestResize(m_oBuffer.getNElements(), m_oFraming.m_u32HeaderSize_B);
+
+    if(m_oFraming.m_eMode == FRAMING_FIXED_SIZE && m_oFraming.m_u32MessageSize_B > m_oBuffer.getElementSize_B())
+        m_oBuffer.requestResize(m_oBuffer.getNElements(), m_oFraming.m_u32MessageSize_B);
+
+    return true;
+}
+
+cTCPReceiver::cFraming cTCPReceiver::getFraming()
+{
+    boost::mutex::scoped_lock oLock(m_oFramingMutex);
+
+    return m_oFraming;
+}
+
+bool cTCPReceiver::setFixedSizeFraming(uint32_t u32MessageSize_B)
+{
+    cFraming oFraming = getFraming();
+
+    oFraming.m_eMode = FRAMING_FIXED_SIZE;
+    oFraming.m_u32MessageSize_B = u32MessageSize_B;
+
+    return setFraming(oFraming);
+}
+
+bool cTCPReceiver::setLengthPrefixedFraming(uint32_t u32HeaderSize_B, uint32_t u32LengthOffset_B, uint32_t u32LengthWidth_B, bool bLengthBigEndian, bool bLengthIncludesHeader)
+{
+    cFraming oFraming = getFraming();
+
+    oFraming.m_eMode = FRAMING_LENGTH_PREFIXED;
+    oFraming.m_u32HeaderSize_B = u32HeaderSize_B;
+    oFraming.m_u32LengthOffset_B = u32LengthOffset_B;
+    oFraming.m_u32LengthWidth_B = u32LengthWidth_B;
+    oFraming.m_bLengthBigEndian = bLengthBigEndian;
+    oFraming.m_bLengthIncludesHeader = bLengthIncludesHeader;
+
+    return setFraming(oFraming);
+}
+
+void cTCPReceiver::setRawStreamFraming()
+{
+    boost::mutex::scoped_lock oLock(m_oFramingMutex);
+
+    m_oFraming.m_eMode = FRAMING_NONE;
 }
 
 void  cTCPReceiver::stopReceiving()
@@ -157,7 +667,7 @@ void cTCPReceiver::registerNoticationCallbackHandler(cNotificationCallbackInterf
 
     m_vpNotificationCallbackHandlers.push_back(pNewHandler);
 
-    cout << "cTCPReceiver::registerNoticationCallbackHandler(): Successfully registered callback handler: " << pNewHandler << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::registerNoticationCallbackHandler(): Successfully registered callback handler: " << pNewHandler;
 }
 
 void cTCPReceiver::registerNoticationCallbackHandler(boost::shared_ptr<cNotificationCallbackInterface> pNewHandler)
@@ -166,7 +676,7 @@ void cTCPReceiver::registerNoticationCallbackHandler(boost::shared_ptr<cNotifica
 
     m_vpNotificationCallbackHandlers_shared.push_back(pNewHandler);
 
-    cout << "cTCPReceiver::registerNoticationCallbackHandler(): Successfully registered callback handler: " << pNewHandler.get() << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::registerNoticationCallbackHandler(): Successfully registered callback handler: " << pNewHandler.get();
 }
 
 void cTCPReceiver::deregisterNotificationCallbackHandler(cNotificationCallbackInterface* pHandler)
@@ -181,7 +691,7 @@ void cTCPReceiver::deregisterNotificationCallbackHandler(cNotificationCallbackIn
         {
             m_vpNotificationCallbackHandlers.erase(m_vpNotificationCallbackHandlers.begin() + ui);
 
-            cout << "cTCPReceiver::deregisterNotificationCallbackHandler(): Deregistered callback handler: " << pHandler << endl;
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::deregisterNotificationCallbackHandler(): Deregistered callback handler: " << pHandler;
             bSuccess = true;
         }
         else
@@ -192,7 +702,7 @@ void cTCPReceiver::deregisterNotificationCallbackHandler(cNotificationCallbackIn
 
     if(!bSuccess)
     {
-        cout << "cTCPReceiver::deregisterNotificationCallbackHandler(): Warning: Deregistering callback handler: " << pHandler << " failed. Object instance not found." << endl;
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPReceiver::deregisterNotificationCallbackHandler(): Warning: Deregistering callback handler: " << pHandler << " failed. Object instance not found.";
     }
 }
 
@@ -208,7 +718,7 @@ void cTCPReceiver::deregisterNotificationCallbackHandler(boost::shared_ptr<cNoti
         {
             m_vpNotificationCallbackHandlers_shared.erase(m_vpNotificationCallbackHandlers_shared.begin() + ui);
 
-            cout << "cTCPReceiver::deregisterNotificationCallbackHandler(): Deregistered callback handler: " << pHandler.get() << endl;
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPReceiver::deregisterNotificationCallbackHandler(): Deregistered callback handler: " << pHandler.get();
             bSuccess = true;
         }
         else
@@ -219,6 +729,6 @@ void cTCPReceiver::deregisterNotificationCallbackHandler(boost::shared_ptr<cNoti
 
     if(!bSuccess)
     {
-        cout << "cTCPReceiver::deregisterNotificationCallbackHandler(): Warning: Deregistering callback handler: " << pHandler.get() << " failed. Object instance not found." << endl;
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPReceiver::deregisterNotificationCallbackHandler(): Warning: Deregistering callback handler: " << pHandler.get() << " failed. Object instance not found.";
     }
 }
@@ -4,6 +4,11 @@
 //System includes
 
 //Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/thread/mutex.hpp>
+#include <boost/atomic.hpp>
+#include <boost/system/error_code.hpp>
+#endif
 
 //Local includes
 #include "../SocketReceiverBase.h"
@@ -20,11 +25,71 @@ public:
         virtual void                                                    socketDisconnected_callback() = 0;
     };
 
-    explicit cTCPReceiver(const std::string &strPeerAddress, uint16_t usPeerPort = 60001);
+    enum framingMode
+    {
+        FRAMING_NONE = 0, //Raw stream: elements are filled completely, messages can span elements
+        FRAMING_FIXED_SIZE,
+        FRAMING_LENGTH_PREFIXED
+    };
+
+    //Message framing: Each buffer element holds exactly one whole message (including its header) so that consumers and
+    //callbacks can process messages in place. An element is grown when a message does not fit; the others keep their size.
+    //The metadata of each element (see cPacketRingBuffer::cMetadata) holds the peer's address and the time it was completed.
+    class cFraming
+    {
+    public:
+        static const uint32_t                                           DEFAULT_MAX_MESSAGE_SIZE_FACTOR = 16;
+
+        cFraming();
+
+        framingMode                                                     m_eMode;
+
+        //Fixed size
+        uint32_t                                                        m_u32MessageSize_B;
+
+        //Length prefixed: A header of m_u32HeaderSize_B bytes holding an unsigned length field. The length is of the payload
+        //following the header unless m_bLengthIncludesHeader is set.
+        uint32_t                                                        m_u32HeaderSize_B;
+        uint32_t                                                        m_u32LengthOffset_B;
+        uint32_t                                                        m_u32LengthWidth_B; //1, 2, 4 or 8
+        bool                                                            m_bLengthBigEndian;
+        bool                                                            m_bLengthIncludesHeader;
+
+        //Larger lengths are taken as a corrupt stream and the connection is dropped. 0 (default) allows
+        //DEFAULT_MAX_MESSAGE_SIZE_FACTOR times the buffer's element size when receiving starts.
+        uint32_t                                                        m_u32MaxMessageSize_B;
+    };
+
+    static const uint32_t                                               DEFAULT_RECONNECT_INITIAL_DELAY_MS = 100;
+    static const uint32_t                                               DEFAULT_RECONNECT_MAX_DELAY_MS = 10000;
+    static const uint32_t                                               CONNECT_POLL_INTERVAL_MS = 100; //How often a pending connect checks for stopping
+
+    explicit cTCPReceiver(const std::string &strPeerAddress, uint16_t usPeerPort = 60001, uint32_t u32BufferNElements = DEFAULT_BUFFER_N_ELEMENTS,
+                          uint32_t u32BufferElementSize_B = DEFAULT_BUFFER_ELEMENT_SIZE_B);
     virtual ~cTCPReceiver();
 
     virtual void                                                        stopReceiving();
 
+    //Takes effect on the next call to startReceiving(). An invalid format is rejected and the framing left unchanged.
+    bool                                                                setFraming(const cFraming &oFraming);
+    cFraming                                                            getFraming();
+
+    //Reconnecting: If connecting fails or the connection is lost the receiver reconnects on its own while the buffer, callback
+    //handlers and offloading keep running. Failed attempts are retried after a delay that starts at u32InitialDelay_ms and
+    //grows by u32BackoffFactor per attempt up to u32MaxDelay_ms. The notification callbacks are called on every connection
+    //and disconnection. Enabled by default. When disabled receiving stops when the connection is lost.
+    void                                                                setAutoReconnect(bool bEnable, uint32_t u32InitialDelay_ms = DEFAULT_RECONNECT_INITIAL_DELAY_MS,
+                                                                                         uint32_t u32MaxDelay_ms = DEFAULT_RECONNECT_MAX_DELAY_MS, uint32_t u32BackoffFactor = 2);
+    bool                                                                getAutoReconnect();
+    uint64_t                                                            getNReconnects(); //After a lost connection
+    bool                                                                isConnected();
+
+    //Shorthands for setFraming()
+    bool                                                                setFixedSizeFraming(uint32_t u32MessageSize_B);
+    bool                                                                setLengthPrefixedFraming(uint32_t u32HeaderSize_B, uint32_t u32LengthOffset_B, uint32_t u32LengthWidth_B,
+                                                                                             bool bLengthBigEndian = true, bool bLengthIncludesHeader = false);
+    void                                                                setRawStreamFraming();
+
     void                                                                registerNoticationCallbackHandler(cNotificationCallbackInterface* pNewHandler);
     void                                                                registerNoticationCallbackHandler(boost::shared_ptr<cNotificationCallbackInterface> pNewHandler);
     void                                                                deregisterNotificationCallbackHandler(cNotificationCallbackInterface* pHandler);
@@ -38,8 +103,36 @@ protected:
     std::vector<cNotificationCallbackInterface*>                        m_vpNotificationCallbackHandlers;
     std::vector<boost::shared_ptr<cNotificationCallbackInterface> >     m_vpNotificationCallbackHandlers_shared;
 
+    cFraming                                                            m_oFraming;
+    boost::mutex                                                        m_oFramingMutex;
+
+    boost::atomic<bool>                                                 m_bAutoReconnect;
+    boost::atomic<uint32_t>                                             m_u32ReconnectInitialDelay_ms;
+    boost::atomic<uint32_t>                                             m_u32ReconnectMaxDelay_ms;
+    boost::atomic<uint32_t>                                             m_u32ReconnectBackoffFactor;
+    boost::atomic<uint64_t>                                             m_u64NReconnects;
+    boost::atomic<bool>                                                 m_bConnected;
+
+    cPacketRingBuffer::cMetadata                                        m_oPeerMetadata; //Source of the current connection (receiving thread)
+
     //Thread functions
     virtual void                                                        socketReceivingThreadFunction();
+    bool                                                                streamReceivingLoop();
+    bool                                                                framedReceivingLoop(const cFraming &oFraming);
+
+    //Reads exactly u32Size_B more bytes into the element. Returns false if the connection was lost or receiving stopped.
+    bool                                                                receiveIntoElement(uint32_t u32Index, uint32_t u32Size_B);
+    //Fills in the element's metadata (peer, size and the time now) and hands it on
+    void                                                                commitElement(uint32_t u32Index);
+    void                                                                readPeerMetadata();
+
+    void                                                                notifyConnected();
+    void                                                                notifyDisconnected();
+    static bool                                                         isDisconnectionError(const boost::system::error_code &oError);
+    bool                                                                waitForReconnectDelay(uint32_t u32Delay_ms);
+
+    //Opens the socket, applies the socket options and connects. Returns false if connecting failed or receiving was stopped.
+    bool                                                                openAndConnectSocket();
 
 };
 
@@ -0,0 +1,134 @@
+//System includes
+#include <cstring>
+
+//Local includes
+#include "BroadcastBuffer.h"
+#include "../Logger/Logger.h"
+#include "../ThreadPlacement/ThreadPlacement.h"
+
+using namespace std;
+
+cBroadcastBuffer::cBroadcastBuffer(uint32_t u32NSlots, uint32_t u32SlotSize_B) :
+    m_voSlots(u32NSlots),
+    m_u64WriteSequence(0),
+    m_u64OldestSequence(0),
+    m_i32NUMANode(-1)
+{
+    for(uint32_t ui = 0; ui < u32NSlots; ui++)
+    {
+        m_voSlots[ui].allocate(u32SlotSize_B);
+    }
+}
+
+uint64_t cBroadcastBuffer::prepareWrite()
+{
+    uint64_t u64Sequence = m_u64WriteSequence.load(boost::memory_order_relaxed);
+
+    //Retire the packet whose slot is reused. Sequentially consistent together with the readers' pins: either the writer sees
+    //a reader's pin or the reader sees the packet retired.
+    if(u64Sequence >= m_voSlots.size())
+        m_u64OldestSequence.store(u64Sequence - m_voSlots.size() + 1, boost::memory_order_seq_cst);
+
+    return u64Sequence;
+}
+
+void cBroadcastBuffer::write(const char *cpData, uint32_t u32Size_B)
+{
+    uint64_t u64Sequence = m_u64WriteSequence.load(boost::memory_order_relaxed);
+    cPacketRingBuffer::cElement &oSlot = m_voSlots[u64Sequence % m_voSlots.size()];
+
+    //Nobody reads the slot any more so it can safely be reallocated
+    if(u32Size_B > oSlot.allocationSize())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cBroadcastBuffer::write(): Warning: Slot size is too small for packet. Resizing to " << u32Size_B << " bytes";
+
+        oSlot.allocate(u32Size_B);
+    }
+
+    oSlot.clearData();
+    memcpy(oSlot.getDataPointer(), cpData, u32Size_B);
+    oSlot.setDataAdded(u32Size_B);
+
+    //Publish the contents with the new write position
+    m_u64WriteSequence.store(u64Sequence + 1, boost::memory_order_release);
+}
+
+uint64_t cBroadcastBuffer::getWriteSequence()
+{
+    return m_u64WriteSequence.load(boost::memory_order_acquire);
+}
+
+uint64_t cBroadcastBuffer::getOldestSequence()
+{
+    return m_u64OldestSequence.load(boost::memory_order_seq_cst);
+}
+
+char* cBroadcastBuffer::getDataPointer(uint64_t u64Sequence)
+{
+    return m_voSlots[u64Sequence % m_voSlots.size()].getDataPointer();
+}
+
+uint32_t cBroadcastBuffer::getDataSize(uint64_t u64Sequence)
+{
+    return m_voSlots[u64Sequence % m_voSlots.size()].dataSize();
+}
+
+uint32_t cBroadcastBuffer::getNSlots()
+{
+    return m_voSlots.size();
+}
+
+void cBroadcastBuffer::bindToNUMANode(int32_t i32Node)
+{
+    m_i32NUMANode = i32Node;
+
+    if(i32Node < 0)
+        return;
+
+    if(m_pSlab.get())
+    {
+        cThreadPlacement::bindMemoryToNUMANode(m_pSlab->getPointer(), m_pSlab->getSize_B(), i32Node);
+        return;
+    }
+
+    //Heap slots share their pages with other allocations so they are left where they were first touched
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cBroadcastBuffer::bindToNUMANode(): Warning: Heap allocated slots are not bound to NUMA node " << i32Node
+                                       << ". Use the locked slab allocation mode for NUMA binding.";
+}
+
+void cBroadcastBuffer::setAllocationMode(cPacketRingBuffer::allocationMode eMode)
+{
+    //Keep the largest slot size in use
+    uint32_t u32SlotSize_B = 0;
+
+    for(uint32_t ui = 0; ui < m_voSlots.size(); ui++)
+    {
+        if(m_voSlots[ui].allocationSize() > u32SlotSize_B)
+            u32SlotSize_B = m_voSlots[ui].allocationSize();
+    }
+
+    m_pSlab.reset();
+
+    if(eMode == cPacketRingBuffer::ALLOCATION_LOCKED_SLAB)
+    {
+        uint32_t u32Stride_B = (u32SlotSize_B + cMemorySlab::ALIGNMENT_B - 1) / cMemorySlab::ALIGNMENT_B * cMemorySlab::ALIGNMENT_B;
+        if(!u32Stride_B)
+            u32Stride_B = cMemorySlab::ALIGNMENT_B;
+
+        m_pSlab.reset(new cMemorySlab((size_t)u32Stride_B * m_voSlots.size(), true, true, m_i32NUMANode));
+
+        for(uint32_t ui = 0; ui < m_voSlots.size(); ui++)
+        {
+            m_voSlots[ui].assign(m_pSlab->getPointer() + (size_t)u32Stride_B * ui, u32SlotSize_B);
+        }
+    }
+    else
+    {
+        for(uint32_t ui = 0; ui < m_voSlots.size(); ui++)
+        {
+            m_voSlots[ui].allocate(u32SlotSize_B);
+        }
+
+        bindToNUMANode(m_i32NUMANode);
+    }
+}
@@ -0,0 +1,80 @@
+#ifndef BROADCAST_BUFFER_H
+#define BROADCAST_BUFFER_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <vector>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/scoped_ptr.hpp>
+#endif
+
+//Local includes
+#include "../PacketRingBuffer/PacketRingBuffer.h"
+
+//Fixed size ring of packet slots shared by all connections of a cTCPServer. Each packet is copied into the ring once and
+//numbered with a sequence number. Every connection keeps its own read position (see cConnectionThread) so memory use does
+//not depend on the number of clients. Once the ring is full the writer replaces the oldest packet. A connection that has not
+//sent it yet has been lapped and is skipped past it, counting the packet as dropped or disconnecting according to its slow
+//client policy.
+
+//Packets are written by one thread only. A reader pins the packets it is about to send. The writer waits for such a pin
+//before replacing a packet, which lasts for one non-blocking send at most.
+
+class cBroadcastBuffer
+{
+public:
+    cBroadcastBuffer(uint32_t u32NSlots, uint32_t u32SlotSize_B);
+
+    //Returns the sequence number of the packet about to be written. Readers can no longer pin the packet it replaces once
+    //this returns but those that had pinned it already have to be waited for (cConnectionThread::retirePacket()) before
+    //write() is called.
+    uint64_t                                            prepareWrite();
+    void                                                write(const char *cpData, uint32_t u32Size_B); //Publishes the packet
+
+    //The ring holds packets [getOldestSequence(), getWriteSequence())
+    uint64_t                                            getWriteSequence();
+    uint64_t                                            getOldestSequence();
+
+    char*                                               getDataPointer(uint64_t u64Sequence);
+    uint32_t                                            getDataSize(uint64_t u64Sequence);
+
+    uint32_t                                            getNSlots();
+
+    //Place the slot memory on a NUMA node (see cThreadPlacement). Only the slab of ALLOCATION_LOCKED_SLAB is bound, heap slots
+    //are left where they are first touched (with a warning). Must not be called concurrently with write().
+    void                                                bindToNUMANode(int32_t i32Node);
+
+    //Reallocates the slots (see cPacketRingBuffer::allocationMode). Slots grown later by write() move to the heap. The caller
+    //has to make sure that nobody reads from the ring, e.g. that no clients are connected. Must not be called concurrently
+    //with write().
+    void                                                setAllocationMode(cPacketRingBuffer::allocationMode eMode);
+
+private:
+    std::vector<cPacketRingBuffer::cElement>            m_voSlots;
+
+    boost::atomic<uint64_t>                             m_u64WriteSequence;
+    boost::atomic<uint64_t>                             m_u64OldestSequence;
+
+    int32_t                                             m_i32NUMANode; //-1 if not bound
+
+    boost::scoped_ptr<cMemorySlab>                      m_pSlab; //Locked slab allocation only
+};
+
+#endif //BROADCAST_BUFFER_H
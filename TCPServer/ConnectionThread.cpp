@@ -1,30 +1,76 @@
 
 //System includes
-#include <iostream>
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <poll.h>
+#endif
 
 //Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/date_time/posix_time/posix_time.hpp>
+#endif
 
 //Local includes
 #include "ConnectionThread.h"
+#include "../Logger/Logger.h"
 
 using namespace std;
 
-cConnectionThread::cConnectionThread(boost::shared_ptr<cInterruptibleBlockingTCPSocket> pClientSocket) :
+namespace
+{
+    //Maximum number of queued packets handed to the kernel in one vectored send
+    const uint32_t MAX_PACKETS_PER_SEND = 64;
+
+    //Pinned position while the sending side is not reading from the broadcast buffer
+    const uint64_t NOT_PINNED = ~(uint64_t)0;
+}
+
+cConnectionThread::cConnectionThread(boost::shared_ptr<cInterruptibleBlockingTCPSocket> pClientSocket, boost::shared_ptr<cBroadcastBuffer> pBroadcastBuffer,
+                                     bool bStartWritingThread) :
     m_bShutdownFlag(false),
+    m_oWritingThreadNotifier(true),
     m_bIsValid(true),
-    m_oBuffer(512, 1040) //16 packets of 1040 bytes for each complex uint32_t FFT window of 2 channels or or I,Q,U,V uint32_t stokes parameters.
+    m_pBroadcastBuffer(pBroadcastBuffer),
+    m_u64PinnedSequence(NOT_PINNED),
+    m_u32HeadBytesSent_B(0),
+    m_eSlowClientPolicy(SLOW_CLIENT_DROP_NEWEST),
+    m_u32LagThreshold(0),
+    m_u32BlockTimeout_ms(10),
+    m_u64NPacketsDropped(0),
+    m_u64NBytesDropped(0),
+    m_u64NPacketsSent(0),
+    m_u64NBytesSent(0),
+    m_u64NSocketErrors(0),
+    m_u32LagHighWaterMark(0),
+    m_u64BlockedTime_us(0)
 {
+    //1040 bytes for each complex uint32_t FFT window of 2 channels or or I,Q,U,V uint32_t stokes parameters.
+    if(!m_pBroadcastBuffer.get())
+        m_pBroadcastBuffer.reset(new cBroadcastBuffer(SEND_QUEUE_LENGTH, 1040));
+
+    //Start with the next packet written
+    uint64_t u64WriteSequence = m_pBroadcastBuffer->getWriteSequence();
+    m_u64ReadSequence.store(u64WriteSequence);
+    m_u64StartSequence.store(u64WriteSequence);
+    m_u64EndSequence.store(u64WriteSequence);
+
+    m_u32LagThreshold.store(getMaxLag());
+
     m_pSocket.swap(pClientSocket);
 
     m_strPeerAddress = m_pSocket->getPeerAddress();
-    cout << "cConnectionThread::cConnectionThread(): Got new connection from host: " << getPeerAddress();
-
+    string strSocketName;
     if(getSocketName().length())
-        cout << ". Socket name is \"" << getSocketName() << "\"";
+        strSocketName = ". Socket name is \"" + getSocketName() + "\"";
 
-    cout << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cConnectionThread::cConnectionThread(): Got new connection from host: " << getPeerAddress() << strSocketName;
 
-    m_pSocketWritingThread.reset(new boost::thread(&cConnectionThread::socketWritingThreadFunction, this));
+    if(bStartWritingThread)
+        m_pSocketWritingThread.reset(new boost::thread(&cConnectionThread::socketWritingThreadFunction, this));
 }
 
 cConnectionThread::~cConnectionThread()
@@ -42,10 +88,11 @@ cConnectionThread::~cConnectionThread()
 
 void cConnectionThread::shutdown()
 {
-    boost::upgrade_lock<boost::shared_mutex>  oLock(m_bShutdownFlagMutex);
-    boost::upgrade_to_unique_lock<boost::shared_mutex>  oUniqueLock(oLock);
+    m_bShutdownFlag.store(true);
 
-    m_bShutdownFlag = true;
+    //Wake the writing thread if it is waiting for data or for the socket and anybody waiting for queue space
+    m_oWritingThreadNotifier.notify();
+    m_oSpaceNotifier.notify();
 }
 
 bool cConnectionThread::isValid()
@@ -65,138 +112,676 @@ void cConnectionThread::setInvalid()
 
 bool cConnectionThread::isShutdownRequested()
 {
-    boost::shared_lock<boost::shared_mutex> oLock(m_bShutdownFlagMutex);
-
-    return m_bShutdownFlag;
+    return m_bShutdownFlag.load(boost::memory_order_relaxed);
 }
 
 bool cConnectionThread::tryAddDataToSend(char* cpData, uint32_t u32Size_B)
 {
-    //Try to get the next free pointer. (For max 1 ms)
-    int32_t i32Index = m_oBuffer.tryToGetNextWriteIndex();
+    //Decide before writing so that a dropped packet does not replace one that is still queued
+    bool bWakeSender = false;
 
-    //If the is not space in the buffer return false.
-    if(i32Index == -1)
-    {
+    if(!admitPacket(m_pBroadcastBuffer->getWriteSequence(), u32Size_B, bWakeSender))
         return false;
+
+    if(writePacket(cpData, u32Size_B) || bWakeSender)
+        m_oWritingThreadNotifier.notify();
+
+    return true;
+}
+
+void cConnectionThread::blockingAddDataToSend(char* cpData, uint32_t u32Size_B)
+{
+    //Wait for space in the queue. The wait is interrupted as soon as shutdown is requested.
+    while(getLag() >= getMaxLag() && !isShutdownRequested())
+    {
+        uint64_t u64Epoch = m_oSpaceNotifier.prepareWait();
+
+        if(getLag() < getMaxLag() || isShutdownRequested())
+        {
+            m_oSpaceNotifier.cancelWait();
+            break;
+        }
+
+        m_oSpaceNotifier.wait(u64Epoch);
     }
 
-    //Otherwise check that our buffer is large enough
-    if(u32Size_B > m_oBuffer.getElementPointer(i32Index)->allocationSize())
+    if(isShutdownRequested())
     {
-        cout << "Warning: Input buffer element size is too small for UDP packet." << endl;
-        cout << "Resizing to " << u32Size_B << " bytes" << endl;
+        AVN_LOG(cLogger::SEVERITY_INFO) << "cConnectionThread::blockingAddDataToSend() exiting on detection of shutdown flag.";
+        return;
+    }
+
+    if(writePacket(cpData, u32Size_B))
+        m_oWritingThreadNotifier.notify();
+}
 
-        m_oBuffer.resize(m_oBuffer.getNElements(), u32Size_B);
+bool cConnectionThread::writePacket(char* cpData, uint32_t u32Size_B)
+{
+    uint64_t u64Sequence = m_pBroadcastBuffer->prepareWrite();
+
+    if(u64Sequence >= m_pBroadcastBuffer->getNSlots())
+    {
+        uint64_t u64Retired = u64Sequence - m_pBroadcastBuffer->getNSlots();
+        retirePacket(u64Retired, m_pBroadcastBuffer->getDataSize(u64Retired));
     }
 
-    memcpy(m_oBuffer.getElementDataPointer(i32Index), cpData, u32Size_B);
-    m_oBuffer.getElementPointer(i32Index)->setDataAdded(u32Size_B);
+    m_pBroadcastBuffer->write(cpData, u32Size_B);
 
-    //Signal we have completely filled an element of the input buffer.
-    m_oBuffer.elementWritten();
+    return queuePacket(u64Sequence);
+}
 
-    return true;
+void cConnectionThread::retirePacket(uint64_t u64Sequence, uint32_t u32Size_B)
+{
+    //The pin is held for one non-blocking send at most
+    while(m_u64PinnedSequence.load(boost::memory_order_seq_cst) <= u64Sequence)
+    {
+        boost::this_thread::yield();
+    }
+
+    //The sending side can no longer pin the packet so only this thread moves the read position now
+    uint64_t u64Read = getReadSequence();
+
+    if(u64Read != u64Sequence || u64Sequence >= m_u64EndSequence.load(boost::memory_order_relaxed))
+        return;
+
+    if(m_eSlowClientPolicy.load(boost::memory_order_relaxed) == SLOW_CLIENT_DISCONNECT && isValid())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cConnectionThread::retirePacket(): Client " << m_strPeerAddress << " lapped by the broadcast buffer. Disconnecting.";
+
+        setInvalid();
+        shutdown();
+    }
+
+    m_u64ReadSequence.store(u64Sequence + 1, boost::memory_order_release);
+    packetsDropped(1, u32Size_B);
 }
 
-void cConnectionThread::blockingAddDataToSend(char* cpData, uint32_t u32Size_B)
+void cConnectionThread::detachFromBroadcastBuffer()
 {
-    //Get (or wait for) the next available element to write data to
-    //If waiting timeout every 500 ms and check for shutdown or stop streaming flags
-    //This prevents the program locking up in this thread.
-    int32_t i32Index = -1;
-    while(i32Index == -1)
+    //Nothing is pinned after shutdown so once the current pin is released the writer no longer has to wait for this connection
+    shutdown();
+
+    while(m_u64PinnedSequence.load(boost::memory_order_seq_cst) != NOT_PINNED)
     {
-        i32Index = m_oBuffer.getNextWriteIndex(500);
+        boost::this_thread::yield();
+    }
+}
 
-        //Also check for shutdown flag
-        if(isShutdownRequested())
+bool cConnectionThread::tryQueuePacket(uint64_t u64Sequence, uint32_t u32Size_B)
+{
+    bool bWakeSender = false;
+
+    if(admitPacket(u64Sequence, u32Size_B, bWakeSender) && queuePacket(u64Sequence))
+        bWakeSender = true;
+
+    if(bWakeSender)
+        m_oWritingThreadNotifier.notify();
+
+    return bWakeSender;
+}
+
+bool cConnectionThread::admitPacket(uint64_t u64Sequence, uint32_t u32Size_B, bool &bWakeSender)
+{
+    uint64_t u64End = m_u64EndSequence.load(boost::memory_order_relaxed);
+
+    //After packets have been dropped for this client queueing resumes only once everything before the gap has been sent
+    if(u64End != u64Sequence)
+    {
+        if(getReadSequence() < u64End)
         {
-            cout << "cConnectionThread::blockingAddDataToSend() exiting on detection of shutdown flag." << endl;
-            return;
+            packetsDropped(1, u32Size_B);
+            return false;
+        }
+
+        return true;
+    }
+
+    uint32_t u32LagThreshold = m_u32LagThreshold.load(boost::memory_order_relaxed);
+
+    switch(m_eSlowClientPolicy.load(boost::memory_order_relaxed))
+    {
+    case SLOW_CLIENT_DISCONNECT:
+    {
+        if(getLag() < u32LagThreshold)
+            return true;
+
+        if(isValid())
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cConnectionThread::admitPacket(): Client " << m_strPeerAddress << " lagging by " << getLag()
+                                               << " packets. Disconnecting.";
+
+            setInvalid();
+            shutdown();
+        }
+
+        break;
+    }
+
+    case SLOW_CLIENT_BLOCK:
+    {
+        if(getLag() < u32LagThreshold)
+            return true;
+
+        boost::posix_time::ptime oStartTime = boost::posix_time::microsec_clock::universal_time();
+        boost::posix_time::ptime oDeadline = oStartTime + boost::posix_time::milliseconds(m_u32BlockTimeout_ms.load(boost::memory_order_relaxed));
+        bool bAdmitted = false;
+
+        while(!isShutdownRequested())
+        {
+            uint64_t u64Epoch = m_oSpaceNotifier.prepareWait();
+
+            if(getLag() < u32LagThreshold)
+            {
+                m_oSpaceNotifier.cancelWait();
+                bAdmitted = true;
+                break;
+            }
+
+            int64_t i64Remaining_ms = (oDeadline - boost::posix_time::microsec_clock::universal_time()).total_milliseconds();
+
+            if(i64Remaining_ms <= 0)
+            {
+                m_oSpaceNotifier.cancelWait();
+                break;
+            }
+
+            m_oSpaceNotifier.wait(u64Epoch, i64Remaining_ms);
         }
+
+        m_u64BlockedTime_us.fetch_add((boost::posix_time::microsec_clock::universal_time() - oStartTime).total_microseconds(), boost::memory_order_relaxed);
+
+        if(bAdmitted)
+            return true;
+
+        break;
+    }
+
+    case SLOW_CLIENT_DROP_OLDEST:
+    {
+        //The sending side drops the oldest packets. Wake it in case it is waiting for the socket, once the lag is half way
+        //from the threshold to the maximum so that it drops in chunks. Packets it does not get to in time are skipped when
+        //the broadcast buffer laps it.
+        if(getLag() >= u32LagThreshold + (getMaxLag() - u32LagThreshold) / 2)
+            bWakeSender = true;
+
+        return true;
+    }
+
+    default:
+        if(getLag() < u32LagThreshold)
+            return true;
+
+        break;
     }
 
-    //Check that our buffer is large enough
-    if(u32Size_B > m_oBuffer.getElementPointer(i32Index)->allocationSize())
+    packetsDropped(1, u32Size_B);
+    return false;
+}
+
+bool cConnectionThread::queuePacket(uint64_t u64Sequence)
+{
+    uint64_t u64PreviousEnd = m_u64EndSequence.load(boost::memory_order_relaxed);
+
+    //Resume after a gap. Start is published together with the end position.
+    if(u64PreviousEnd != u64Sequence)
+        m_u64StartSequence.store(u64Sequence, boost::memory_order_relaxed);
+
+    //Only wake the sending side if it had sent everything before. Sequentially consistent with the read position update
+    //and the following check of the end position in drainSendQueue(): either the sending side sees this packet before
+    //it goes idle or the read position is seen to have caught up here.
+    m_u64EndSequence.store(u64Sequence + 1, boost::memory_order_seq_cst);
+    bool bWasEmpty = m_u64ReadSequence.load(boost::memory_order_seq_cst) >= u64PreviousEnd;
+
+    //Only the adding thread raises the high water mark
+    uint32_t u32Lag = getLag();
+
+    if(u32Lag > m_u32LagHighWaterMark.load(boost::memory_order_relaxed))
+        m_u32LagHighWaterMark.store(u32Lag, boost::memory_order_relaxed);
+
+    return bWasEmpty;
+}
+
+void cConnectionThread::setSlowClientPolicy(slowClientPolicy ePolicy, uint32_t u32LagThreshold, uint32_t u32BlockTimeout_ms)
+{
+    uint32_t u32MaxLag = getMaxLag();
+
+    if(!u32LagThreshold)
+        u32LagThreshold = (ePolicy == SLOW_CLIENT_DROP_OLDEST) ? u32MaxLag / 2 : u32MaxLag;
+
+    if(u32LagThreshold > u32MaxLag)
+        u32LagThreshold = u32MaxLag;
+
+    //A timeout of 0 would block indefinitely
+    if(!u32BlockTimeout_ms)
+        u32BlockTimeout_ms = 1;
+
+    m_u32LagThreshold.store(u32LagThreshold);
+    m_u32BlockTimeout_ms.store(u32BlockTimeout_ms);
+    m_eSlowClientPolicy.store(ePolicy);
+}
+
+cConnectionThread::slowClientPolicy cConnectionThread::getSlowClientPolicy()
+{
+    return m_eSlowClientPolicy.load();
+}
+
+uint64_t cConnectionThread::getReadSequence()
+{
+    //Start only changes together with the end position so it is read after it
+    uint64_t u64Read = m_u64ReadSequence.load(boost::memory_order_acquire);
+    uint64_t u64Start = m_u64StartSequence.load(boost::memory_order_relaxed);
+
+    return u64Read > u64Start ? u64Read : u64Start;
+}
+
+uint32_t cConnectionThread::getLag()
+{
+    uint64_t u64End = m_u64EndSequence.load(boost::memory_order_acquire);
+    uint64_t u64Read = getReadSequence();
+
+    return u64End > u64Read ? u64End - u64Read : 0;
+}
+
+uint32_t cConnectionThread::getMaxLag()
+{
+    return m_pBroadcastBuffer->getNSlots();
+}
+
+bool cConnectionThread::hasDataToSend()
+{
+    return m_u32HeadBytesSent_B < m_vcHeadRemainder.size() || getLag();
+}
+
+uint64_t cConnectionThread::getNPacketsDropped()
+{
+    return m_u64NPacketsDropped.load(boost::memory_order_relaxed);
+}
+
+uint64_t cConnectionThread::getNBytesDropped()
+{
+    return m_u64NBytesDropped.load(boost::memory_order_relaxed);
+}
+
+uint64_t cConnectionThread::getNPacketsSent()
+{
+    return m_u64NPacketsSent.load(boost::memory_order_relaxed);
+}
+
+uint64_t cConnectionThread::getNBytesSent()
+{
+    return m_u64NBytesSent.load(boost::memory_order_relaxed);
+}
+
+uint64_t cConnectionThread::getNSocketErrors()
+{
+    return m_u64NSocketErrors.load(boost::memory_order_relaxed);
+}
+
+uint32_t cConnectionThread::getLagHighWaterMark()
+{
+    return m_u32LagHighWaterMark.load(boost::memory_order_relaxed);
+}
+
+uint64_t cConnectionThread::getBlockedTime_us()
+{
+    return m_u64BlockedTime_us.load(boost::memory_order_relaxed);
+}
+
+void cConnectionThread::packetsDropped(uint32_t u32NPackets, uint64_t u64NBytes)
+{
+    m_u64NPacketsDropped.fetch_add(u32NPackets, boost::memory_order_relaxed);
+    m_u64NBytesDropped.fetch_add(u64NBytes, boost::memory_order_relaxed);
+}
+
+bool cConnectionThread::pinReadSequence(uint64_t u64Sequence)
+{
+    //Sequentially consistent with cBroadcastBuffer::prepareWrite(): either the writer sees the pin and waits for it in
+    //retirePacket() or the packet is seen to be retired here.
+    m_u64PinnedSequence.store(u64Sequence, boost::memory_order_seq_cst);
+
+    //Likewise with detachFromBroadcastBuffer()
+    if(m_bShutdownFlag.load(boost::memory_order_seq_cst))
     {
-        cout << "cConnectionThread::blockingAddDataToSend(): Warning: Input buffer element size is too small for UDP packet." << endl;
-        cout << "Resizing to " << u32Size_B << " bytes" << endl;
+        unpin();
+        return false;
+    }
+
+    if(u64Sequence >= m_pBroadcastBuffer->getOldestSequence())
+        return true;
+
+    //Lapped. The writer skips this client ahead in retirePacket().
+    unpin();
+    boost::this_thread::yield();
+
+    return false;
+}
+
+void cConnectionThread::unpin()
+{
+    //Releases the read position moved while pinned to retirePacket()
+    m_u64PinnedSequence.store(NOT_PINNED, boost::memory_order_release);
+}
 
-        m_oBuffer.resize(m_oBuffer.getNElements(), u32Size_B);
+void cConnectionThread::dropOldestPackets()
+{
+    //Drop the oldest packets down to the lag threshold. A partially sent packet has already been copied out of the broadcast
+    //buffer and is always sent completely to keep the stream intact.
+
+    if(m_eSlowClientPolicy.load(boost::memory_order_relaxed) != SLOW_CLIENT_DROP_OLDEST)
+        return;
+
+    uint32_t u32LagThreshold = m_u32LagThreshold.load(boost::memory_order_relaxed);
+    uint64_t u64End = m_u64EndSequence.load(boost::memory_order_acquire);
+    uint64_t u64Read = getReadSequence();
+
+    if(u64End - u64Read <= u32LagThreshold || !pinReadSequence(u64Read))
+        return;
+
+    uint64_t u64NewRead = u64End - u32LagThreshold;
+    uint64_t u64NBytesDropped = 0;
+
+    for(uint64_t u64Sequence = u64Read; u64Sequence < u64NewRead; u64Sequence++)
+    {
+        u64NBytesDropped += m_pBroadcastBuffer->getDataSize(u64Sequence);
     }
 
-    memcpy(m_oBuffer.getElementDataPointer(i32Index), cpData, u32Size_B);
-    m_oBuffer.getElementPointer(i32Index)->setDataAdded(u32Size_B);
+    m_u64ReadSequence.store(u64NewRead, boost::memory_order_release);
+    unpin();
 
-    //Signal we have completely filled an element of the input buffer.
-    m_oBuffer.elementWritten();
+    packetsDropped(u64NewRead - u64Read, u64NBytesDropped);
+    m_oSpaceNotifier.notify();
 }
 
 void cConnectionThread::socketWritingThreadFunction()
 {
-    uint32_t u32BytesToTransfer = 0;
-    uint32_t u32BytesTransferred = 0;
-    int32_t i32Index = 0;
-    bool bSuccess = false;
+    while(!isShutdownRequested())
+    {
+        //Wait for data. Register for wakeups before checking so that a packet queued in the mean time is not missed.
+        uint64_t u64Epoch = m_oWritingThreadNotifier.prepareWait();
+
+        if(!hasDataToSend() && !isShutdownRequested())
+        {
+            m_oWritingThreadNotifier.wait(u64Epoch);
+            m_oWritingThreadNotifier.clearFileDescriptor();
+            continue;
+        }
+
+        m_oWritingThreadNotifier.cancelWait();
+
+        if(isShutdownRequested())
+            break;
+
+        //Send everything queued so far
+        drainResult eResult = drainSendQueue();
+
+        if(eResult == DRAIN_FAILED)
+            return;
+
+        if(eResult == DRAIN_WOULD_BLOCK && !waitForWritableSocket())
+            return;
+    }
+
+    string strSocketName;
+    if(getSocketName().length())
+        strSocketName = " (" + getSocketName() + ")";
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cConnectionThread::socketWritingThreadFunction(): Shutdown requested, aborting writing next packet to peer "
+                                    << m_strPeerAddress << strSocketName;
+}
+
+bool cConnectionThread::waitForWritableSocket()
+{
+    //Wait until the socket's send buffer has space or shutdown is requested. Returns false on error or shutdown.
+
+#ifdef __linux__
+    while(!isShutdownRequested())
+    {
+        //Register for wakeups before checking the flag again so that shutdown() is not missed
+        m_oWritingThreadNotifier.prepareWait();
+
+        if(isShutdownRequested())
+        {
+            m_oWritingThreadNotifier.cancelWait();
+            break;
+        }
+
+        pollfd aoPollFileDescriptors[2];
+        aoPollFileDescriptors[0].fd = getNativeSocketHandle();
+        aoPollFileDescriptors[0].events = POLLOUT;
+        aoPollFileDescriptors[0].revents = 0;
+        aoPollFileDescriptors[1].fd = m_oWritingThreadNotifier.getFileDescriptor();
+        aoPollFileDescriptors[1].events = POLLIN;
+        aoPollFileDescriptors[1].revents = 0;
+
+        int iResult = poll(aoPollFileDescriptors, 2, -1);
+
+        m_oWritingThreadNotifier.clearFileDescriptor();
+        m_oWritingThreadNotifier.cancelWait();
+
+        if(iResult < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cConnectionThread::waitForWritableSocket(): poll() failed for peer " << m_strPeerAddress << ". Error was: " << strerror(errno);
+            m_u64NSocketErrors.fetch_add(1, boost::memory_order_relaxed);
+            setInvalid();
+            return false;
+        }
+
+        if(aoPollFileDescriptors[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cConnectionThread::waitForWritableSocket(): Connection to peer " << m_strPeerAddress << " lost.";
+            m_u64NSocketErrors.fetch_add(1, boost::memory_order_relaxed);
+            setInvalid();
+            return false;
+        }
+
+        if(aoPollFileDescriptors[0].revents & POLLOUT)
+            return true;
+
+        //Woken while the socket is still full
+        dropOldestPackets();
+    }
+
+    return false;
+#else
+    //The socket class sends with its own timeout, simply retry
+    return !isShutdownRequested();
+#endif
+}
+
+cConnectionThread::drainResult cConnectionThread::drainSendQueue()
+{
+#ifdef __linux__
+    int iSocket = getNativeSocketHandle();
+
+    //One extra vector for the rest of a partially sent packet
+    iovec aoIOVecs[MAX_PACKETS_PER_SEND + 1];
 
     while(!isShutdownRequested())
     {
-        //Get a new buffer element's worth of data and send it.
+        dropOldestPackets();
+
+        uint32_t u32NIOVecs = 0;
+        uint32_t u32HeadRemainderSize_B = m_vcHeadRemainder.size() - m_u32HeadBytesSent_B;
 
-        //Get (or wait for) the next available element to read data from
-        //If waiting timeout every 500 ms and check for shutdown or stop streaming flags
-        //This prevents the program locking up in this thread.
-        i32Index = -1;
-        while(i32Index == -1)
+        if(u32HeadRemainderSize_B)
         {
-            i32Index = m_oBuffer.getNextReadIndex(500);
+            aoIOVecs[0].iov_base = &m_vcHeadRemainder[m_u32HeadBytesSent_B];
+            aoIOVecs[0].iov_len = u32HeadRemainderSize_B;
+            u32NIOVecs = 1;
+        }
 
-            //Also check for shutdown flag
-            if(isShutdownRequested())
+        //Gather the payload of every ready packet (only the data, never the unused part of a slot). The packets stay pinned
+        //until the send has returned. (Sequentially consistent with queuePacket(), see there.)
+        uint64_t u64End = m_u64EndSequence.load(boost::memory_order_seq_cst);
+        uint64_t u64Read = getReadSequence();
+        uint32_t u32NPackets = 0;
+
+        if(u64Read < u64End)
+        {
+            if(!pinReadSequence(u64Read))
+                continue;
+
+            u32NPackets = u64End - u64Read < MAX_PACKETS_PER_SEND ? u64End - u64Read : MAX_PACKETS_PER_SEND;
+
+            for(uint32_t ui = 0; ui < u32NPackets; ui++)
             {
-                cout << "cConnectionThread::socketWritingThreadFunction(): Shutdown requested, aborting writing next packet to peer " << m_strPeerAddress;
-                
-                if(getSocketName().length())
-                    cout << " (" << getSocketName() << ")";
-                
-                cout << endl;
-
-                return;
+                aoIOVecs[u32NIOVecs + ui].iov_base = m_pBroadcastBuffer->getDataPointer(u64Read + ui);
+                aoIOVecs[u32NIOVecs + ui].iov_len = m_pBroadcastBuffer->getDataSize(u64Read + ui);
             }
         }
-        u32BytesToTransfer = m_oBuffer.getElementPointer(i32Index)->allocationSize();
-        u32BytesTransferred = 0;
-        while(u32BytesToTransfer)
+
+        if(!u32NIOVecs && !u32NPackets)
+            return DRAIN_COMPLETE;
+
+        msghdr oMessage;
+        memset(&oMessage, 0, sizeof(oMessage));
+        oMessage.msg_iov = aoIOVecs;
+        oMessage.msg_iovlen = u32NIOVecs + u32NPackets;
+
+        ssize_t i64NBytesSent = sendmsg(iSocket, &oMessage, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+        if(i64NBytesSent < 0)
         {
-            bSuccess = m_pSocket->send(m_oBuffer.getElementDataPointer(i32Index) + u32BytesTransferred, u32BytesToTransfer);
+            int iError = errno;
 
-            if(!bSuccess)
-                break;
+            if(u32NPackets)
+                unpin();
+
+            if(iError == EAGAIN || iError == EWOULDBLOCK)
+                return DRAIN_WOULD_BLOCK;
+
+            if(iError == EINTR)
+                continue;
 
-            u32BytesToTransfer -= m_pSocket->getNBytesLastWritten();
-            u32BytesTransferred += m_pSocket->getNBytesLastWritten();
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cConnectionThread::drainSendQueue(): Write failed to peer " << m_strPeerAddress << ". Error was: " << strerror(iError);
+            m_u64NSocketErrors.fetch_add(1, boost::memory_order_relaxed);
+
+            //Mark connection as failed and stop sending data
+            setInvalid();
+            return DRAIN_FAILED;
         }
 
-        if(!bSuccess)
+        //Count the packets that are now completely written. The kernel may have taken only part of the batch.
+        uint32_t u32NPacketsSent = 0;
+        uint64_t u64NBytesRemaining = i64NBytesSent;
+
+        if(u32NIOVecs)
         {
-            cout << "cConnectionThread::socketWritingThreadFunction(): Write failed to peer " << m_strPeerAddress << ". Error was: " << m_pSocket->getLastWriteError() << endl;
-            if(m_pSocket->getLastWriteError())
+            if(u64NBytesRemaining < u32HeadRemainderSize_B)
             {
-                //Mark connection as failed and stop sending data
-                setInvalid();
-                return;
+                m_u32HeadBytesSent_B += u64NBytesRemaining;
+                u64NBytesRemaining = 0;
             }
             else
             {
-                continue; //Otherwise the sending fail for other reasons e.g. timeout, try again from the beginning.
+                u64NBytesRemaining -= u32HeadRemainderSize_B;
+                m_vcHeadRemainder.clear();
+                m_u32HeadBytesSent_B = 0;
+                u32NPacketsSent++;
             }
         }
 
+        uint32_t u32NPacketsRead = 0;
 
-        m_oBuffer.elementRead(); //Otherwise write is complete. Signal to pop element off FIFO
-        //cout << "cConnectionThread::socketWritingThreadFunction(): Wrote data to client " << getPeerAddress() << endl;
+        while(u32NPacketsRead < u32NPackets && u64NBytesRemaining >= aoIOVecs[u32NIOVecs + u32NPacketsRead].iov_len)
+        {
+            u64NBytesRemaining -= aoIOVecs[u32NIOVecs + u32NPacketsRead].iov_len;
+            u32NPacketsRead++;
+        }
+
+        u32NPacketsSent += u32NPacketsRead;
+
+        //Keep the rest of a partially sent packet so that its slot can be replaced
+        if(u64NBytesRemaining)
+        {
+            char *cpPacket = (char*)aoIOVecs[u32NIOVecs + u32NPacketsRead].iov_base;
+
+            m_vcHeadRemainder.assign(cpPacket + u64NBytesRemaining, cpPacket + aoIOVecs[u32NIOVecs + u32NPacketsRead].iov_len);
+            m_u32HeadBytesSent_B = 0;
+            u32NPacketsRead++;
+        }
+
+        if(u32NPackets)
+        {
+            m_u64ReadSequence.store(u64Read + u32NPacketsRead, boost::memory_order_seq_cst);
+            unpin();
+        }
+
+        m_u64NBytesSent.fetch_add(i64NBytesSent, boost::memory_order_relaxed);
+        m_u64NPacketsSent.fetch_add(u32NPacketsSent, boost::memory_order_relaxed);
+
+        if(u32NPacketsRead)
+            m_oSpaceNotifier.notify();
+    }
+
+    return DRAIN_COMPLETE;
+#else
+    //Blocking per packet sends through the socket class. Each packet is copied out of the broadcast buffer first as it can not
+    //be pinned for the duration of a blocking send.
+    while(!isShutdownRequested())
+    {
+        dropOldestPackets();
+
+        if(m_u32HeadBytesSent_B == m_vcHeadRemainder.size())
+        {
+            uint64_t u64End = m_u64EndSequence.load(boost::memory_order_seq_cst); //See queuePacket()
+            uint64_t u64Read = getReadSequence();
+
+            if(u64Read == u64End)
+                break;
+
+            if(!pinReadSequence(u64Read))
+                continue;
+
+            char *cpPacket = m_pBroadcastBuffer->getDataPointer(u64Read);
+
+            m_vcHeadRemainder.assign(cpPacket, cpPacket + m_pBroadcastBuffer->getDataSize(u64Read));
+            m_u32HeadBytesSent_B = 0;
+
+            m_u64ReadSequence.store(u64Read + 1, boost::memory_order_seq_cst);
+            unpin();
+
+            m_oSpaceNotifier.notify();
+        }
+
+        while(m_u32HeadBytesSent_B < m_vcHeadRemainder.size())
+        {
+            if(!m_pSocket->send(&m_vcHeadRemainder[m_u32HeadBytesSent_B], m_vcHeadRemainder.size() - m_u32HeadBytesSent_B))
+            {
+                AVN_LOG(cLogger::SEVERITY_ERROR) << "cConnectionThread::drainSendQueue(): Write failed to peer " << m_strPeerAddress << ". Error was: " << m_pSocket->getLastWriteError();
+                m_u64NSocketErrors.fetch_add(1, boost::memory_order_relaxed);
+
+                if(m_pSocket->getLastWriteError())
+                {
+                    //Mark connection as failed and stop sending data
+                    setInvalid();
+                    return DRAIN_FAILED;
+                }
+
+                return DRAIN_WOULD_BLOCK; //Otherwise the sending failed for other reasons e.g. timeout, try again.
+            }
+
+            m_u32HeadBytesSent_B += m_pSocket->getNBytesLastWritten();
+            m_u64NBytesSent.fetch_add(m_pSocket->getNBytesLastWritten(), boost::memory_order_relaxed);
+        }
+
+        //Write is complete
+        m_vcHeadRemainder.clear();
+        m_u32HeadBytesSent_B = 0;
+
+        m_u64NPacketsSent.fetch_add(1, boost::memory_order_relaxed);
     }
+
+    return DRAIN_COMPLETE;
+#endif
+}
+
+int cConnectionThread::getNativeSocketHandle()
+{
+    return m_pSocket->getBoostSocketPointer()->native_handle();
 }
 
 string cConnectionThread::getPeerAddress()
@@ -208,3 +793,9 @@ string cConnectionThread::getSocketName()
 {
     return m_pSocket->getName();
 }
+
+void cConnectionThread::setThreadPlacement(const cThreadPlacement &oPlacement)
+{
+    if(m_pSocketWritingThread.get())
+        oPlacement.apply(*m_pSocketWritingThread, "socket writing (" + getPeerAddress() + ")");
+}
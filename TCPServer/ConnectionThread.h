@@ -17,26 +17,88 @@ typedef unsigned __int64 uint64_t;
 #include <inttypes.h>
 #endif
 
+#include <vector>
+
 //Library include:
 #ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
 #include <boost/thread.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
 #endif
 
 //Local includes
-#include "../../../AVNUtilLibs/DataStructures/ThreadSafeCircularBuffer/ThreadSafeCircularBuffer.h"
+#include "BroadcastBuffer.h"
+#include "../EventNotifier/EventNotifier.h"
+#include "../ThreadPlacement/ThreadPlacement.h"
 #include "../../../AVNUtilLibs/Sockets/InterruptibleBlockingSockets/InterruptibleBlockingTCPSocket.h"
 #include "../UDPReceiver/UDPReceiver.h"
 
 class cConnectionThread
 {
 public:
-    explicit cConnectionThread(boost::shared_ptr<cInterruptibleBlockingTCPSocket> pClientSocket);
+    //What to do when the client does not keep up with the data rate:
+    //SLOW_CLIENT_DROP_NEWEST: Packets that do not fit in the client's queue are dropped. (Default)
+    //SLOW_CLIENT_DROP_OLDEST: The oldest unsent packets are dropped to keep the queue at the lag threshold.
+    //SLOW_CLIENT_DISCONNECT: The client is disconnected once the lag reaches the threshold.
+    //SLOW_CLIENT_BLOCK: Adding data waits for space in the queue for up to the block timeout, then drops the packet.
+    //This holds up all clients of a server so the timeout should be short.
+    //Once a packet has been dropped for a client the following ones are dropped too until it has sent everything queued
+    //before, so that its stream continues with one gap instead of many.
+    enum slowClientPolicy
+    {
+        SLOW_CLIENT_DROP_NEWEST = 0,
+        SLOW_CLIENT_DROP_OLDEST,
+        SLOW_CLIENT_DISCONNECT,
+        SLOW_CLIENT_BLOCK
+    };
+
+    enum drainResult
+    {
+        DRAIN_COMPLETE = 0,
+        DRAIN_WOULD_BLOCK,
+        DRAIN_FAILED
+    };
+
+    static const uint32_t                               SEND_QUEUE_LENGTH = 512; //Slots of the private broadcast buffer
+
+    //Packets are sent from a broadcast buffer, each connection keeping its own position in it. If none is given the connection
+    //uses a private one which is filled with tryAddDataToSend() or blockingAddDataToSend(). Without a writing thread the
+    //queue is sent by calling drainSendQueue() (see cEventLoopThread).
+    explicit cConnectionThread(boost::shared_ptr<cInterruptibleBlockingTCPSocket> pClientSocket,
+                               boost::shared_ptr<cBroadcastBuffer> pBroadcastBuffer = boost::shared_ptr<cBroadcastBuffer>(),
+                               bool bStartWritingThread = true);
     ~cConnectionThread();
 
+    //Private broadcast buffer only. Packets must be added from one thread only.
     bool                                                tryAddDataToSend(char* cpData, uint32_t u32Size_B);
     void                                                blockingAddDataToSend(char* cpData, uint32_t u32Size_B);
 
+    //Shared broadcast buffer, called by its writer. retirePacket() before the packet's slot is reused (see
+    //cBroadcastBuffer::prepareWrite()): waits if the packet is being sent right now and skips this client past it if it has
+    //not been sent yet. tryQueuePacket() once the new packet is written: queues it for this client according to the slow
+    //client policy. It returns true if the sending side has to be woken because it may have sent everything before or has
+    //packets to drop. A writing thread is woken here, an event loop has to be notified by the caller.
+    void                                                retirePacket(uint64_t u64Sequence, uint32_t u32Size_B);
+    bool                                                tryQueuePacket(uint64_t u64Sequence, uint32_t u32Size_B);
+    void                                                detachFromBroadcastBuffer(); //Shuts down. After this the writer may forget the connection.
+
+    //Lag is measured in packets queued. A threshold of 0 selects the default for the policy (half the maximum lag for
+    //SLOW_CLIENT_DROP_OLDEST, the maximum lag otherwise).
+    void                                                setSlowClientPolicy(slowClientPolicy ePolicy, uint32_t u32LagThreshold = 0, uint32_t u32BlockTimeout_ms = 10);
+    slowClientPolicy                                    getSlowClientPolicy();
+
+    uint32_t                                            getLag();
+    uint32_t                                            getMaxLag(); //The broadcast buffer's slots
+    uint64_t                                            getNPacketsDropped();
+    uint64_t                                            getNBytesDropped();
+
+    //Statistics. Atomic counters, reading them takes no locks.
+    uint64_t                                            getNPacketsSent();
+    uint64_t                                            getNBytesSent();
+    uint64_t                                            getNSocketErrors();
+    uint32_t                                            getLagHighWaterMark();
+    uint64_t                                            getBlockedTime_us(); //Time spent waiting for queue space (SLOW_CLIENT_BLOCK)
+
     bool                                                isValid();
     void                                                setInvalid();
 
@@ -46,14 +108,25 @@ public:
     std::string                                         getPeerAddress();
     std::string                                         getSocketName();
 
+    //Applies to the writing thread if there is one
+    void                                                setThreadPlacement(const cThreadPlacement &oPlacement);
+
+    //Send as much of the queue as the socket accepts without blocking. Ready packets are coalesced into one vectored send.
+    //Used by the writing thread and in event loop mode. Call from one thread only.
+    drainResult                                         drainSendQueue();
+    void                                                dropOldestPackets(); //Applies SLOW_CLIENT_DROP_OLDEST. Sending thread only.
+    int                                                 getNativeSocketHandle();
+
 private:
     std::string                                         m_strPeerAddress;
 
-    bool                                                m_bShutdownFlag;
-    boost::shared_mutex                                 m_bShutdownFlagMutex;
+    boost::atomic<bool>                                 m_bShutdownFlag;
+    cEventNotifier                                      m_oWritingThreadNotifier; //Wakes the writing thread for data or while it waits for the socket
+    cEventNotifier                                      m_oSpaceNotifier; //Signalled when the sending side has moved on (SLOW_CLIENT_BLOCK)
 
     //Thread functions
     void                                                socketWritingThreadFunction();
+    bool                                                waitForWritableSocket();
 
     //Threads
     boost::scoped_ptr<boost::thread>                   m_pSocketWritingThread;
@@ -63,8 +136,45 @@ private:
     bool                                               m_bIsValid;
     boost::shared_mutex                                m_bValidMutex;
 
-    //Circular buffers
-    cThreadSafeCircularBuffer<char>                    m_oBuffer;
+    //Packets [max(read, start), end) of the broadcast buffer are queued for this client. The read position is moved by the
+    //sending side while it has pinned it and by retirePacket() otherwise. Start and end are moved by the writer. Start skips
+    //the packets dropped for this client before queueing resumes.
+    boost::shared_ptr<cBroadcastBuffer>                m_pBroadcastBuffer;
+    boost::atomic<uint64_t>                            m_u64ReadSequence;
+    boost::atomic<uint64_t>                            m_u64StartSequence;
+    boost::atomic<uint64_t>                            m_u64EndSequence;
+    boost::atomic<uint64_t>                            m_u64PinnedSequence; //First packet being read by the sending side, if any
+
+    //The unsent rest of a partially sent packet. Copied out of the broadcast buffer so that the packet can be replaced without
+    //breaking the stream.
+    std::vector<char>                                  m_vcHeadRemainder;
+    uint32_t                                           m_u32HeadBytesSent_B;
+
+    //Slow client handling
+    boost::atomic<slowClientPolicy>                    m_eSlowClientPolicy;
+    boost::atomic<uint32_t>                            m_u32LagThreshold;
+    boost::atomic<uint32_t>                            m_u32BlockTimeout_ms;
+
+    boost::atomic<uint64_t>                            m_u64NPacketsDropped;
+    boost::atomic<uint64_t>                            m_u64NBytesDropped;
+
+    //Statistics
+    boost::atomic<uint64_t>                            m_u64NPacketsSent;
+    boost::atomic<uint64_t>                            m_u64NBytesSent;
+    boost::atomic<uint64_t>                            m_u64NSocketErrors;
+    boost::atomic<uint32_t>                            m_u32LagHighWaterMark;
+    boost::atomic<uint64_t>                            m_u64BlockedTime_us;
+
+    void                                               packetsDropped(uint32_t u32NPackets, uint64_t u64NBytes);
+
+    uint64_t                                           getReadSequence(); //Effective read position, taking start into account
+    bool                                               hasDataToSend();
+    //The following return (or set) whether the sending side has to be woken, see tryQueuePacket()
+    bool                                               writePacket(char* cpData, uint32_t u32Size_B); //Private broadcast buffer
+    bool                                               admitPacket(uint64_t u64Sequence, uint32_t u32Size_B, bool &bWakeSender); //Slow client policy
+    bool                                               queuePacket(uint64_t u64Sequence);
+    bool                                               pinReadSequence(uint64_t u64Sequence); //False if the packet has been retired
+    void                                               unpin();
 
 };
 
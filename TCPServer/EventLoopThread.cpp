@@ -0,0 +1,250 @@
+//System includes
+#include <cstring>
+#include <cerrno>
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <unistd.h>
+#endif
+
+//Local includes
+#include "EventLoopThread.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+namespace
+{
+    //Sockets reported by one call to epoll_wait()
+    const int MAX_EPOLL_EVENTS = 64;
+}
+
+cEventLoopThread::cEventLoopThread() :
+    m_bShutdownFlag(false),
+    m_iEpollFileDescriptor(-1),
+    m_oNotifier(true),
+    m_u32NConnections(0)
+{
+#ifdef __linux__
+    m_iEpollFileDescriptor = epoll_create1(EPOLL_CLOEXEC);
+
+    if(m_iEpollFileDescriptor < 0)
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cEventLoopThread::cEventLoopThread(): Error: Unable to create epoll instance: " << strerror(errno);
+        return;
+    }
+
+    //The notifier wakes the loop when data is queued. It is identified by a NULL pointer in the event data.
+    epoll_event oEvent;
+    memset(&oEvent, 0, sizeof(oEvent));
+    oEvent.events = EPOLLIN;
+    oEvent.data.ptr = NULL;
+
+    epoll_ctl(m_iEpollFileDescriptor, EPOLL_CTL_ADD, m_oNotifier.getFileDescriptor(), &oEvent);
+
+    m_pEventLoopThread.reset(new boost::thread(&cEventLoopThread::eventLoopThreadFunction, this));
+#else
+    AVN_LOG(cLogger::SEVERITY_ERROR) << "cEventLoopThread::cEventLoopThread(): Error: The event loop is only implemented for Linux.";
+#endif
+}
+
+cEventLoopThread::~cEventLoopThread()
+{
+    shutdown();
+
+#ifdef __linux__
+    if(m_iEpollFileDescriptor >= 0)
+        close(m_iEpollFileDescriptor);
+#endif
+}
+
+void cEventLoopThread::addConnection(boost::shared_ptr<cConnectionThread> pConnection)
+{
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oNewConnectionsMutex);
+        m_vpNewConnections.push_back(pConnection);
+    }
+
+    m_u32NConnections.fetch_add(1);
+
+    m_oNotifier.notify();
+}
+
+uint32_t cEventLoopThread::getNConnections()
+{
+    return m_u32NConnections.load();
+}
+
+void cEventLoopThread::notifyDataQueued()
+{
+    m_oNotifier.notify();
+}
+
+void cEventLoopThread::shutdown()
+{
+    m_bShutdownFlag.store(true);
+
+    m_oNotifier.notify();
+
+    if(m_pEventLoopThread.get())
+    {
+        m_pEventLoopThread->join();
+    }
+}
+
+bool cEventLoopThread::isShutdownRequested()
+{
+    return m_bShutdownFlag.load(boost::memory_order_relaxed);
+}
+
+void cEventLoopThread::setThreadPlacement(const cThreadPlacement &oPlacement)
+{
+    if(m_pEventLoopThread.get())
+        oPlacement.apply(*m_pEventLoopThread, string("event loop"));
+}
+
+void cEventLoopThread::adoptNewConnections()
+{
+    vector<boost::shared_ptr<cConnectionThread> > vpNewConnections;
+
+    {
+        boost::unique_lock<boost::mutex> oLock(m_oNewConnectionsMutex);
+        vpNewConnections.swap(m_vpNewConnections);
+    }
+
+#ifdef __linux__
+    for(uint32_t ui = 0; ui < vpNewConnections.size(); ui++)
+    {
+        cConnectionEntry oEntry;
+        oEntry.m_pConnection = vpNewConnections[ui];
+        oEntry.m_bWaitingForSocket = false;
+
+        //Edge triggered: only woken when the socket becomes writable again after a send returned EAGAIN or on errors.
+        //The entry is identified by its connection pointer which is stable for the connection's lifetime.
+        epoll_event oEvent;
+        memset(&oEvent, 0, sizeof(oEvent));
+        oEvent.events = EPOLLOUT | EPOLLET;
+        oEvent.data.ptr = oEntry.m_pConnection.get();
+
+        if(epoll_ctl(m_iEpollFileDescriptor, EPOLL_CTL_ADD, oEntry.m_pConnection->getNativeSocketHandle(), &oEvent) < 0)
+        {
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cEventLoopThread::adoptNewConnections(): Unable to watch socket of peer " << oEntry.m_pConnection->getPeerAddress()
+                                             << ": " << strerror(errno) << ". Closing connection.";
+
+            oEntry.m_pConnection->setInvalid();
+            m_u32NConnections.fetch_sub(1);
+            continue;
+        }
+
+        m_oConnections[oEntry.m_pConnection.get()] = oEntry;
+    }
+#endif
+}
+
+void cEventLoopThread::removeConnection(connectionMap::iterator &oIterator)
+{
+#ifdef __linux__
+    //Stop watching the socket before the connection (and so the socket) can be destroyed
+    epoll_ctl(m_iEpollFileDescriptor, EPOLL_CTL_DEL, oIterator->second.m_pConnection->getNativeSocketHandle(), NULL);
+#endif
+
+    m_oConnections.erase(oIterator++);
+    m_u32NConnections.fetch_sub(1);
+}
+
+void cEventLoopThread::eventLoopThreadFunction()
+{
+#ifdef __linux__
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cEventLoopThread::eventLoopThreadFunction(): Entered thread function.";
+
+    epoll_event aoEvents[MAX_EPOLL_EVENTS];
+
+    while(!isShutdownRequested())
+    {
+        //Register for wakeups before looking at the queues so that no notification is missed
+        m_oNotifier.prepareWait();
+
+        adoptNewConnections();
+
+        //Send everything queued for connections whose sockets can take more data
+        for(connectionMap::iterator it = m_oConnections.begin(); it != m_oConnections.end();)
+        {
+            cConnectionEntry &oEntry = it->second;
+
+            if(!oEntry.m_pConnection->isValid())
+            {
+                removeConnection(it);
+                continue;
+            }
+
+            if(!oEntry.m_bWaitingForSocket)
+            {
+                cConnectionThread::drainResult eResult = oEntry.m_pConnection->drainSendQueue();
+
+                if(eResult == cConnectionThread::DRAIN_FAILED)
+                {
+                    removeConnection(it);
+                    continue;
+                }
+
+                oEntry.m_bWaitingForSocket = (eResult == cConnectionThread::DRAIN_WOULD_BLOCK);
+            }
+            else
+            {
+                //Keep the lag of blocked clients in check
+                oEntry.m_pConnection->dropOldestPackets();
+            }
+
+            ++it;
+        }
+
+        int iNEvents = epoll_wait(m_iEpollFileDescriptor, aoEvents, MAX_EPOLL_EVENTS, -1);
+
+        m_oNotifier.cancelWait();
+
+        if(iNEvents < 0)
+        {
+            if(errno == EINTR)
+                continue;
+
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cEventLoopThread::eventLoopThreadFunction(): Error: epoll_wait() failed: " << strerror(errno);
+            break;
+        }
+
+        for(int i = 0; i < iNEvents; i++)
+        {
+            if(!aoEvents[i].data.ptr)
+            {
+                m_oNotifier.clearFileDescriptor();
+                continue;
+            }
+
+            connectionMap::iterator it = m_oConnections.find((cConnectionThread*)aoEvents[i].data.ptr);
+
+            if(it == m_oConnections.end())
+                continue;
+
+            if(aoEvents[i].events & (EPOLLERR | EPOLLHUP))
+            {
+                AVN_LOG(cLogger::SEVERITY_INFO) << "cEventLoopThread::eventLoopThreadFunction(): Peer " << it->second.m_pConnection->getPeerAddress() << " disconnected.";
+
+                it->second.m_pConnection->setInvalid();
+                removeConnection(it);
+            }
+            else if(aoEvents[i].events & EPOLLOUT)
+            {
+                it->second.m_bWaitingForSocket = false;
+            }
+        }
+    }
+
+    //Drop all connections. They are closed once the server releases them too.
+    for(connectionMap::iterator it = m_oConnections.begin(); it != m_oConnections.end();)
+    {
+        it->second.m_pConnection->shutdown();
+        removeConnection(it);
+    }
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cEventLoopThread::eventLoopThreadFunction(): Returning from thread function.";
+#endif
+}
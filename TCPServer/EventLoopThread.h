@@ -0,0 +1,90 @@
+#ifndef EVENT_LOOP_THREAD_H
+#define EVENT_LOOP_THREAD_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <vector>
+#include <map>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/thread.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/atomic.hpp>
+#endif
+
+//Local includes
+#include "ConnectionThread.h"
+#include "../EventNotifier/EventNotifier.h"
+#include "../ThreadPlacement/ThreadPlacement.h"
+
+//Sends the queues of many connections from a single thread. Sockets are written without blocking and only watched with
+//epoll while the kernel's send buffer is full. The thread sleeps until data is queued (notifyDataQueued()) or a socket
+//becomes writable again. Connections must be created without their own writing thread. Linux only.
+
+class cEventLoopThread
+{
+public:
+    cEventLoopThread();
+    ~cEventLoopThread();
+
+    void                                                addConnection(boost::shared_ptr<cConnectionThread> pConnection);
+    uint32_t                                            getNConnections();
+
+    //Call when a connection of this loop has to be looked at again: a packet was queued that it has to be woken for (see
+    //cConnectionThread::tryQueuePacket()) or it was closed
+    void                                                notifyDataQueued();
+
+    void                                                shutdown();
+    bool                                                isShutdownRequested();
+
+    void                                                setThreadPlacement(const cThreadPlacement &oPlacement);
+
+private:
+    class cConnectionEntry
+    {
+    public:
+        boost::shared_ptr<cConnectionThread>            m_pConnection;
+        bool                                            m_bWaitingForSocket; //Send buffer was full, wait for EPOLLOUT
+    };
+
+    typedef std::map<cConnectionThread*, cConnectionEntry> connectionMap; //Keyed by the pointer registered with epoll
+
+    boost::atomic<bool>                                 m_bShutdownFlag;
+
+    int                                                 m_iEpollFileDescriptor;
+    cEventNotifier                                      m_oNotifier;
+
+    //Connections handed over by other threads, adopted by the event loop on its next iteration
+    std::vector<boost::shared_ptr<cConnectionThread> >  m_vpNewConnections;
+    boost::mutex                                        m_oNewConnectionsMutex;
+
+    connectionMap                                       m_oConnections; //Event loop thread only
+    boost::atomic<uint32_t>                             m_u32NConnections;
+
+    //Thread functions
+    void                                                eventLoopThreadFunction();
+
+    void                                                adoptNewConnections();
+    void                                                removeConnection(connectionMap::iterator &oIterator); //Advances the iterator
+
+    //Threads
+    boost::scoped_ptr<boost::thread>                    m_pEventLoopThread;
+};
+
+#endif //EVENT_LOOP_THREAD_H
@@ -1,22 +1,70 @@
 
 //System includes
 #include <sstream>
+#include <cerrno>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
 
 //Library include:
 #ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
 #include <boost/shared_ptr.hpp>
 #include <boost/make_shared.hpp>
+#include <boost/asio/ip/tcp.hpp>
 #endif
 
 //Local includes
 #include "TCPServer.h"
+#include "../Logger/Logger.h"
+
+namespace
+{
+    //Broadcast buffer ring of about 1 MB. Clients more than this many packets behind are lapped. 1040 bytes for each complex
+    //uint32_t FFT window of 2 channels or or I,Q,U,V uint32_t stokes parameters.
+    const uint32_t BROADCAST_BUFFER_N_SLOTS = 1024;
+    const uint32_t DEFAULT_SLOT_SIZE_B = 1040;
+
+#ifdef __linux__
+    //Closes the socket, if any, and throws the error of the failed call
+    void throwSocketError(int iSocketFD, const char *cpOperation)
+    {
+        boost::system::error_code oError(errno, boost::system::system_category());
+
+        if(iSocketFD >= 0)
+            ::close(iSocketFD);
 
-cTCPServer::cTCPServer(const std::string &strInterface, uint16_t u16Port, uint32_t u32MaxConnections) :
+        throw boost::system::system_error(oError, cpOperation);
+    }
+#endif
+}
+
+cTCPServer::cTCPServer(const std::string &strInterface, uint16_t u16Port, uint32_t u32MaxConnections, uint32_t u32NEventLoopThreads) :
     m_bShutdownFlag(false),
     m_u32MaxConnections(u32MaxConnections),
     m_strInterface(strInterface),
-    m_u16Port(u16Port)
+    m_u16Port(u16Port),
+    m_iListeningSocketFD(-1),
+    m_oListeningThreadNotifier(true),
+    m_pBroadcastBuffer(new cBroadcastBuffer(BROADCAST_BUFFER_N_SLOTS, DEFAULT_SLOT_SIZE_B)),
+    m_eSlowClientPolicy(cConnectionThread::SLOW_CLIENT_DROP_NEWEST),
+    m_u32LagThreshold(0),
+    m_u32BlockTimeout_ms(10)
 {
+#ifdef __linux__
+    for(uint32_t ui = 0; ui < u32NEventLoopThreads; ui++)
+    {
+        m_vpEventLoopThreads.push_back(boost::make_shared<cEventLoopThread>());
+    }
+#else
+    if(u32NEventLoopThreads)
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPServer::cTCPServer(): Warning: Event loop mode is only available on Linux. Using a writing thread per connection.";
+#endif
+
+    m_vbEventLoopsToNotify.resize(m_vpEventLoopThreads.size(), false);
+
     m_pSocketListeningThread.reset(new boost::thread(&cTCPServer::socketListeningThreadFunction, this));
 }
 
@@ -27,6 +75,7 @@ cTCPServer::~cTCPServer()
     {
         boost::unique_lock<boost::shared_mutex>  oLock(m_oConnectThreadsMutex);
         m_vpConnectionThreads.clear();
+        m_vu32ConnectionEventLoops.clear();
     }
 }
 
@@ -37,13 +86,22 @@ void cTCPServer::shutdown()
         m_bShutdownFlag = true;
     }
 
+#ifdef __linux__
+    m_oListeningThreadNotifier.notify();
+#else
     if(m_oTCPAcceptor.isOpen())
         m_oTCPAcceptor.close();
+#endif
 
     if(m_pSocketListeningThread.get())
     {
         m_pSocketListeningThread->join();
     }
+
+    for(uint32_t ui = 0; ui < m_vpEventLoopThreads.size(); ui++)
+    {
+        m_vpEventLoopThreads[ui]->shutdown();
+    }
 }
 
 bool cTCPServer::isShutdownRequested()
@@ -60,31 +118,29 @@ void cTCPServer::socketListeningThreadFunction()
     while(!isShutdownRequested())
     {
         //If the listening socket exists already close it
-        if(m_oTCPAcceptor.isOpen())
-            m_oTCPAcceptor.close();
+        closeListeningSocket();
 
         //Listen for incoming connects from clients
         try
         {
-            m_oTCPAcceptor.openAndListen(m_strInterface, m_u16Port);
+            openAndListen();
 
             break;
         }
 
         catch(boost::system::system_error const &oSystemError)
         {
-            cout << "cTCPServer::socketListeningThreadFunction(): Failed to bind to port and listen." << endl;
-            cout << "cTCPServer::socketListeningThreadFunction(): The error was: " << oSystemError.what() << endl;
-            cout << "cTCPServer::socketListeningThreadFunction(): Retrying in 5 s ..." << endl;
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cTCPServer::socketListeningThreadFunction(): Failed to bind to port and listen. The error was: "
+                                             << oSystemError.what() << ". Retrying in 5 s ...";
             boost::this_thread::sleep(boost::posix_time::milliseconds(5000));
         }
     }
 
-    cout << "cTCPServer::socketListeningThreadFunction(): Listening for TCP connections on " << m_strInterface << ":" << m_u16Port << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPServer::socketListeningThreadFunction(): Listening for TCP connections on " << m_strInterface << ":" << m_u16Port;
 
     while(!isShutdownRequested())
     {
-        cout << "cTCPServer::socketListeningThreadFunction(): Listening for client connections..." << endl;
+        AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPServer::socketListeningThreadFunction(): Listening for client connections...";
 
         std::stringstream oSS;
         oSS << "Connection ";
@@ -94,36 +150,225 @@ void cTCPServer::socketListeningThreadFunction()
         try
         {
             string strPeerAddress;
-            m_oTCPAcceptor.accept(pClientSocket, strPeerAddress); //Accept connection from a client.
+            if(!acceptConnection(pClientSocket, strPeerAddress)) //Accept connection from a client.
+                continue;
+
+            if(m_u32MaxConnections && getNValidConnections() >= m_u32MaxConnections)
+            {
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPServer::socketListeningThreadFunction(): Maximum number of connections (" << m_u32MaxConnections
+                                                   << ") reached. Rejecting client " << strPeerAddress;
+
+                pClientSocket->close();
+                continue;
+            }
 
             boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
-            m_vpConnectionThreads.push_back(boost::make_shared<cConnectionThread>(pClientSocket));
 
-            cout << "cTCPServer::socketListeningThreadFunction(): There are now " << m_vpConnectionThreads.size() << " client(s) connected." << endl;
+#ifndef __linux__
+            //Inherited from the listening socket on Linux
+            m_oSocketOptions.apply(pClientSocket->getBoostSocketPointer()->native_handle(), oSS.str());
+#endif
+
+            if(m_vpEventLoopThreads.empty())
+            {
+                boost::shared_ptr<cConnectionThread> pConnection = boost::make_shared<cConnectionThread>(pClientSocket, m_pBroadcastBuffer);
+                pConnection->setSlowClientPolicy(m_eSlowClientPolicy, m_u32LagThreshold, m_u32BlockTimeout_ms);
+                pConnection->setThreadPlacement(m_oSendingThreadPlacement);
+
+                m_vpConnectionThreads.push_back(pConnection);
+                m_vu32ConnectionEventLoops.push_back(0); //Unused
+            }
+            else
+            {
+                //Hand the connection to the least loaded event loop
+                boost::shared_ptr<cConnectionThread> pConnection = boost::make_shared<cConnectionThread>(pClientSocket, m_pBroadcastBuffer, false);
+                pConnection->setSlowClientPolicy(m_eSlowClientPolicy, m_u32LagThreshold, m_u32BlockTimeout_ms);
+
+                uint32_t u32EventLoop = 0;
+                for(uint32_t ui = 1; ui < m_vpEventLoopThreads.size(); ui++)
+                {
+                    if(m_vpEventLoopThreads[ui]->getNConnections() < m_vpEventLoopThreads[u32EventLoop]->getNConnections())
+                        u32EventLoop = ui;
+                }
+
+                m_vpEventLoopThreads[u32EventLoop]->addConnection(pConnection);
+                m_vpConnectionThreads.push_back(pConnection);
+                m_vu32ConnectionEventLoops.push_back(u32EventLoop);
+            }
+
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPServer::socketListeningThreadFunction(): There are now " << m_vpConnectionThreads.size() << " client(s) connected.";
         }
         catch(boost::system::system_error const &oSystemError)
         {
-            cout << "cTCPServer::socketListeningThreadFunction(): Caught Exception on accepting incoming connection." << endl;
-            cout << "cTCPServer::socketListeningThreadFunction(): The error was: " << oSystemError.what() << endl;
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cTCPServer::socketListeningThreadFunction(): Caught Exception on accepting incoming connection. The error was: "
+                                             << oSystemError.what();
             continue; //Try again
         }
 
     }
 
-    m_oTCPAcceptor.close();
+    closeListeningSocket();
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPServer::socketListeningThreadFunction(): Returning from thread function.";
+}
+
+void cTCPServer::openAndListen()
+{
+#ifdef __linux__
+    boost::asio::ip::tcp::endpoint oEndpoint(boost::asio::ip::address::from_string(m_strInterface), m_u16Port);
+
+    //Non-blocking so that a connection reset between poll() and accept() does not block the listening thread
+    int iSocketFD = socket(oEndpoint.protocol().family(), SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if(iSocketFD < 0)
+        throwSocketError(-1, "socket");
 
-    cout << "cTCPServer::socketListeningThreadFunction(): Returning from thread function." << endl;
+    int iEnable = 1;
+    if(setsockopt(iSocketFD, SOL_SOCKET, SO_REUSEADDR, &iEnable, sizeof(iEnable)))
+        throwSocketError(iSocketFD, "setsockopt(SO_REUSEADDR)");
+
+    //Hold the lock until the socket is stored so that setSocketOptions() in the mean time is not lost
+    boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    m_oSocketOptions.apply(iSocketFD, string("listening socket"));
+
+    if(bind(iSocketFD, oEndpoint.data(), oEndpoint.size()))
+        throwSocketError(iSocketFD, "bind");
+
+    if(listen(iSocketFD, SOMAXCONN))
+        throwSocketError(iSocketFD, "listen");
+
+    m_iListeningSocketFD = iSocketFD;
+#else
+    m_oTCPAcceptor.openAndListen(m_strInterface, m_u16Port);
+#endif
+}
+
+bool cTCPServer::acceptConnection(boost::shared_ptr<cInterruptibleBlockingTCPSocket> pClientSocket, string &strPeerAddress)
+{
+    //Waits for a client. Returns false on shutdown or if the connection went away before it was accepted.
+
+#ifdef __linux__
+    int iListeningSocketFD;
+    {
+        boost::shared_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+        iListeningSocketFD = m_iListeningSocketFD;
+    }
+
+    //Register for wakeups before checking the flag again so that shutdown() is not missed
+    m_oListeningThreadNotifier.prepareWait();
+
+    if(isShutdownRequested())
+    {
+        m_oListeningThreadNotifier.cancelWait();
+        return false;
+    }
+
+    pollfd aoPollFileDescriptors[2];
+    aoPollFileDescriptors[0].fd = iListeningSocketFD;
+    aoPollFileDescriptors[0].events = POLLIN;
+    aoPollFileDescriptors[0].revents = 0;
+    aoPollFileDescriptors[1].fd = m_oListeningThreadNotifier.getFileDescriptor();
+    aoPollFileDescriptors[1].events = POLLIN;
+    aoPollFileDescriptors[1].revents = 0;
+
+    int iResult = poll(aoPollFileDescriptors, 2, -1);
+
+    m_oListeningThreadNotifier.clearFileDescriptor();
+    m_oListeningThreadNotifier.cancelWait();
+
+    if(iResult < 0 && errno != EINTR)
+        throwSocketError(-1, "poll");
+
+    if(iResult <= 0 || !(aoPollFileDescriptors[0].revents & POLLIN))
+        return false;
+
+    boost::asio::ip::tcp::endpoint oPeerEndpoint;
+    socklen_t iPeerEndpointSize = oPeerEndpoint.capacity();
+
+    //The accepted socket is blocking
+    int iSocketFD = accept4(iListeningSocketFD, oPeerEndpoint.data(), &iPeerEndpointSize, SOCK_CLOEXEC);
+    if(iSocketFD < 0)
+    {
+        if(errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED || errno == EINTR)
+            return false;
+
+        throwSocketError(-1, "accept");
+    }
+
+    oPeerEndpoint.resize(iPeerEndpointSize);
+
+    boost::system::error_code oError;
+    pClientSocket->getBoostSocketPointer()->assign(oPeerEndpoint.protocol(), iSocketFD, oError);
+
+    if(oError)
+    {
+        ::close(iSocketFD);
+        throw boost::system::system_error(oError, "assign");
+    }
+
+    strPeerAddress = oPeerEndpoint.address().to_string();
+
+    return true;
+#else
+    return m_oTCPAcceptor.accept(pClientSocket, strPeerAddress);
+#endif
+}
+
+void cTCPServer::closeListeningSocket()
+{
+#ifdef __linux__
+    boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    if(m_iListeningSocketFD >= 0)
+    {
+        ::close(m_iListeningSocketFD);
+        m_iListeningSocketFD = -1;
+    }
+#else
+    if(m_oTCPAcceptor.isOpen())
+        m_oTCPAcceptor.close();
+#endif
 }
 
 void cTCPServer::writeData(char* cpData, uint32_t u32Size_B)
 {
     boost::upgrade_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
 
-    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    //Copy the packet once into the broadcast buffer. Each client sends it from there. (Upgrade locks are exclusive amongst
+    //themselves so this is the only thread writing to the broadcast buffer.)
+    if(m_vpConnectionThreads.size())
     {
-        //Send only to valid connections
-        if(m_vpConnectionThreads[ui]->isValid())
-            m_vpConnectionThreads[ui]->tryAddDataToSend(cpData, u32Size_B);
+        uint64_t u64Sequence = m_pBroadcastBuffer->prepareWrite();
+
+        //The packet replaced may still be queued for lagging clients
+        if(u64Sequence >= m_pBroadcastBuffer->getNSlots())
+        {
+            uint64_t u64Retired = u64Sequence - m_pBroadcastBuffer->getNSlots();
+            uint32_t u32RetiredSize_B = m_pBroadcastBuffer->getDataSize(u64Retired);
+
+            for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+            {
+                m_vpConnectionThreads[ui]->retirePacket(u64Retired, u32RetiredSize_B);
+            }
+        }
+
+        m_pBroadcastBuffer->write(cpData, u32Size_B);
+
+        for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+        {
+            //Send only to valid connections. Only the event loops of connections that may have gone idle are woken.
+            if(m_vpConnectionThreads[ui]->isValid() && m_vpConnectionThreads[ui]->tryQueuePacket(u64Sequence, u32Size_B) && m_vpEventLoopThreads.size())
+                m_vbEventLoopsToNotify[m_vu32ConnectionEventLoops[ui]] = true;
+        }
+
+        for(uint32_t ui = 0; ui < m_vbEventLoopsToNotify.size(); ui++)
+        {
+            if(m_vbEventLoopsToNotify[ui])
+            {
+                m_vpEventLoopThreads[ui]->notifyDataQueued();
+                m_vbEventLoopsToNotify[ui] = false;
+            }
+        }
     }
 
     //Clean up any invalid connections
@@ -131,18 +376,26 @@ void cTCPServer::writeData(char* cpData, uint32_t u32Size_B)
     {
         if(!m_vpConnectionThreads[ui]->isValid())
         {
-            cout << "cTCPServer::writeData(): Closing connection to client " << m_vpConnectionThreads[ui]->getPeerAddress();
+            std::string strSocketName;
             if(m_vpConnectionThreads[ui]->getSocketName().length())
-                cout << " (" << m_vpConnectionThreads[ui]->getSocketName() << ")";
+                strSocketName = " (" + m_vpConnectionThreads[ui]->getSocketName() + ")";
+
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPServer::writeData(): Closing connection to client " << m_vpConnectionThreads[ui]->getPeerAddress() << strSocketName;
+
+            //An event loop may still hold the connection. It must not read packets that are no longer retired for it.
+            m_vpConnectionThreads[ui]->detachFromBroadcastBuffer();
 
-            cout << endl;
+            //Wake its event loop so that it lets go of the connection too
+            if(m_vpEventLoopThreads.size())
+                m_vpEventLoopThreads[m_vu32ConnectionEventLoops[ui]]->notifyDataQueued();
 
             {
                 boost::upgrade_to_unique_lock< boost::shared_mutex > uniqueLock(oLock);
                 m_vpConnectionThreads.erase(m_vpConnectionThreads.begin() + ui);
+                m_vu32ConnectionEventLoops.erase(m_vu32ConnectionEventLoops.begin() + ui);
             }
 
-            cout << "cTCPServer::writeData(): There are now " << m_vpConnectionThreads.size() << " client(s) connected." << endl;
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cTCPServer::writeData(): There are now " << m_vpConnectionThreads.size() << " client(s) connected.";
         }
         else
         {
@@ -152,3 +405,176 @@ void cTCPServer::writeData(char* cpData, uint32_t u32Size_B)
 }
 
 
+
+uint32_t cTCPServer::getNValidConnections()
+{
+    //Invalid connections are only cleaned up by writeData() so count the valid ones
+    boost::shared_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    uint32_t u32NValidConnections = 0;
+
+    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    {
+        if(m_vpConnectionThreads[ui]->isValid())
+            u32NValidConnections++;
+    }
+
+    return u32NValidConnections;
+}
+
+void cTCPServer::setSlowClientPolicy(cConnectionThread::slowClientPolicy ePolicy, uint32_t u32LagThreshold, uint32_t u32BlockTimeout_ms)
+{
+    boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    m_eSlowClientPolicy = ePolicy;
+    m_u32LagThreshold = u32LagThreshold;
+    m_u32BlockTimeout_ms = u32BlockTimeout_ms;
+
+    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    {
+        m_vpConnectionThreads[ui]->setSlowClientPolicy(ePolicy, u32LagThreshold, u32BlockTimeout_ms);
+    }
+}
+
+bool cTCPServer::setClientSlowClientPolicy(const std::string &strPeerAddress, cConnectionThread::slowClientPolicy ePolicy,
+                                           uint32_t u32LagThreshold, uint32_t u32BlockTimeout_ms)
+{
+    boost::shared_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    bool bFound = false;
+
+    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    {
+        if(m_vpConnectionThreads[ui]->getPeerAddress() == strPeerAddress)
+        {
+            m_vpConnectionThreads[ui]->setSlowClientPolicy(ePolicy, u32LagThreshold, u32BlockTimeout_ms);
+            bFound = true;
+        }
+    }
+
+    if(!bFound)
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPServer::setClientSlowClientPolicy(): Warning: No client connected from " << strPeerAddress;
+
+    return bFound;
+}
+
+std::vector<cTCPServer::cClientStatus> cTCPServer::getClientStatus()
+{
+    //Only takes a shared lock so it does not hold up writeData(). The counters themselves are atomics.
+
+    boost::shared_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    std::vector<cClientStatus> voClientStatus(m_vpConnectionThreads.size());
+
+    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    {
+        voClientStatus[ui].m_strPeerAddress = m_vpConnectionThreads[ui]->getPeerAddress();
+        voClientStatus[ui].m_strSocketName = m_vpConnectionThreads[ui]->getSocketName();
+        voClientStatus[ui].m_eSlowClientPolicy = m_vpConnectionThreads[ui]->getSlowClientPolicy();
+        voClientStatus[ui].m_u32Lag = m_vpConnectionThreads[ui]->getLag();
+        voClientStatus[ui].m_u64NPacketsDropped = m_vpConnectionThreads[ui]->getNPacketsDropped();
+        voClientStatus[ui].m_u64NBytesDropped = m_vpConnectionThreads[ui]->getNBytesDropped();
+        voClientStatus[ui].m_u32LagHighWaterMark = m_vpConnectionThreads[ui]->getLagHighWaterMark();
+        voClientStatus[ui].m_u32MaxLag = m_vpConnectionThreads[ui]->getMaxLag();
+        voClientStatus[ui].m_u64NPacketsSent = m_vpConnectionThreads[ui]->getNPacketsSent();
+        voClientStatus[ui].m_u64NBytesSent = m_vpConnectionThreads[ui]->getNBytesSent();
+        voClientStatus[ui].m_u64NSocketErrors = m_vpConnectionThreads[ui]->getNSocketErrors();
+        voClientStatus[ui].m_u64BlockedTime_us = m_vpConnectionThreads[ui]->getBlockedTime_us();
+    }
+
+    return voClientStatus;
+}
+
+void cTCPServer::setSocketOptions(const cSocketOptions &oOptions)
+{
+    boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    m_oSocketOptions = oOptions;
+
+#ifdef __linux__
+    //For future clients
+    if(m_iListeningSocketFD >= 0)
+        m_oSocketOptions.apply(m_iListeningSocketFD, string("listening socket"));
+#endif
+
+    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    {
+        if(m_vpConnectionThreads[ui]->isValid())
+            m_oSocketOptions.apply(m_vpConnectionThreads[ui]->getNativeSocketHandle(), string("connection to ") + m_vpConnectionThreads[ui]->getPeerAddress());
+    }
+}
+
+cSocketOptions cTCPServer::getSocketOptions()
+{
+    boost::shared_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    return m_oSocketOptions;
+}
+
+void cTCPServer::setThreadPlacement(threadRole eThread, const cThreadPlacement &oPlacement)
+{
+    //Exclusive lock: writeData() must not touch the broadcast buffer while it is rebound
+    boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    if(eThread == THREAD_LISTENING)
+    {
+        m_oListeningThreadPlacement = oPlacement;
+
+        if(m_pSocketListeningThread.get())
+            oPlacement.apply(*m_pSocketListeningThread, string("socket listening"));
+
+        return;
+    }
+
+    m_oSendingThreadPlacement = oPlacement;
+
+    for(uint32_t ui = 0; ui < m_vpEventLoopThreads.size(); ui++)
+    {
+        m_vpEventLoopThreads[ui]->setThreadPlacement(oPlacement);
+    }
+
+    for(uint32_t ui = 0; ui < m_vpConnectionThreads.size(); ui++)
+    {
+        m_vpConnectionThreads[ui]->setThreadPlacement(oPlacement);
+    }
+
+    if(oPlacement.getBindMemoryToNUMANode())
+    {
+        int32_t i32Node = oPlacement.getNUMANode();
+
+        if(i32Node < 0)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPServer::setThreadPlacement(): Warning: NUMA node of the sending threads' CPUs is unknown. Broadcast buffer memory is not bound.";
+            return;
+        }
+
+        m_pBroadcastBuffer->bindToNUMANode(i32Node);
+    }
+}
+
+cThreadPlacement cTCPServer::getThreadPlacement(threadRole eThread)
+{
+    boost::shared_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    if(eThread == THREAD_LISTENING)
+        return m_oListeningThreadPlacement;
+
+    return m_oSendingThreadPlacement;
+}
+
+bool cTCPServer::setBufferAllocationMode(cPacketRingBuffer::allocationMode eMode)
+{
+    //Exclusive lock: writeData() must not touch the broadcast buffer while it is reallocated
+    boost::unique_lock<boost::shared_mutex> oLock(m_oConnectThreadsMutex);
+
+    //Connections may be sending from it
+    if(m_vpConnectionThreads.size())
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cTCPServer::setBufferAllocationMode(): Warning: Clients are connected. Not changing the broadcast buffer allocation.";
+        return false;
+    }
+
+    m_pBroadcastBuffer->setAllocationMode(eMode);
+
+    return true;
+}
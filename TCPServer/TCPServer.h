@@ -32,11 +32,44 @@ typedef unsigned __int64 uint64_t;
 #include "../../../AVNUtilLibs/Sockets/InterruptibleBlockingSockets/InterruptibleBlockingUDPSocket.h"
 #include "../../../AVNUtilLibs/Sockets/InterruptibleBlockingSocketAcceptors/InterruptibleBlockingTCPAcceptor.h"
 #include "ConnectionThread.h"
+#include "BroadcastBuffer.h"
+#include "EventLoopThread.h"
+#include "../ThreadPlacement/ThreadPlacement.h"
+#include "../SocketOptions/SocketOptions.h"
+#include "../EventNotifier/EventNotifier.h"
 
 class cTCPServer
 {
 public:
-    cTCPServer(const std::string &strInterface = std::string("0.0.0.0"), uint16_t usPort = 60001, uint32_t u32MaxConnections = 0);
+    class cClientStatus
+    {
+    public:
+        std::string                                     m_strPeerAddress;
+        std::string                                     m_strSocketName;
+        cConnectionThread::slowClientPolicy             m_eSlowClientPolicy;
+        uint32_t                                        m_u32Lag; //Packets queued
+        uint32_t                                        m_u32LagHighWaterMark;
+        uint32_t                                        m_u32MaxLag;
+        uint64_t                                        m_u64NPacketsDropped;
+        uint64_t                                        m_u64NBytesDropped;
+        uint64_t                                        m_u64NPacketsSent;
+        uint64_t                                        m_u64NBytesSent;
+        uint64_t                                        m_u64NSocketErrors;
+        uint64_t                                        m_u64BlockedTime_us;
+    };
+
+    enum threadRole
+    {
+        THREAD_LISTENING = 0,
+        THREAD_SENDING //The writing threads of the connections or the event loop threads
+    };
+
+    //u32MaxConnections = 0 allows any number of clients. All clients send from one broadcast buffer ring of fixed size
+    //(about 1 MB) regardless of their number. A client lapped by it is handled by its slow client policy. With
+    //u32NEventLoopThreads = 0 each client gets its own writing thread, otherwise clients are spread across that many epoll
+    //event loop threads (Linux only).
+    cTCPServer(const std::string &strInterface = std::string("0.0.0.0"), uint16_t usPort = 60001, uint32_t u32MaxConnections = 0,
+               uint32_t u32NEventLoopThreads = 0);
     virtual ~cTCPServer();
 
     void writeData(char* cpData, uint32_t u32Size_B);
@@ -44,6 +77,27 @@ public:
     void                                                shutdown();
     bool                                                isShutdownRequested();
 
+    //Slow client handling (see cConnectionThread). Applies to current and future clients.
+    void                                                setSlowClientPolicy(cConnectionThread::slowClientPolicy ePolicy, uint32_t u32LagThreshold = 0, uint32_t u32BlockTimeout_ms = 10);
+    //Override for the client(s) connected from the given peer address. Returns false if there is no such client.
+    bool                                                setClientSlowClientPolicy(const std::string &strPeerAddress, cConnectionThread::slowClientPolicy ePolicy,
+                                                                              uint32_t u32LagThreshold = 0, uint32_t u32BlockTimeout_ms = 10);
+
+    std::vector<cClientStatus>                          getClientStatus();
+
+    //CPU affinity and scheduling of the server's threads. Applies to current and future threads. If the sending placement
+    //asks for NUMA binding the broadcast buffer is moved to its node (locked slab allocation only, see setBufferAllocationMode()).
+    void                                                setThreadPlacement(threadRole eThread, const cThreadPlacement &oPlacement);
+    cThreadPlacement                                    getThreadPlacement(threadRole eThread);
+
+    //Allocation of the broadcast buffer (see cPacketRingBuffer::allocationMode). Only possible while no clients are connected.
+    //Returns false otherwise.
+    bool                                                setBufferAllocationMode(cPacketRingBuffer::allocationMode eMode);
+
+    //Socket options for the client connections (see cSocketOptions). Applies to current and future clients.
+    void                                                setSocketOptions(const cSocketOptions &oOptions);
+    cSocketOptions                                      getSocketOptions();
+
 protected:
     bool                                                m_bShutdownFlag;
     boost::shared_mutex                                 m_bShutdownFlagMutex;
@@ -52,12 +106,38 @@ protected:
     std::string                                         m_strInterface;
     uint16_t                                            m_u16Port;
 
+    //On Linux the listening socket is opened here instead so that the socket options can be set before listen(). Accepted
+    //sockets inherit them, including the receive buffer size that sets the window scale offered to the client.
     cInterruptibleBlockingTCPAcceptor                   m_oTCPAcceptor;
+    int                                                 m_iListeningSocketFD; //Protected by m_oConnectThreadsMutex
+    cEventNotifier                                      m_oListeningThreadNotifier; //Wakes the listening thread on shutdown
+
+    //Each packet is copied once into this ring. Every client keeps its own position in it.
+    boost::shared_ptr<cBroadcastBuffer>                 m_pBroadcastBuffer;
 
     std::vector<boost::shared_ptr<cConnectionThread> >  m_vpConnectionThreads;
     boost::shared_mutex                                 m_oConnectThreadsMutex;
 
+    //Slow client policy for new connections. Protected by m_oConnectThreadsMutex.
+    cConnectionThread::slowClientPolicy                 m_eSlowClientPolicy;
+    uint32_t                                            m_u32LagThreshold;
+    uint32_t                                            m_u32BlockTimeout_ms;
+
+    //Protected by m_oConnectThreadsMutex
+    cThreadPlacement                                    m_oListeningThreadPlacement;
+    cThreadPlacement                                    m_oSendingThreadPlacement;
+    cSocketOptions                                      m_oSocketOptions;
+
+    //Event loop mode
+    std::vector<boost::shared_ptr<cEventLoopThread> >   m_vpEventLoopThreads;
+    std::vector<uint32_t>                               m_vu32ConnectionEventLoops; //Event loop of each connection in m_vpConnectionThreads
+    std::vector<bool>                                   m_vbEventLoopsToNotify; //writeData() only
+
     void                                                socketListeningThreadFunction();
+    void                                                openAndListen(); //Throws boost::system::system_error on failure
+    bool                                                acceptConnection(boost::shared_ptr<cInterruptibleBlockingTCPSocket> pClientSocket, std::string &strPeerAddress);
+    void                                                closeListeningSocket();
+    uint32_t                                            getNValidConnections();
 
     boost::scoped_ptr<boost::thread>                    m_pSocketListeningThread;
 };
@@ -0,0 +1,206 @@
+//System includes
+#include <cstring>
+#include <cstdlib>
+#include <cerrno>
+#include <sstream>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+
+//Library includes
+
+//Local includes
+#include "ThreadPlacement.h"
+#include "../Logger/Logger.h"
+
+using namespace std;
+
+#ifdef __linux__
+namespace
+{
+    //From <linux/mempolicy.h>. Not using libnuma to avoid the dependency.
+    const int MPOL_BIND_POLICY = 2;
+    const unsigned MPOL_MF_MOVE_FLAG = 1 << 1;
+}
+#endif
+
+cThreadPlacement::cThreadPlacement() :
+    m_eSchedulingPolicy(SCHEDULING_DEFAULT),
+    m_i32SchedulingPriority(0),
+    m_bBindMemoryToNUMANode(false)
+{
+}
+
+void cThreadPlacement::setCPUs(const vector<uint32_t> &vu32CPUs)
+{
+    m_vu32CPUs = vu32CPUs;
+}
+
+void cThreadPlacement::addCPU(uint32_t u32CPU)
+{
+    m_vu32CPUs.push_back(u32CPU);
+}
+
+const vector<uint32_t>& cThreadPlacement::getCPUs() const
+{
+    return m_vu32CPUs;
+}
+
+void cThreadPlacement::setScheduling(schedulingPolicy ePolicy, int32_t i32Priority)
+{
+    m_eSchedulingPolicy = ePolicy;
+    m_i32SchedulingPriority = i32Priority;
+}
+
+cThreadPlacement::schedulingPolicy cThreadPlacement::getSchedulingPolicy() const
+{
+    return m_eSchedulingPolicy;
+}
+
+int32_t cThreadPlacement::getSchedulingPriority() const
+{
+    return m_i32SchedulingPriority;
+}
+
+void cThreadPlacement::setBindMemoryToNUMANode(bool bBind)
+{
+    m_bBindMemoryToNUMANode = bBind;
+}
+
+bool cThreadPlacement::getBindMemoryToNUMANode() const
+{
+    return m_bBindMemoryToNUMANode;
+}
+
+bool cThreadPlacement::isDefault() const
+{
+    return m_vu32CPUs.empty() && m_eSchedulingPolicy == SCHEDULING_DEFAULT && !m_bBindMemoryToNUMANode;
+}
+
+bool cThreadPlacement::apply(boost::thread &oThread, const string &strThreadName) const
+{
+    if(isDefault())
+        return true;
+
+    //A finished (joined) thread no longer has a native handle
+    if(!oThread.joinable())
+        return false;
+
+#ifdef __linux__
+    pthread_t oHandle = oThread.native_handle();
+    bool bSuccess = true;
+
+    if(m_vu32CPUs.size())
+    {
+        cpu_set_t sCPUSet;
+        CPU_ZERO(&sCPUSet);
+
+        for(uint32_t ui = 0; ui < m_vu32CPUs.size(); ui++)
+            CPU_SET(m_vu32CPUs[ui], &sCPUSet);
+
+        int iResult = pthread_setaffinity_np(oHandle, sizeof(sCPUSet), &sCPUSet);
+        if(iResult)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cThreadPlacement::apply(): Warning: Unable to set CPU affinity of " << strThreadName << " thread: " << strerror(iResult);
+            bSuccess = false;
+        }
+    }
+
+    if(m_eSchedulingPolicy != SCHEDULING_DEFAULT)
+    {
+        sched_param sParameters;
+        memset(&sParameters, 0, sizeof(sParameters));
+        sParameters.sched_priority = m_i32SchedulingPriority;
+
+        int iPolicy = (m_eSchedulingPolicy == SCHEDULING_FIFO) ? SCHED_FIFO : SCHED_RR;
+
+        int iResult = pthread_setschedparam(oHandle, iPolicy, &sParameters);
+        if(iResult)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cThreadPlacement::apply(): Warning: Unable to set scheduling policy of " << strThreadName << " thread: " << strerror(iResult);
+            bSuccess = false;
+        }
+    }
+
+    return bSuccess;
+#else
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cThreadPlacement::apply(): Warning: Thread placement is only implemented for Linux. Ignoring for " << strThreadName << " thread.";
+
+    return false;
+#endif
+}
+
+int32_t cThreadPlacement::getNUMANode() const
+{
+    if(m_vu32CPUs.empty())
+        return -1;
+
+    return getNUMANodeOfCPU(m_vu32CPUs.front());
+}
+
+int32_t cThreadPlacement::getNUMANodeOfCPU(uint32_t u32CPU)
+{
+#ifdef __linux__
+    //The CPU's sysfs directory holds a "node<N>" link to its NUMA node
+    stringstream oPath;
+    oPath << "/sys/devices/system/cpu/cpu" << u32CPU;
+
+    DIR *pDirectory = opendir(oPath.str().c_str());
+    if(!pDirectory)
+        return -1;
+
+    int32_t i32Node = -1;
+
+    for(dirent *pEntry = readdir(pDirectory); pEntry; pEntry = readdir(pDirectory))
+    {
+        if(!strncmp(pEntry->d_name, "node", 4) && pEntry->d_name[4] >= '0' && pEntry->d_name[4] <= '9')
+        {
+            i32Node = atoi(pEntry->d_name + 4);
+            break;
+        }
+    }
+
+    closedir(pDirectory);
+
+    return i32Node;
+#else
+    return -1;
+#endif
+}
+
+bool cThreadPlacement::bindMemoryToNUMANode(void *pMemory, size_t szSize_B, uint32_t u32Node)
+{
+#if defined(__linux__) && defined(SYS_mbind)
+    if(!szSize_B)
+        return true;
+
+    //mbind() works on whole pages. Rounding out to them would also move whatever else shares the first and last page.
+    size_t szPageSize_B = sysconf(_SC_PAGESIZE);
+    if(((size_t)pMemory & (szPageSize_B - 1)) || (szSize_B & (szPageSize_B - 1)))
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cThreadPlacement::bindMemoryToNUMANode(): Warning: Memory is not made up of whole pages. Not binding it to NUMA node " << u32Node << ".";
+        return false;
+    }
+
+    const uint32_t u32BitsPerMask = 8 * sizeof(unsigned long);
+    vector<unsigned long> vulNodeMask(u32Node / u32BitsPerMask + 1, 0);
+    vulNodeMask[u32Node / u32BitsPerMask] |= 1UL << (u32Node % u32BitsPerMask);
+
+    if(syscall(SYS_mbind, pMemory, szSize_B, MPOL_BIND_POLICY, &vulNodeMask.front(), vulNodeMask.size() * u32BitsPerMask + 1, MPOL_MF_MOVE_FLAG))
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cThreadPlacement::bindMemoryToNUMANode(): Warning: Unable to bind memory to NUMA node " << u32Node << ": " << strerror(errno);
+        return false;
+    }
+
+    return true;
+#else
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cThreadPlacement::bindMemoryToNUMANode(): Warning: NUMA binding is only implemented for Linux.";
+
+    return false;
+#endif
+}
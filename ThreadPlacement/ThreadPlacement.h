@@ -0,0 +1,81 @@
+#ifndef THREAD_PLACEMENT_H
+#define THREAD_PLACEMENT_H
+
+//System includes
+#ifdef _WIN32
+#include <stdint.h>
+
+#ifndef int64_t
+typedef __int64 int64_t;
+#endif
+
+#ifndef uint64_t
+typedef unsigned __int64 uint64_t;
+#endif
+
+#else
+#include <inttypes.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+//Library include:
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/thread.hpp>
+#endif
+
+//Local includes
+
+//Where and how a streamer thread runs: the CPUs it may run on, its scheduling policy and whether the buffers it works on
+//should be placed on its NUMA node. A default constructed placement leaves the thread alone.
+
+//Placement is applied to a running thread through its native handle. Only implemented for Linux; elsewhere apply() logs a
+//warning and returns false. Real time policies usually need CAP_SYS_NICE (or an rtprio limit).
+
+//Memory is bound with mbind() to the NUMA node of the first CPU in the set. Pages already in use are migrated. Only whole
+//pages (e.g. a cMemorySlab mapping) are bound, anything else is refused with a warning as binding it would also move the
+//neighbouring allocations sharing its pages.
+
+class cThreadPlacement
+{
+public:
+    enum schedulingPolicy
+    {
+        SCHEDULING_DEFAULT = 0, //SCHED_OTHER
+        SCHEDULING_FIFO,
+        SCHEDULING_ROUND_ROBIN
+    };
+
+    cThreadPlacement();
+
+    void                                                    setCPUs(const std::vector<uint32_t> &vu32CPUs);
+    void                                                    addCPU(uint32_t u32CPU);
+    const std::vector<uint32_t>&                            getCPUs() const;
+
+    void                                                    setScheduling(schedulingPolicy ePolicy, int32_t i32Priority = 0);
+    schedulingPolicy                                        getSchedulingPolicy() const;
+    int32_t                                                 getSchedulingPriority() const;
+
+    void                                                    setBindMemoryToNUMANode(bool bBind);
+    bool                                                    getBindMemoryToNUMANode() const;
+
+    bool                                                    isDefault() const;
+
+    bool                                                    apply(boost::thread &oThread, const std::string &strThreadName) const;
+
+    //NUMA node of the first CPU in the set or -1 if unknown
+    int32_t                                                 getNUMANode() const;
+
+    static int32_t                                          getNUMANodeOfCPU(uint32_t u32CPU);
+    static bool                                             bindMemoryToNUMANode(void *pMemory, size_t szSize_B, uint32_t u32Node);
+
+private:
+    std::vector<uint32_t>                                   m_vu32CPUs;
+    schedulingPolicy                                        m_eSchedulingPolicy;
+    int32_t                                                 m_i32SchedulingPriority;
+    bool                                                    m_bBindMemoryToNUMANode;
+};
+
+#endif // THREAD_PLACEMENT_H
@@ -1,25 +1,53 @@
 //System includes
-#include <iostream>
 #include <sstream>
+#include <fstream>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#include <poll.h>
+#include <errno.h>
+#include <string.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <netinet/in.h>
+#include <time.h>
+#endif
 
 //Library includes
 #ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
 #include <boost/asio/buffer.hpp>
+#include <boost/asio/ip/address.hpp>
 #include <boost/date_time/posix_time/posix_time.hpp>
 #endif
 
 //Local includes
 #include "UDPReceiver.h"
+#include "../Logger/Logger.h"
 
 using namespace std;
 
-cUDPReceiver::cUDPReceiver(const string &strLocalInterface, uint16_t u16LocalPort, const string &strPeerAddress, uint16_t u16PeerPort) :
-    cSocketReceiverBase(strPeerAddress, u16PeerPort),
+cUDPReceiver::cUDPReceiver(const string &strLocalInterface, uint16_t u16LocalPort, const string &strPeerAddress, uint16_t u16PeerPort,
+                           uint32_t u32BufferNElements, uint32_t u32BufferElementSize_B) :
+    cSocketReceiverBase(strPeerAddress, u16PeerPort, u32BufferNElements, u32BufferElementSize_B),
     m_oSocket(string("UDP socket")),
     m_strLocalInterface(strLocalInterface),
-    m_u16LocalPort(u16LocalPort)
+    m_u16LocalPort(u16LocalPort),
+    m_u32ReceiveBatchSize(1),
+    m_bPreserveDatagramBoundaries(false),
+    m_bReusePort(false),
+    m_u32NDatagramsLastReceiveCall(0),
+    m_u64NReceiveCalls(0),
+    m_u64NDatagramsReceived(0),
+    m_iSocketFD(-1),
+    m_u32KernelQueueDrops(0),
+    m_bKernelQueueDropsReported(false),
+    m_u32ReorderWindow(0),
+    m_u64NPacketsReordered(0),
+    m_u64NPacketsSkippedByReordering(0),
+    m_u32NPacketsHeld(0),
+    m_i64NextPacketNumber(0),
+    m_bReorderStarted(false)
 {
-    m_oBuffer.resize(1024, 1040); //16 packets of 1040 bytes for each complex uint32_t FFT window of 2 channels or or I,Q,U,V uint32_t stokes parameters
 }
 
 cUDPReceiver::~cUDPReceiver()
@@ -33,22 +61,57 @@ cUDPReceiver::~cUDPReceiver()
 
 void cUDPReceiver::socketReceivingThreadFunction()
 {
-    cout << "Entered cUDPReceiver::socketReceivingThreadFunction()" << endl;
+    AVN_LOG(cLogger::SEVERITY_INFO) << "Entered cUDPReceiver::socketReceivingThreadFunction()";
 
     //First attempt to bind socket
 
     //m_oUDPSocket.openBindAndConnect(m_strLocalInterface, m_u16LocalPort, m_strPeerAddress, m_u16PeerPort);
-    while(!m_oSocket.openAndBind(m_strLocalInterface, m_u16LocalPort))
+    while(!openAndBindSocket())
     {
         if(isShutdownRequested() || !isReceivingEnabled())
         {
-            cout << "cUDPReceiver::socketReceivingThreadFunction(): Got shutdown flag, returning." << endl;
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThreadFunction(): Got shutdown flag, returning.";
             return;
         }
 
         //Wait some time then try to bind again...
         boost::this_thread::sleep(boost::posix_time::milliseconds(2000));
-        cout << "cUDPReceiver::socketReceivingThreadFunction(): Retrying socket binding to " << m_strLocalInterface << ":" << m_u16LocalPort << endl;
+        AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThreadFunction(): Retrying socket binding to " << m_strLocalInterface << ":" << m_u16LocalPort;
+    }
+
+    boost::shared_ptr<cPacketSequenceDecoder> pHeaderDecoder = getHeaderDecoder();
+    uint32_t u32ReorderWindow = 0;
+
+    if(pHeaderDecoder)
+    {
+        pHeaderDecoder->restart();
+        u32ReorderWindow = m_u32ReorderWindow.load();
+    }
+
+    if(u32ReorderWindow)
+    {
+        m_vvcReorderSlots.resize(u32ReorderWindow);
+        m_voReorderSlotMetadata.resize(u32ReorderWindow);
+        m_vbReorderSlotsFull.assign(u32ReorderWindow, false);
+        m_u32NPacketsHeld = 0;
+        m_bReorderStarted = false;
+    }
+
+    m_u64NPacketsReordered.store(0);
+    m_u64NPacketsSkippedByReordering.store(0);
+
+    configureSocket();
+
+    uint32_t u32BatchSize = m_u32ReceiveBatchSize.load();
+    if(u32BatchSize > 1)
+    {
+        if(!u32ReorderWindow)
+        {
+            batchedSocketReceivingLoop(u32BatchSize, pHeaderDecoder);
+            return;
+        }
+
+        AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThreadFunction(): Reordering needs one datagram at a time. Not receiving in batches.";
     }
 
     //Enter thread loop, repeated reading into the FIFO
@@ -59,50 +122,72 @@ void cUDPReceiver::socketReceivingThreadFunction()
     int32_t i32BytesLastRead;
     int32_t i32BytesLeftToRead;
 
+    bool bPreserveDatagramBoundaries = m_bPreserveDatagramBoundaries.load() || u32ReorderWindow;
+
+    cPacketSequenceDecoder::sequenceResult eSequenceResult = cPacketSequenceDecoder::SEQUENCE_UNDECODABLE;
+    int64_t i64PacketNumber = 0;
+
+    cPacketRingBuffer::cMetadata oFurtherDatagramMetadata;
+
     while(isReceivingEnabled() && !isShutdownRequested())
     {
         //Get (or wait for) the next available element to write data to
-        //If waiting timeout every 500 ms and check for shutdown or stop streaming flags
-        //This prevents the program locking up in this thread.
+        //The wait is interrupted as soon as receiving is stopped or shutdown is requested.
         int32_t i32Index = -1;
-        while(i32Index == -1)
-        {
-            i32Index = m_oBuffer.getNextWriteIndex(500);
+        waitForFreeElements(i32Index, 1);
 
-            //Also check for shutdown flag
-            if(!isReceivingEnabled() || isShutdownRequested())
-            {
-                cout << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread." << endl;
-                cout << "---- Received " << u32PacketsReceived << " packets. ----" << endl;
-                return;
-            }
+        if(i32Index == -1)
+        {
+            AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread. Received " << u32PacketsReceived << " packets.";
+            flushReorderWindow(u32ReorderWindow);
+            return;
         }
 
         //Check that our buffer is large enough
         uint32_t u32UDPBytesAvailable = m_oSocket.getBytesAvailable();
         if(u32UDPBytesAvailable > m_oBuffer.getElementPointer(i32Index)->allocationSize())
         {
-            cout << "cUDPReceiver::socketReceivingThread(): Warning: Input buffer element size is too small for UDP packet." << endl;
-            cout << "Resizing to " << u32UDPBytesAvailable << " bytes" << endl;
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::socketReceivingThread(): Warning: Input buffer element size is too small for UDP packet. Growing elements to " << u32UDPBytesAvailable << " bytes";
 
-            m_oBuffer.resize(m_oBuffer.getNElements(), u32UDPBytesAvailable);
+            //Queued packets are kept. The element we hold is free so asking for it again gets it grown.
+            m_oBuffer.requestResize(m_oBuffer.getNElements(), u32UDPBytesAvailable);
+            i32Index = m_oBuffer.tryToGetNextWriteIndex();
         }
 
         //Read as many packets as can be fitted in to the buffer (it should be empty at this point)
+        //or only one packet if datagram boundaries are to be preserved.
         i32BytesLeftToRead = m_oBuffer.getElementPointer(i32Index)->allocationSize();
 
         while(i32BytesLeftToRead)
         {
-            string strSender;
-            uint16_t u16Port;
-            //if(!m_oUDPSocket.receive(m_oBuffer.getElementDataPointer(i32Index) + m_oBuffer.getElementPointer(i32Index)->dataSize(), i32BytesLeftToRead) )
-            if(!m_oSocket.receiveFrom(m_oBuffer.getElementDataPointer(i32Index) + m_oBuffer.getElementPointer(i32Index)->dataSize(), i32BytesLeftToRead, strSender, u16Port) )
+            //The element's metadata describes the first datagram in it
+            cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(i32Index);
+            cPacketRingBuffer::cMetadata &oMetadata = pElement->dataSize() ? oFurtherDatagramMetadata : pElement->metadata();
+
+            i32BytesLastRead = receiveDatagram(m_oBuffer.getElementDataPointer(i32Index) + pElement->dataSize(), i32BytesLeftToRead, oMetadata);
+
+            if(i32BytesLastRead < 0)
             {
-                cout << "cUDPReceiver::socketReceivingThread(): Warning socket error: " << m_oSocket.getLastError().message() << endl;
+                //Errors are counted by receiveDatagram()
+                if(isReceivingStopRequested())
+                {
+                    AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread. Received " << u32PacketsReceived << " packets.";
+                    pElement->clearData();
+                    flushReorderWindow(u32ReorderWindow);
+                    return;
+                }
+
+                continue;
             }
 
-            i32BytesLastRead = m_oSocket.getNBytesLastTransferred();
+            eSequenceResult = cPacketSequenceDecoder::SEQUENCE_UNDECODABLE;
+
+            if(pHeaderDecoder && i32BytesLastRead > 0)
+                eSequenceResult = pHeaderDecoder->processPacket(m_oBuffer.getElementDataPointer(i32Index) + m_oBuffer.getElementPointer(i32Index)->dataSize(), i32BytesLastRead, i64PacketNumber);
 
+            addReceivedData(1, i32BytesLastRead);
+
+            addReceiveCallStatistics(1);
 
             u32PacketsReceived++;
 
@@ -112,20 +197,529 @@ void cUDPReceiver::socketReceivingThreadFunction()
             //Also check for shutdown flag
             if(!isReceivingEnabled() || isShutdownRequested())
             {
-                cout << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread." << endl;
-                cout << "---- Received " << u32PacketsReceived << " packets. ----" << endl;
+                AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread. Received " << u32PacketsReceived << " packets.";
+                m_oBuffer.getElementPointer(i32Index)->clearData();
+                flushReorderWindow(u32ReorderWindow);
                 return;
             }
+
+            if(bPreserveDatagramBoundaries && m_oBuffer.getElementPointer(i32Index)->dataSize())
+                break;
         }
 
         //Signal we have completely filled an element of the input buffer.
-        m_oBuffer.elementWritten();
+        if(u32ReorderWindow)
+            reorderReceivedPacket(i32Index, eSequenceResult, i64PacketNumber, u32ReorderWindow);
+        else
+            elementsReceived(1);
+
+    }
+
+    flushReorderWindow(u32ReorderWindow);
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread. Received " << u32PacketsReceived << " packets.";
+}
+
+void cUDPReceiver::reorderReceivedPacket(int32_t i32Index, cPacketSequenceDecoder::sequenceResult eResult, int64_t i64PacketNumber, uint32_t u32Window)
+{
+    //The element at i32Index holds the datagram just received and has not been handed to the buffer yet. It is either passed
+    //on or its data is copied to the reorder window and the element is reused for the next datagram.
+
+    cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(i32Index);
+
+    if(eResult == cPacketSequenceDecoder::SEQUENCE_DUPLICATE)
+    {
+        pElement->clearData();
+        return;
+    }
+
+    if(eResult == cPacketSequenceDecoder::SEQUENCE_UNDECODABLE)
+    {
+        elementsReceived(1);
+        return;
+    }
+
+    if(!m_bReorderStarted)
+    {
+        m_bReorderStarted = true;
+        m_i64NextPacketNumber = i64PacketNumber;
+    }
+
+    //Too late for the window
+    if(i64PacketNumber < m_i64NextPacketNumber)
+    {
+        elementsReceived(1);
+        return;
+    }
+
+    if(i64PacketNumber == m_i64NextPacketNumber)
+    {
+        elementsReceived(1);
+        m_i64NextPacketNumber++;
+
+        releaseHeldPackets(u32Window);
+        return;
+    }
+
+    if(i64PacketNumber - m_i64NextPacketNumber >= (int64_t)u32Window)
+    {
+        //Give up on the oldest missing packets to make room. The packet is parked first as its element is needed for the
+        //packets released before it.
+        m_vcReorderScratch.assign(pElement->getDataPointer(), pElement->getDataPointer() + pElement->dataSize());
+        m_oReorderScratchMetadata = pElement->metadata();
+        pElement->clearData();
+
+        int64_t i64NewNextPacketNumber = i64PacketNumber - u32Window + 1;
+
+        for(; m_i64NextPacketNumber < i64NewNextPacketNumber; m_i64NextPacketNumber++)
+        {
+            uint32_t u32Slot = (uint64_t)m_i64NextPacketNumber % u32Window;
+
+            if(m_vbReorderSlotsFull[u32Slot])
+            {
+                emitPacket(&m_vvcReorderSlots[u32Slot].front(), m_vvcReorderSlots[u32Slot].size(), m_voReorderSlotMetadata[u32Slot], true);
+                m_vbReorderSlotsFull[u32Slot] = false;
+                m_u32NPacketsHeld--;
+                m_u64NPacketsReordered.fetch_add(1, boost::memory_order_relaxed);
+            }
+            else
+            {
+                m_u64NPacketsSkippedByReordering.fetch_add(1, boost::memory_order_relaxed);
+            }
+        }
+
+        releaseHeldPackets(u32Window);
+
+        if(i64PacketNumber == m_i64NextPacketNumber)
+        {
+            emitPacket(&m_vcReorderScratch.front(), m_vcReorderScratch.size(), m_oReorderScratchMetadata, true);
+            m_i64NextPacketNumber++;
+
+            releaseHeldPackets(u32Window);
+        }
+        else
+        {
+            uint32_t u32Slot = (uint64_t)i64PacketNumber % u32Window;
+
+            m_vvcReorderSlots[u32Slot].swap(m_vcReorderScratch);
+            m_voReorderSlotMetadata[u32Slot] = m_oReorderScratchMetadata;
+            m_vbReorderSlotsFull[u32Slot] = true;
+            m_u32NPacketsHeld++;
+        }
+
+        return;
+    }
+
+    //Ahead of a missing packet: hold it back
+    uint32_t u32Slot = (uint64_t)i64PacketNumber % u32Window;
+
+    m_vvcReorderSlots[u32Slot].assign(pElement->getDataPointer(), pElement->getDataPointer() + pElement->dataSize());
+    m_voReorderSlotMetadata[u32Slot] = pElement->metadata();
+    m_vbReorderSlotsFull[u32Slot] = true;
+    m_u32NPacketsHeld++;
+
+    pElement->clearData();
+}
+
+void cUDPReceiver::releaseHeldPackets(uint32_t u32Window)
+{
+    while(m_u32NPacketsHeld)
+    {
+        uint32_t u32Slot = (uint64_t)m_i64NextPacketNumber % u32Window;
+
+        if(!m_vbReorderSlotsFull[u32Slot])
+            return;
+
+        emitPacket(&m_vvcReorderSlots[u32Slot].front(), m_vvcReorderSlots[u32Slot].size(), m_voReorderSlotMetadata[u32Slot], true);
+        m_vbReorderSlotsFull[u32Slot] = false;
+        m_u32NPacketsHeld--;
+        m_u64NPacketsReordered.fetch_add(1, boost::memory_order_relaxed);
+
+        m_i64NextPacketNumber++;
+    }
+}
+
+void cUDPReceiver::flushReorderWindow(uint32_t u32Window)
+{
+    //Receiving is stopping: pass on what is held in sequence, skipping what is still missing, as far as the buffer has room
+
+    for(; m_u32NPacketsHeld; m_i64NextPacketNumber++)
+    {
+        uint32_t u32Slot = (uint64_t)m_i64NextPacketNumber % u32Window;
+
+        if(!m_vbReorderSlotsFull[u32Slot])
+        {
+            m_u64NPacketsSkippedByReordering.fetch_add(1, boost::memory_order_relaxed);
+            continue;
+        }
+
+        if(emitPacket(&m_vvcReorderSlots[u32Slot].front(), m_vvcReorderSlots[u32Slot].size(), m_voReorderSlotMetadata[u32Slot], false))
+            m_u64NPacketsReordered.fetch_add(1, boost::memory_order_relaxed);
+
+        m_vbReorderSlotsFull[u32Slot] = false;
+        m_u32NPacketsHeld--;
+    }
+
+    m_bReorderStarted = false;
+}
+
+bool cUDPReceiver::emitPacket(const char *cpData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata, bool bWait)
+{
+    //Copy a packet from the reorder window into the next element of the buffer
+
+    int32_t i32Index = -1;
+
+    if(bWait)
+        waitForFreeElements(i32Index, 1);
+    else
+        i32Index = m_oBuffer.tryToGetNextWriteIndex();
+
+    if(i32Index == -1)
+        return false;
+
+    cPacketRingBuffer::cElement *pElement = m_oBuffer.getElementPointer(i32Index);
+    pElement->clearData();
+
+    //Elements can only have shrunk through an explicit change of buffer geometry
+    if(u32Size_B > pElement->allocationSize())
+        u32Size_B = pElement->allocationSize();
+
+    if(u32Size_B)
+        memcpy(pElement->getDataPointer(), cpData, u32Size_B);
+
+    pElement->setDataAdded(u32Size_B);
+    pElement->metadata() = oMetadata;
+
+    elementsReceived(1);
+
+    return true;
+}
+
+bool cUDPReceiver::openAndBindSocket()
+{
+    if(!m_bReusePort.load())
+        return m_oSocket.openAndBind(m_strLocalInterface, m_u16LocalPort);
+
+#if defined(__linux__) && defined(SO_REUSEPORT)
+    //SO_REUSEPORT has to be set between opening and binding so open the underlying socket here
+    try
+    {
+        boost::asio::ip::udp::socket *pSocket = m_oSocket.getBoostSocketPointer();
+        boost::asio::ip::udp::endpoint oEndpoint(boost::asio::ip::address::from_string(m_strLocalInterface), m_u16LocalPort);
+
+        if(pSocket->is_open())
+            pSocket->close();
+
+        pSocket->open(oEndpoint.protocol());
+
+        int iEnable = 1;
+        if(setsockopt(pSocket->native_handle(), SOL_SOCKET, SO_REUSEPORT, &iEnable, sizeof(iEnable)))
+        {
+            AVN_LOG(cLogger::SEVERITY_ERROR) << "cUDPReceiver::openAndBindSocket(): Error: Unable to set SO_REUSEPORT: " << strerror(errno);
+            pSocket->close();
+            return false;
+        }
+
+        pSocket->bind(oEndpoint);
+    }
+    catch(boost::system::system_error const &oSystemError)
+    {
+        AVN_LOG(cLogger::SEVERITY_ERROR) << "cUDPReceiver::openAndBindSocket(): Error: Unable to bind to " << m_strLocalInterface << ":" << m_u16LocalPort << ": " << oSystemError.what();
+        return false;
+    }
+
+    return true;
+#else
+    AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::openAndBindSocket(): Warning: SO_REUSEPORT is not supported on this platform. Binding without it.";
+
+    return m_oSocket.openAndBind(m_strLocalInterface, m_u16LocalPort);
+#endif
+}
+
+int32_t cUDPReceiver::receiveDatagram(char *cpBuffer, uint32_t u32Size_B, cPacketRingBuffer::cMetadata &oMetadata)
+{
+    //Receives the next datagram straight from the socket, without the allocations of the socket wrapper's receiveFrom(), so
+    //that the sender and the kernel's receive time can be kept. Returns the number of bytes received or -1 if receiving was
+    //stopped or on a socket error.
+
+#ifdef __linux__
+    int iSocketFD = m_iSocketFD.load();
+
+    while(true)
+    {
+        sockaddr_storage sSourceAddress;
+        struct iovec sIOVector;
+        sIOVector.iov_base = cpBuffer;
+        sIOVector.iov_len = u32Size_B;
+
+        //Aligned for cmsghdr
+        union
+        {
+            struct cmsghdr                                  m_sAlignment;
+            char                                            m_acBuffer[CONTROL_BUFFER_SIZE_B];
+        } uControl;
+
+        struct msghdr sMessage;
+        memset(&sMessage, 0, sizeof(sMessage));
+        sMessage.msg_name = &sSourceAddress;
+        sMessage.msg_namelen = sizeof(sSourceAddress);
+        sMessage.msg_iov = &sIOVector;
+        sMessage.msg_iovlen = 1;
+        sMessage.msg_control = uControl.m_acBuffer;
+        sMessage.msg_controllen = sizeof(uControl.m_acBuffer);
+
+        ssize_t iNReceived = recvmsg(iSocketFD, &sMessage, MSG_DONTWAIT | MSG_TRUNC);
+
+        if(iNReceived >= 0)
+        {
+            //MSG_TRUNC reports the full length of a datagram that did not fit. The metadata keeps that length.
+            readMessageMetadata(sMessage, iNReceived, oMetadata);
+
+            if((uint32_t)iNReceived > u32Size_B)
+            {
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::receiveDatagram(): Warning: Datagram of " << iNReceived << " bytes truncated to " << u32Size_B << " bytes.";
+                addTruncatedPacket();
+
+                return u32Size_B;
+            }
+
+            return iNReceived;
+        }
+
+        if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::receiveDatagram(): Warning socket error: " << strerror(errno);
+            addSocketError();
+            return -1;
+        }
+
+        if(!waitForSocketData(iSocketFD))
+            return -1;
+    }
+#else
+    string strSender;
+    uint16_t u16Port;
+
+    if(!m_oSocket.receiveFrom(cpBuffer, u32Size_B, strSender, u16Port))
+    {
+        if(isReceivingStopRequested())
+            return -1;
+
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::receiveDatagram(): Warning socket error: " << m_oSocket.getLastError().message();
+        addSocketError();
+        return -1;
+    }
+
+    uint32_t u32DatagramSize_B = m_oSocket.getNBytesLastTransferred();
+
+    oMetadata.clear();
+    oMetadata.m_u16SourcePort = u16Port;
+    oMetadata.m_u32PayloadSize_B = u32DatagramSize_B;
+    oMetadata.m_i64ReceiveTime_ns = (boost::posix_time::microsec_clock::universal_time() - boost::posix_time::ptime(boost::gregorian::date(1970, 1, 1))).total_microseconds() * 1000;
+
+    boost::system::error_code oError;
+    boost::asio::ip::address oAddress = boost::asio::ip::address::from_string(strSender, oError);
+
+    if(!oError && oAddress.is_v4())
+    {
+        boost::asio::ip::address_v4::bytes_type aucBytes = oAddress.to_v4().to_bytes();
+        memcpy(oMetadata.m_au8SourceAddress, aucBytes.data(), aucBytes.size());
+        oMetadata.m_u8AddressFamily = 4;
+    }
+    else if(!oError && oAddress.is_v6())
+    {
+        boost::asio::ip::address_v6::bytes_type aucBytes = oAddress.to_v6().to_bytes();
+        memcpy(oMetadata.m_au8SourceAddress, aucBytes.data(), aucBytes.size());
+        oMetadata.m_u8AddressFamily = 6;
+    }
+
+    return u32DatagramSize_B;
+#endif
+}
+
+#ifdef __linux__
+bool cUDPReceiver::waitForSocketData(int iSocketFD)
+{
+    //Wait for data on the socket or for a change of run state. Returns false if receiving is to stop. Spurious returns are
+    //possible so the caller's read must not block.
+
+    struct pollfd asPollFDs[2];
+    asPollFDs[0].fd = iSocketFD;
+    asPollFDs[0].events = POLLIN;
+    asPollFDs[0].revents = 0;
+    asPollFDs[1].fd = m_oRunStateNotifier.getFileDescriptor();
+    asPollFDs[1].events = POLLIN;
+    asPollFDs[1].revents = 0;
+
+    //Low latency mode: poll the socket without blocking for the spin time so that no wakeup is needed
+    uint32_t u32SpinTime_us = getSpinTime_us();
+
+    if(u32SpinTime_us)
+    {
+        timespec sTime;
+        clock_gettime(CLOCK_MONOTONIC, &sTime);
+        uint64_t u64SpinDeadline_ns = (uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec + u32SpinTime_us * 1000ULL;
+
+        while(true)
+        {
+            if(isReceivingStopRequested())
+                return false;
+
+            if(poll(asPollFDs, 1, 0) > 0)
+                return true;
+
+            clock_gettime(CLOCK_MONOTONIC, &sTime);
+
+            if((uint64_t)sTime.tv_sec * 1000000000ULL + sTime.tv_nsec >= u64SpinDeadline_ns)
+                break;
+        }
+    }
+
+    m_oRunStateNotifier.prepareWait();
+
+    if(isReceivingStopRequested())
+    {
+        m_oRunStateNotifier.cancelWait();
+        return false;
+    }
+
+    poll(asPollFDs, 2, -1);
+
+    m_oRunStateNotifier.clearFileDescriptor();
+    m_oRunStateNotifier.cancelWait();
+
+    return true;
+}
+
+void cUDPReceiver::readMessageMetadata(struct msghdr &sMessage, uint32_t u32DatagramSize_B, cPacketRingBuffer::cMetadata &oMetadata)
+{
+    oMetadata.clear();
+    oMetadata.m_u32PayloadSize_B = u32DatagramSize_B;
+
+    const sockaddr_storage *pSourceAddress = (const sockaddr_storage*)sMessage.msg_name;
+
+    if(pSourceAddress && sMessage.msg_namelen)
+    {
+        if(pSourceAddress->ss_family == AF_INET)
+        {
+            const sockaddr_in *pAddress = (const sockaddr_in*)pSourceAddress;
+            memcpy(oMetadata.m_au8SourceAddress, &pAddress->sin_addr, 4);
+            oMetadata.m_u16SourcePort = ntohs(pAddress->sin_port);
+            oMetadata.m_u8AddressFamily = 4;
+        }
+        else if(pSourceAddress->ss_family == AF_INET6)
+        {
+            const sockaddr_in6 *pAddress = (const sockaddr_in6*)pSourceAddress;
+            memcpy(oMetadata.m_au8SourceAddress, &pAddress->sin6_addr, 16);
+            oMetadata.m_u16SourcePort = ntohs(pAddress->sin6_port);
+            oMetadata.m_u8AddressFamily = 6;
+        }
+    }
+
+    for(struct cmsghdr *pControl = CMSG_FIRSTHDR(&sMessage); pControl; pControl = CMSG_NXTHDR(&sMessage, pControl))
+    {
+        if(pControl->cmsg_level != SOL_SOCKET)
+            continue;
+
+        if(pControl->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec sTime;
+            memcpy(&sTime, CMSG_DATA(pControl), sizeof(sTime));
+
+            oMetadata.m_i64ReceiveTime_ns = (int64_t)sTime.tv_sec * 1000000000LL + sTime.tv_nsec;
+            oMetadata.m_bKernelTimestamp = true;
+        }
+#ifdef SO_RXQ_OVFL
+        else if(pControl->cmsg_type == SO_RXQ_OVFL)
+        {
+            //Cumulative count for the socket
+            uint32_t u32NDrops;
+            memcpy(&u32NDrops, CMSG_DATA(pControl), sizeof(u32NDrops));
+
+            m_u32KernelQueueDrops.store(u32NDrops, boost::memory_order_relaxed);
+            m_bKernelQueueDropsReported.store(true, boost::memory_order_relaxed);
+        }
+#endif
+    }
+
+    //No kernel timestamp: take the time now
+    if(!oMetadata.m_bKernelTimestamp)
+    {
+        struct timespec sTime;
+        clock_gettime(CLOCK_REALTIME, &sTime);
 
+        oMetadata.m_i64ReceiveTime_ns = (int64_t)sTime.tv_sec * 1000000000LL + sTime.tv_nsec;
     }
+}
+#endif
+
+void cUDPReceiver::configureSocket()
+{
+    int iSocketFD = m_oSocket.getBoostSocketPointer()->native_handle();
+
+    getSocketOptions().apply(iSocketFD, m_oSocket.getName());
+
+    m_u32KernelQueueDrops.store(0);
+    m_bKernelQueueDropsReported.store(false);
+
+#ifdef __linux__
+    int iEnable = 1;
+
+    //Have the kernel timestamp datagrams on arrival
+    if(setsockopt(iSocketFD, SOL_SOCKET, SO_TIMESTAMPNS, &iEnable, sizeof(iEnable)))
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::configureSocket(): Warning: Unable to enable SO_TIMESTAMPNS: " << strerror(errno) << ". Using the receiving thread's clock.";
+
+#ifdef SO_RXQ_OVFL
+    //Have the kernel's drop count attached to received datagrams
+    if(setsockopt(iSocketFD, SOL_SOCKET, SO_RXQ_OVFL, &iEnable, sizeof(iEnable)))
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::configureSocket(): Warning: Unable to enable SO_RXQ_OVFL: " << strerror(errno);
+#endif
+#endif
 
-    cout << "cUDPReceiver::socketReceivingThread(): Exiting receiving thread." << endl;
-    cout << "---- Received " << u32PacketsReceived << " packets ----" << endl;
-    fflush(stdout);
+    m_iSocketFD.store(iSocketFD);
+}
+
+uint64_t cUDPReceiver::getNKernelQueueDrops()
+{
+    if(m_bKernelQueueDropsReported.load())
+        return m_u32KernelQueueDrops.load();
+
+#ifdef __linux__
+    //The drops are the last column of the socket's line in /proc/net/udp(6), found by the socket's inode
+    int iSocketFD = m_iSocketFD.load();
+    if(iSocketFD < 0)
+        return 0;
+
+    struct stat sStat;
+    if(fstat(iSocketFD, &sStat))
+        return 0;
+
+    const char *acpFiles[] = {"/proc/net/udp", "/proc/net/udp6"};
+
+    for(uint32_t ui = 0; ui < 2; ui++)
+    {
+        ifstream oFile(acpFiles[ui]);
+        string strLine;
+
+        //Header line
+        getline(oFile, strLine);
+
+        while(getline(oFile, strLine))
+        {
+            //sl local_address rem_address st tx_queue:rx_queue tr:tm->when retrnsmt uid timeout inode ref pointer drops
+            istringstream oLine(strLine);
+            string astrFields[13];
+
+            for(uint32_t uj = 0; uj < 13; uj++)
+                oLine >> astrFields[uj];
+
+            if(strtoull(astrFields[9].c_str(), NULL, 10) == (unsigned long long)sStat.st_ino)
+                return strtoull(astrFields[12].c_str(), NULL, 10);
+        }
+    }
+#endif
+
+    return 0;
 }
 
 void cUDPReceiver::stopReceiving()
@@ -135,3 +729,216 @@ void cUDPReceiver::stopReceiving()
     //Also interrupt the socket which exists only in this derived implmentation
     m_oSocket.cancelCurrrentOperations();
 }
+
+void cUDPReceiver::batchedSocketReceivingLoop(uint32_t u32BatchSize, boost::shared_ptr<cPacketSequenceDecoder> pHeaderDecoder)
+{
+#ifdef __linux__
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::batchedSocketReceivingLoop(): Receiving up to " << u32BatchSize << " datagrams per system call.";
+
+    int iSocketFD = m_oSocket.getBoostSocketPointer()->native_handle();
+
+    //Message headers for recvmmsg. Each datagram goes to its own buffer element.
+    vector<struct mmsghdr> vsMessages(u32BatchSize);
+    vector<struct iovec> vsIOVectors(u32BatchSize);
+
+    //Senders and ancillary data (receive time, kernel drop count) of each datagram. Control buffers are kept aligned for cmsghdr.
+    vector<sockaddr_storage> vsSourceAddresses(u32BatchSize);
+    const uint32_t u32ControlSize_B = (CONTROL_BUFFER_SIZE_B + sizeof(struct cmsghdr) - 1) / sizeof(struct cmsghdr) * sizeof(struct cmsghdr);
+    vector<struct cmsghdr> vsControl(u32BatchSize * u32ControlSize_B / sizeof(struct cmsghdr));
+
+    uint32_t u32PacketsReceived = 0;
+
+    while(isReceivingEnabled() && !isShutdownRequested())
+    {
+        //Get (or wait for) as many consecutive free elements as are available up to the batch size
+        //The wait is interrupted as soon as receiving is stopped or shutdown is requested.
+        int32_t i32FirstIndex = -1;
+        uint32_t u32NElements = waitForFreeElements(i32FirstIndex, u32BatchSize);
+
+        if(!u32NElements)
+            continue;
+
+        if(!waitForSocketData(iSocketFD))
+            break;
+
+        uint32_t u32NBufferElements = m_oBuffer.getNElements();
+
+        for(uint32_t ui = 0; ui < u32NElements; ui++)
+        {
+            uint32_t u32Index = (i32FirstIndex + ui) % u32NBufferElements;
+
+            vsIOVectors[ui].iov_base = m_oBuffer.getElementDataPointer(u32Index);
+            vsIOVectors[ui].iov_len = m_oBuffer.getElementPointer(u32Index)->allocationSize();
+
+            memset(&vsMessages[ui], 0, sizeof(struct mmsghdr));
+            vsMessages[ui].msg_hdr.msg_iov = &vsIOVectors[ui];
+            vsMessages[ui].msg_hdr.msg_iovlen = 1;
+            vsMessages[ui].msg_hdr.msg_name = &vsSourceAddresses[ui];
+            vsMessages[ui].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+            vsMessages[ui].msg_hdr.msg_control = (char*)&vsControl.front() + ui * u32ControlSize_B;
+            vsMessages[ui].msg_hdr.msg_controllen = u32ControlSize_B;
+        }
+
+        //MSG_TRUNC makes the kernel report the full length of datagrams that did not fit into an element
+        int iNReceived = recvmmsg(iSocketFD, &vsMessages.front(), u32NElements, MSG_DONTWAIT | MSG_TRUNC, NULL);
+
+        if(iNReceived < 0)
+        {
+            if(errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            {
+                AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::batchedSocketReceivingLoop(): Warning socket error: " << strerror(errno);
+                addSocketError();
+            }
+
+            continue;
+        }
+
+        uint32_t u32LargestDatagram_B = 0;
+        uint64_t u64NBytesReceived = 0;
+
+        for(int32_t i = 0; i < iNReceived; i++)
+        {
+            uint32_t u32Index = (i32FirstIndex + i) % u32NBufferElements;
+            uint32_t u32DatagramSize_B = vsMessages[i].msg_len;
+
+            if(u32DatagramSize_B > u32LargestDatagram_B)
+                u32LargestDatagram_B = u32DatagramSize_B;
+
+            //The metadata keeps the length as sent
+            readMessageMetadata(vsMessages[i].msg_hdr, u32DatagramSize_B, m_oBuffer.getElementPointer(u32Index)->metadata());
+
+            if(u32DatagramSize_B > vsIOVectors[i].iov_len)
+            {
+                u32DatagramSize_B = vsIOVectors[i].iov_len;
+                addTruncatedPacket();
+            }
+
+            m_oBuffer.getElementPointer(u32Index)->setDataAdded(u32DatagramSize_B);
+            u64NBytesReceived += u32DatagramSize_B;
+
+            if(pHeaderDecoder)
+            {
+                int64_t i64PacketNumber;
+                pHeaderDecoder->processPacket(m_oBuffer.getElementDataPointer(u32Index), u32DatagramSize_B, i64PacketNumber);
+            }
+        }
+
+        //Signal we have filled a batch of elements of the input buffer.
+        elementsReceived(iNReceived);
+
+        u32PacketsReceived += iNReceived;
+        addReceiveCallStatistics(iNReceived);
+        addReceivedData(iNReceived, u64NBytesReceived);
+
+        //Datagrams were truncated, grow the elements for the following packets
+        if(u32LargestDatagram_B > m_oBuffer.getElementSize_B())
+        {
+            AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::batchedSocketReceivingLoop(): Warning: Input buffer element size is too small for UDP packet. Growing elements to " << u32LargestDatagram_B << " bytes";
+
+            //Queued packets are kept (see cPacketRingBuffer::requestResize())
+            m_oBuffer.requestResize(m_oBuffer.getNElements(), u32LargestDatagram_B);
+        }
+    }
+
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::batchedSocketReceivingLoop(): Exiting receiving thread. Received " << u32PacketsReceived << " packets.";
+#else
+    AVN_LOG(cLogger::SEVERITY_INFO) << "cUDPReceiver::batchedSocketReceivingLoop(): Batched receiving is not supported on this platform.";
+#endif
+}
+
+void cUDPReceiver::setReceiveBatchSize(uint32_t u32NDatagrams)
+{
+    if(!u32NDatagrams)
+        u32NDatagrams = 1;
+
+    m_u32ReceiveBatchSize.store(u32NDatagrams);
+}
+
+uint32_t cUDPReceiver::getReceiveBatchSize()
+{
+    return m_u32ReceiveBatchSize.load();
+}
+
+void cUDPReceiver::setPreserveDatagramBoundaries(bool bPreserve)
+{
+    m_bPreserveDatagramBoundaries.store(bPreserve);
+}
+
+bool cUDPReceiver::getPreserveDatagramBoundaries()
+{
+    return m_bPreserveDatagramBoundaries.load();
+}
+
+void cUDPReceiver::setReusePort(bool bReusePort)
+{
+    m_bReusePort.store(bReusePort);
+}
+
+bool cUDPReceiver::getReusePort()
+{
+    return m_bReusePort.load();
+}
+
+void cUDPReceiver::setHeaderDecoder(boost::shared_ptr<cPacketSequenceDecoder> pDecoder)
+{
+    boost::mutex::scoped_lock oLock(m_oHeaderDecoderMutex);
+
+    m_pHeaderDecoder = pDecoder;
+}
+
+boost::shared_ptr<cPacketSequenceDecoder> cUDPReceiver::getHeaderDecoder()
+{
+    boost::mutex::scoped_lock oLock(m_oHeaderDecoderMutex);
+
+    return m_pHeaderDecoder;
+}
+
+void cUDPReceiver::setReorderWindow(uint32_t u32NPackets)
+{
+    //Duplicates of held packets must still be recognised by the decoder
+    if(u32NPackets > cPacketSequenceDecoder::HISTORY_N_PACKETS)
+    {
+        AVN_LOG(cLogger::SEVERITY_WARNING) << "cUDPReceiver::setReorderWindow(): Warning: Reorder window of " << u32NPackets << " packets is too large. Using "
+                                           << cPacketSequenceDecoder::HISTORY_N_PACKETS << " packets.";
+        u32NPackets = cPacketSequenceDecoder::HISTORY_N_PACKETS;
+    }
+
+    m_u32ReorderWindow.store(u32NPackets);
+}
+
+uint32_t cUDPReceiver::getReorderWindow()
+{
+    return m_u32ReorderWindow.load();
+}
+
+uint64_t cUDPReceiver::getNPacketsReordered()
+{
+    return m_u64NPacketsReordered.load(boost::memory_order_relaxed);
+}
+
+uint64_t cUDPReceiver::getNPacketsSkippedByReordering()
+{
+    return m_u64NPacketsSkippedByReordering.load(boost::memory_order_relaxed);
+}
+
+uint32_t cUDPReceiver::getNDatagramsLastReceiveCall()
+{
+    return m_u32NDatagramsLastReceiveCall.load();
+}
+
+double cUDPReceiver::getMeanDatagramsPerReceiveCall()
+{
+    uint64_t u64NReceiveCalls = m_u64NReceiveCalls.load();
+
+    if(!u64NReceiveCalls)
+        return 0.0;
+
+    return (double)m_u64NDatagramsReceived.load() / u64NReceiveCalls;
+}
+
+void cUDPReceiver::addReceiveCallStatistics(uint32_t u32NDatagrams)
+{
+    m_u32NDatagramsLastReceiveCall.store(u32NDatagrams, boost::memory_order_relaxed);
+    m_u64NReceiveCalls.fetch_add(1, boost::memory_order_relaxed);
+    m_u64NDatagramsReceived.fetch_add(u32NDatagrams, boost::memory_order_relaxed);
+}
@@ -2,30 +2,142 @@
 #define UDP_RECEIVER_H
 
 //System includes
+#include <vector>
 
 //Library includes
+#ifndef Q_MOC_RUN //Qt's MOC and Boost have some issues don't let MOC process boost headers
+#include <boost/atomic.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#endif
 
 //Local includes
 #include "../SocketReceiverBase.h"
+#include "../PacketSequenceDecoder/PacketSequenceDecoder.h"
 #include "../../../AVNUtilLibs/Sockets/InterruptibleBlockingSockets/InterruptibleBlockingUDPSocket.h"
 
+#ifdef __linux__
+struct msghdr;
+#endif
+
+//Each buffer element carries the sender, payload size and kernel receive time (SO_TIMESTAMPNS) of its datagram in its
+//metadata (see cPacketRingBuffer::cMetadata). When datagram boundaries are not preserved it describes the first datagram.
+
 class cUDPReceiver  : public cSocketReceiverBase
 {
 public:
-    explicit cUDPReceiver(const std::string &strLocalInterface, uint16_t u16LocalPort = 60000, const std::string &strPeerAddress = std::string(""), uint16_t usPeerPort = 60001);
+    explicit cUDPReceiver(const std::string &strLocalInterface, uint16_t u16LocalPort = 60000, const std::string &strPeerAddress = std::string(""), uint16_t usPeerPort = 60001,
+                          uint32_t u32BufferNElements = DEFAULT_BUFFER_N_ELEMENTS, uint32_t u32BufferElementSize_B = DEFAULT_BUFFER_ELEMENT_SIZE_B);
     virtual ~cUDPReceiver();
 
     virtual void                    stopReceiving();
 
+    //Batched receiving: Pull up to this many datagrams per system call (recvmmsg), one datagram per buffer element.
+    //A batch size of 1 (default) receives one datagram at a time. Takes effect on the next call to startReceiving().
+    void                            setReceiveBatchSize(uint32_t u32NDatagrams);
+    uint32_t                        getReceiveBatchSize();
+
+    //Datagram boundaries: Store exactly one datagram per buffer element so that the element data size is the datagram length.
+    //Otherwise elements are filled with back to back datagrams. Batched receiving always preserves datagram boundaries.
+    //Takes effect on the next call to startReceiving().
+    void                            setPreserveDatagramBoundaries(bool bPreserve);
+    bool                            getPreserveDatagramBoundaries();
+
+    //Bind with SO_REUSEPORT so that several receivers can share the local port. The kernel then spreads incoming flows across
+    //them (see cShardedUDPReceiver). Linux only. Takes effect on the next call to startReceiving().
+    void                            setReusePort(bool bReusePort);
+    bool                            getReusePort();
+
+    //Header decoding: Every datagram is passed to the decoder as it is received to account for lost, duplicated and reordered
+    //packets (see cPacketSequenceDecoder). Its statistics can be read at any time. An empty pointer disables decoding.
+    //Takes effect on the next call to startReceiving().
+    void                            setHeaderDecoder(boost::shared_ptr<cPacketSequenceDecoder> pDecoder);
+    boost::shared_ptr<cPacketSequenceDecoder> getHeaderDecoder();
+
+    //Reordering: Hold back packets that arrive ahead of a missing one until it arrives, for up to this many packet numbers,
+    //so that they enter the buffer in sequence. When the window is exceeded the oldest missing packets are given up.
+    //Duplicates are dropped and packets older than the window are passed on as they are. Held packets are released when
+    //the window moves on or receiving stops, so a stream that ends after a gap leaves them held until then.
+    //Needs a header decoder and one datagram per element, so it implies preserved datagram boundaries and disables batched
+    //receiving. 0 (default) disables. At most cPacketSequenceDecoder::HISTORY_N_PACKETS. Takes effect on the next call to
+    //startReceiving().
+    void                            setReorderWindow(uint32_t u32NPackets);
+    uint32_t                        getReorderWindow();
+
+    //Since receiving was last started
+    uint64_t                        getNPacketsReordered(); //Held and released in sequence
+    uint64_t                        getNPacketsSkippedByReordering(); //Missing packets given up when the window moved on
+
+    //Datagrams dropped by the kernel because the socket's receive queue was full (as opposed to drops in the buffer). The
+    //kernel's count for the current socket, i.e. since receiving was last started. Taken from SO_RXQ_OVFL as datagrams arrive,
+    //otherwise looked up in /proc/net/udp. Linux only, 0 elsewhere.
+    uint64_t                        getNKernelQueueDrops();
+
+    //Receive call statistics for tuning the batch size
+    uint32_t                        getNDatagramsLastReceiveCall();
+    double                          getMeanDatagramsPerReceiveCall();
+
 protected:
+#ifdef __linux__
+    //Room for the receive timestamp and the kernel drop count in the ancillary data of a datagram
+    static const uint32_t           CONTROL_BUFFER_SIZE_B = 64;
+#endif
+
     //Socket
     cInterruptibleBlockingUDPSocket m_oSocket;
 
     std::string                     m_strLocalInterface;
     uint16_t                        m_u16LocalPort;
 
+    boost::atomic<uint32_t>         m_u32ReceiveBatchSize;
+    boost::atomic<bool>             m_bPreserveDatagramBoundaries;
+    boost::atomic<bool>             m_bReusePort;
+    boost::atomic<uint32_t>         m_u32NDatagramsLastReceiveCall;
+    boost::atomic<uint64_t>         m_u64NReceiveCalls;
+    boost::atomic<uint64_t>         m_u64NDatagramsReceived;
+
+    boost::atomic<int>              m_iSocketFD; //-1 when not bound
+    boost::atomic<uint32_t>         m_u32KernelQueueDrops; //Last SO_RXQ_OVFL value
+    boost::atomic<bool>             m_bKernelQueueDropsReported; //SO_RXQ_OVFL values are being received
+
+    boost::shared_ptr<cPacketSequenceDecoder> m_pHeaderDecoder;
+    boost::mutex                    m_oHeaderDecoderMutex;
+
+    boost::atomic<uint32_t>         m_u32ReorderWindow;
+    boost::atomic<uint64_t>         m_u64NPacketsReordered;
+    boost::atomic<uint64_t>         m_u64NPacketsSkippedByReordering;
+
+    //Reorder window state, receiving thread only. Slot n % window holds packet number n.
+    std::vector<std::vector<char> > m_vvcReorderSlots;
+    std::vector<bool>               m_vbReorderSlotsFull;
+    std::vector<cPacketRingBuffer::cMetadata> m_voReorderSlotMetadata;
+    std::vector<char>               m_vcReorderScratch;
+    cPacketRingBuffer::cMetadata    m_oReorderScratchMetadata;
+    uint32_t                        m_u32NPacketsHeld;
+    int64_t                         m_i64NextPacketNumber;
+    bool                            m_bReorderStarted;
+
+    bool                            openAndBindSocket();
+    void                            configureSocket();
+
+    //Receiving one datagram with its sender and receive time. Returns its size or -1 on a socket error or stop request.
+    int32_t                         receiveDatagram(char *cpBuffer, uint32_t u32Size_B, cPacketRingBuffer::cMetadata &oMetadata);
+#ifdef __linux__
+    bool                            waitForSocketData(int iSocketFD);
+    void                            readMessageMetadata(struct msghdr &sMessage, uint32_t u32DatagramSize_B, cPacketRingBuffer::cMetadata &oMetadata);
+#endif
+
     //Thread functions
     virtual void                    socketReceivingThreadFunction();
+    void                            batchedSocketReceivingLoop(uint32_t u32BatchSize, boost::shared_ptr<cPacketSequenceDecoder> pHeaderDecoder);
+
+    //Reordering (receiving thread)
+    void                            reorderReceivedPacket(int32_t i32Index, cPacketSequenceDecoder::sequenceResult eResult, int64_t i64PacketNumber, uint32_t u32Window);
+    void                            releaseHeldPackets(uint32_t u32Window);
+    void                            flushReorderWindow(uint32_t u32Window);
+    bool                            emitPacket(const char *cpData, uint32_t u32Size_B, const cPacketRingBuffer::cMetadata &oMetadata, bool bWait);
+
+    void                            addReceiveCallStatistics(uint32_t u32NDatagrams);
 };
 
 #endif // UDP_RECEIVER_H